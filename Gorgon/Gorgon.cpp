@@ -1,5 +1,7 @@
 ﻿#include "gltf/loader.h"
 #include "vk/vma.h"
+#include "camera.h"
+#include "headless.h"
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
@@ -77,6 +79,10 @@ struct RenderThreadConfig
 {
 	std::string_view gltfFile;
 	GLFWwindow* const Window;
+	std::optional<std::filesystem::path> cacheDirectory;
+	gltf::DrawMode drawMode;
+	bool parallelRecording;
+	float lodPixelError;
 };
 
 std::vector<const char*> GetRequiredExtensions() {
@@ -200,6 +206,46 @@ void RenderThreadFunc(
 			return glfwGetPhysicalDevicePresentationSupport(*Instance, *PhysicalDevice, index) == GLFW_TRUE;
 		};
 
+		// Prefer a transfer-only family (usually a DMA engine), then one without graphics,
+		// so uploads run beside rendering. Copies are made in arbitrary row bands,
+		// families with a coarser image transfer granularity are skipped
+		const auto findTransfer = [&](const uint32_t graphicsQueueIndex)
+		{
+			const auto score = [&](const vk::QueueFamilyProperties2 &properties)
+			{
+				const auto &familyProperties = properties.queueFamilyProperties;
+				const auto flags = familyProperties.queueFlags;
+				const auto granularity = familyProperties.minImageTransferGranularity;
+
+				if (flags & vk::QueueFlagBits::eGraphics || granularity != vk::Extent3D{1, 1, 1})
+				{
+					return 0;
+				}
+
+				// transfer is implied by compute
+				if (flags & vk::QueueFlagBits::eCompute)
+				{
+					return 1;
+				}
+
+				return flags & vk::QueueFlagBits::eTransfer ? 2 : 0;
+			};
+
+			auto result = graphicsQueueIndex;
+			auto bestScore = 0;
+
+			for (const auto &[index, value] : std::views::enumerate(QueueFamilyProperties))
+			{
+				if (const auto currentScore = score(value); currentScore > bestScore)
+				{
+					result = static_cast<uint32_t>(index);
+					bestScore = currentScore;
+				}
+			}
+
+			return result;
+		};
+
 		// Find separate graphics and present queues
 		const auto findSeparate = [&] -> std::optional<QueueFamilyIndices>
 		{
@@ -240,7 +286,7 @@ void RenderThreadFunc(
 							QueueFamilyIndices{
 								.Graphics = graphicsQueueIndex,
 								.Present = presentQueueIndex,
-								.Transfer = graphicsQueueIndex // TODO: find transfer queue
+								.Transfer = findTransfer(graphicsQueueIndex),
 							});
 					}
 				}
@@ -260,7 +306,7 @@ void RenderThreadFunc(
 					return std::make_optional(QueueFamilyIndices{
 						queueFamilyIndex,
 						queueFamilyIndex,
-						queueFamilyIndex});
+						findTransfer(queueFamilyIndex)});
 				}
 			}
 
@@ -288,13 +334,16 @@ void RenderThreadFunc(
 		};
 
 		// TODO: use std::inplace_vector C++26
-		std::vector<uint32_t> queueIndices = {queueFamilyIndices.Graphics, queueFamilyIndices.Present};
+		std::vector<uint32_t> queueIndices = {queueFamilyIndices.Graphics, queueFamilyIndices.Present, queueFamilyIndices.Transfer};
+		std::ranges::sort(queueIndices);
 		auto [first, last] = std::ranges::unique(queueIndices);
 		queueIndices.erase(first, last);
 
 		const auto queueCreateInfos = queueIndices | std::views::transform(transform) | std::ranges::to<vku::small::vector<vk::DeviceQueueCreateInfo, MAX_PENDING_FRAMES>>();
 
 		const auto features = vk::PhysicalDeviceFeatures{
+			.multiDrawIndirect = true,
+			.drawIndirectFirstInstance = true,
 			.fillModeNonSolid = true,
 		};
 
@@ -306,6 +355,7 @@ void RenderThreadFunc(
 			vk::PhysicalDeviceVulkan12Features{
 				//.descriptorIndexing = true,
 				//.shaderSampledImageArrayNonUniformIndexing = true,
+				.drawIndirectCount = true,
 				.descriptorBindingSampledImageUpdateAfterBind = true,
 				.descriptorBindingPartiallyBound = true,
 				.descriptorBindingVariableDescriptorCount = true,
@@ -346,6 +396,26 @@ void RenderThreadFunc(
 	const auto PresentQueue = Device.getQueue(queueFamilyIndices.Present, 0);
 	const auto TransferQueue = Device.getQueue(queueFamilyIndices.Transfer, 0);
 
+	// queues may alias each other and the loader submits from worker threads
+	auto queueMutex = std::mutex();
+
+	// a dedicated transfer queue has its own lock, uploads then never wait on frame submits
+	auto dedicatedTransferQueueMutex = std::mutex();
+
+	const auto dedicatedTransferQueue = queueFamilyIndices.Transfer != queueFamilyIndices.Graphics
+		&& queueFamilyIndices.Transfer != queueFamilyIndices.Present;
+
+	auto &transferQueueMutex = dedicatedTransferQueue ? dedicatedTransferQueueMutex : queueMutex;
+
+	if (dedicatedTransferQueue)
+	{
+		SetDebugUtilsObjectName(
+			Device,
+			vk::ObjectType::eQueue,
+			static_cast<uint64_t>(reinterpret_cast<uintptr_t>(VkQueue(*TransferQueue))),
+			"TransferQueue");
+	}
+
 	// TODO: create question on Vulkan-hpp github about vk::ObjectType
 	if (queueFamilyIndices.Graphics != queueFamilyIndices.Present)
 	{
@@ -520,7 +590,7 @@ void RenderThreadFunc(
 			.arrayLayers = 1,
 			.samples = vk::SampleCountFlagBits::e1,
 			.tiling = vk::ImageTiling::eOptimal,
-			.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
+			.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
 			.sharingMode = vk::SharingMode::eExclusive,
 		};
 
@@ -547,6 +617,22 @@ void RenderThreadFunc(
 		return Device.createImageView(createInfo);
 	}();
 
+	// occlusion culling tests against the depth of the frame's first pass
+	const auto depthPyramid = [&] -> std::optional<DepthPyramid> {
+		if (config.drawMode != gltf::DrawMode::eOcclusionCulled)
+		{
+			return std::nullopt;
+		}
+
+		return std::make_optional<DepthPyramid>(DepthPyramid::CreateInfo{
+			.device = Device,
+			.vma = vma,
+			.depthImage = *depthImage,
+			.depthImageView = *depthImageView,
+			.depthExtent = surfaceExtent,
+		});
+	}();
+
 	const auto frameSynchronizations = [&]
 	{
 		struct FrameSynchronization
@@ -657,32 +743,62 @@ void RenderThreadFunc(
 		return std::move(Device.allocateCommandBuffers(CreateInfo).front());
 	}();
 
+	auto threadPool = ThreadPool();
+
+	// a slot per thread, so each records into its own pool
+	auto secondaryCommandPools = SecondaryCommandPools({
+		.device = Device,
+		.queueFamilyIndex = queueFamilyIndices.Graphics,
+		.framesInFlight = MAX_PENDING_FRAMES,
+		.slotCount = threadPool.size(),
+	});
+
 	auto gltfLoader = [&]
 	{
 		const auto createInfo = gltf::Loader::CreateInfo{
+			.physicalDevice = PhysicalDevice,
 			.device = Device,
 			.vma = vma,
 			.transferCommandBuffer = transferCommandBuffer,
 			.transferQueue = TransferQueue,
+			.transferQueueMutex = transferQueueMutex,
+			.transferQueueFamilyIndex = queueFamilyIndices.Transfer,
+			.graphicsQueueFamilyIndex = queueFamilyIndices.Graphics,
+			.threadPool = threadPool,
 			.surfaceFormat = SurfaceFormat.format,
 			.depthFormat = depthFormat,
+			.modelCacheDirectory = config.cacheDirectory.transform([](const auto& directory) { return directory / "models"; }),
+			.pipelineCachePath = config.cacheDirectory.transform([](const auto& directory) { return directory / "pipelines.bin"; }),
+			.framesInFlight = MAX_PENDING_FRAMES,
+			.clusterCulling = config.drawMode == gltf::DrawMode::eClusterCulled,
 		};
 
 		return gltf::Loader(createInfo);
 	}();
 
-	const auto gltfModel = gltfLoader.loadFromFile(config.gltfFile);
+	// frames are presented while the model loads, it's swapped in once ready
+	auto gltfModel = std::optional<gltf::Model>();
+	auto pendingModel = gltfLoader.loadFromFileAsync(config.gltfFile);
 
-	// TODO
-	float dolly = 0.5f;					   // distance from center
-	float azimuth = 0.0f;				   // horizontal angle (radians)
-	float altitude = glm::radians(30.0f);  // vertical angle (radians)
-	float spinSpeed = glm::radians(45.0f); // radians per second
+	auto camera = OrbitCamera();
 
 	auto frameTimer = FrameTimer();
 	while (not stop_token.stop_requested())
 	{
 		// fmt::println(std::clog, "Render Thread");
+		// a model that fails to load is reported, the viewer keeps presenting empty frames
+		if (not gltfModel && pendingModel.isReady())
+		{
+			try
+			{
+				gltfModel.emplace(pendingModel.get());
+			}
+			catch (const std::exception& e)
+			{
+				fmt::println(std::clog, "failed to load {}: {}", config.gltfFile, e.what());
+			}
+		}
+
 		const auto frameNumber = frameTimer.getFrameNum();
 		const auto frameIndex = frameNumber % MAX_PENDING_FRAMES;
 
@@ -707,6 +823,8 @@ void RenderThreadFunc(
 			Device.resetFences(*frameSynchronization.present);
 		}
 
+		secondaryCommandPools.reset(static_cast<uint32_t>(frameIndex));
+
 		const auto NextImage = [&]
 		{
 			const auto Result = Swapchain.acquireNextImage(
@@ -728,6 +846,48 @@ void RenderThreadFunc(
 			{
 				commandBuffer.begin({.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
 
+				camera.update(frameTimer.getDeltaTime());
+
+				const auto viewProj = camera.getViewProj(surfaceExtent);
+
+				// the first frame using a model acquires what the transfer queue released
+				if (gltfModel)
+				{
+					gltfModel->acquireOwnership(commandBuffer);
+				}
+
+				const auto cull = [&](const gltf::CullPass pass) {
+					gltfModel->cull({
+						.sceneIndex = 0, // TODO
+						.viewProj = viewProj,
+						.commandBuffer = commandBuffer,
+						.frameIndex = static_cast<uint32_t>(frameIndex),
+						.pass = pass,
+						.depthPyramid = pass == gltf::CullPass::eLate ? &*depthPyramid : nullptr,
+						.lodPixelError = config.lodPixelError,
+						.viewportHeight = surfaceExtent.height,
+					});
+				};
+
+				// compute work has to be recorded outside of rendering
+				if (gltfModel && config.drawMode == gltf::DrawMode::eCulled)
+				{
+					cull(gltf::CullPass::eFrustum);
+				}
+				else if (gltfModel && depthPyramid)
+				{
+					cull(gltf::CullPass::eEarly);
+				}
+				else if (gltfModel && config.drawMode == gltf::DrawMode::eClusterCulled)
+				{
+					gltfModel->cullClusters({
+						.sceneIndex = 0, // TODO
+						.viewProj = viewProj,
+						.commandBuffer = commandBuffer,
+						.frameIndex = static_cast<uint32_t>(frameIndex),
+					});
+				}
+
 				{
 					const auto imageMemoryBarriers = {
 						// to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -763,80 +923,78 @@ void RenderThreadFunc(
 					commandBuffer.pipelineBarrier2(dependencyInfo);
 				}
 
-				const auto colorAttachment = vk::RenderingAttachmentInfo{
-					.imageView = swapchainImageViews[NextImage],
-					.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
-					.loadOp = vk::AttachmentLoadOp::eClear,
-					.storeOp = vk::AttachmentStoreOp::eStore,
-					.clearValue = {.color = std::to_array({0.1f, 0.1f, 0.1f, 1.0f})},
-				};
-
-				const auto depthAttachment = vk::RenderingAttachmentInfo{
-					.imageView = *depthImageView,
-					.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
-					.loadOp = vk::AttachmentLoadOp::eClear,
-					.storeOp = vk::AttachmentStoreOp::eStore,
-					.clearValue = {.depthStencil = {.depth = 1.0f}},
-				};
-
-				const auto renderingInfo = vk::RenderingInfo{
-					.renderArea = vk::Rect2D{.extent = surfaceExtent},
-					.layerCount = 1,
-					.pDepthAttachment = &depthAttachment,
-				}.setColorAttachments(colorAttachment);
+				const auto colorFormat = SurfaceFormat.format;
 
-				commandBuffer.beginRendering(renderingInfo);
+				const auto inheritanceRenderingInfo = vk::CommandBufferInheritanceRenderingInfo{
+					.depthAttachmentFormat = depthFormat,
+					.rasterizationSamples = vk::SampleCountFlagBits::e1,
+				}.setColorAttachmentFormats(colorFormat);
 
-				// TODO: temp solution, rework == add input
-				const auto createViewProj = [&]
-				{
-					azimuth += spinSpeed * frameTimer.getDeltaTime();
+				const auto parallelRecordInfo = gltf::ParallelRecordInfo{
+					.threadPool = threadPool,
+					.commandPools = secondaryCommandPools,
+					.inheritanceRenderingInfo = inheritanceRenderingInfo,
+				};
 
-					// view matrix
-					constexpr auto target = glm::vec3(0);
-					constexpr auto up = glm::vec3(0.0f, 1.0f, 0.0f);
+				const auto parallel = gltfModel && config.parallelRecording;
 
-					const auto altitude_sin = glm::sin(altitude);
-					const auto altitude_cos = glm::cos(altitude);
-					const auto azimuth_sin = glm::sin(azimuth);
-					const auto azimuth_cos = glm::cos(azimuth);
+				// the second pass of occlusion culling draws over the first
+				const auto renderPass = [&](const vk::AttachmentLoadOp loadOp) {
+					const auto colorAttachment = vk::RenderingAttachmentInfo{
+						.imageView = swapchainImageViews[NextImage],
+						.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+						.loadOp = loadOp,
+						.storeOp = vk::AttachmentStoreOp::eStore,
+						.clearValue = {.color = std::to_array({0.1f, 0.1f, 0.1f, 1.0f})},
+					};
 
-					const auto x = dolly * altitude_cos * azimuth_sin;
-					const auto y = dolly * altitude_sin;
-					const auto z = dolly * altitude_cos * azimuth_cos;
+					const auto depthAttachment = vk::RenderingAttachmentInfo{
+						.imageView = *depthImageView,
+						.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+						.loadOp = loadOp,
+						.storeOp = vk::AttachmentStoreOp::eStore,
+						.clearValue = {.depthStencil = {.depth = 1.0f}},
+					};
 
-					const auto position = glm::vec3(x, y, z);
+					const auto renderingInfo = vk::RenderingInfo{
+						.flags = parallel ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags(),
+						.renderArea = vk::Rect2D{.extent = surfaceExtent},
+						.layerCount = 1,
+						.pDepthAttachment = &depthAttachment,
+					}.setColorAttachments(colorAttachment);
 
-					const auto view = glm::lookAt(position, target, up);
+					commandBuffer.beginRendering(renderingInfo);
 
-					// projection matrix
-					const auto width = static_cast<float>(surfaceExtent.width);
-					const auto height = static_cast<float>(surfaceExtent.height);
-					constexpr float fovY = glm::radians(45.0f);
-					const float aspect = width / height;
-					constexpr float nearPlane = 0.01f;
-					constexpr float farPlane = 100.0f;
+					if (gltfModel)
+					{
+						auto recorder = CommandRecorder(commandBuffer);
+
+						const auto drawInfo = gltf::Model::DrawInfo{
+							.sceneIndex = 0, // TODO
+							.viewProj = viewProj,
+							.recorder = recorder,
+							.surfaceExtent = surfaceExtent,
+							.drawMode = config.drawMode,
+							.frameIndex = static_cast<uint32_t>(frameIndex),
+							.parallel = parallel ? &parallelRecordInfo : nullptr,
+							.lodPixelError = config.lodPixelError,
+						};
 
-					const auto proj = glm::perspective(fovY, aspect, nearPlane, farPlane);
+						gltfModel->Draw(drawInfo);
+					}
 
-					return proj * view;
+					commandBuffer.endRendering();
 				};
 
-				const auto viewProj = createViewProj();
+				renderPass(vk::AttachmentLoadOp::eClear);
 
+				if (gltfModel && depthPyramid)
 				{
-					const auto drawInfo = gltf::Model::DrawInfo{
-						.sceneIndex = 0, // TODO
-						.viewProj = viewProj,
-						.commandBuffer = commandBuffer,
-						.surfaceExtent = surfaceExtent,
-					};
-
-					gltfModel.Draw(drawInfo);
+					depthPyramid->build(commandBuffer);
+					cull(gltf::CullPass::eLate);
+					renderPass(vk::AttachmentLoadOp::eLoad);
 				}
 
-				commandBuffer.endRendering();
-
 				// to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
 				{
 					const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
@@ -875,7 +1033,10 @@ void RenderThreadFunc(
 										.setCommandBufferInfos(commandBufferInfo)
 										.setSignalSemaphoreInfos(signalSemaphoreInfo);
 
-			GraphicsQueue.submit2(submitInfo);
+			{
+				const auto lock = std::scoped_lock(queueMutex);
+				GraphicsQueue.submit2(submitInfo);
+			}
 		}
 
 		// pre-present
@@ -927,7 +1088,10 @@ void RenderThreadFunc(
 				.setCommandBufferInfos(commandBufferInfo)
 				.setSignalSemaphoreInfos(signalSemaphoreInfo);
 
-			PresentQueue.submit2(submitInfo);
+			{
+				const auto lock = std::scoped_lock(queueMutex);
+				PresentQueue.submit2(submitInfo);
+			}
 		}
 
 		// present
@@ -943,6 +1107,7 @@ void RenderThreadFunc(
 
 			// TODO: swapchain recreation
 			{
+				const auto lock = std::scoped_lock(queueMutex);
 				const auto result = PresentQueue.presentKHR(presentInfo);
 				assert(result == vk::Result::eSuccess);
 			}
@@ -962,15 +1127,165 @@ void RenderThreadFunc(
 	}
 }
 
+int RunHeadless(
+	const std::string_view gltfFile,
+	const uint32_t frameCount,
+	const std::optional<std::filesystem::path>& cacheDirectory,
+	const gltf::DrawMode drawMode,
+	const bool parallelRecording,
+	const float lodPixelError)
+{
+	using clock = std::chrono::steady_clock;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	auto renderer = HeadlessRenderer({
+		.extent = { .width = WIDTH, .height = HEIGHT },
+		.cacheDirectory = cacheDirectory,
+		.drawMode = drawMode,
+		.parallelRecording = parallelRecording,
+		.lodPixelError = lodPixelError,
+	});
+
+	auto loadTimings = gltf::LoadTimings{};
+
+	const auto loadStart = clock::now();
+	const auto gltfModel = renderer.getLoader().loadFromFile(gltfFile, &loadTimings);
+	const auto loadTime = milliseconds(clock::now() - loadStart);
+
+	const auto timings = renderer.render(gltfModel, frameCount);
+
+	const auto printSummary = [](const std::string_view name, const std::vector<double>& values)
+	{
+		if (values.empty())
+		{
+			fmt::println(std::clog, "{}: n/a", name);
+			return;
+		}
+
+		const auto [min, max] = std::ranges::minmax(values);
+		const auto avg = std::reduce(values.begin(), values.end()) / values.size();
+
+		fmt::println(std::clog, "{}: avg {:.3f} ms, min {:.3f} ms, max {:.3f} ms", name, avg, min, max);
+	};
+
+	fmt::println(std::clog, "device: {}", renderer.getDeviceName());
+	fmt::println(std::clog, "load: {:.3f} ms", loadTime.count());
+
+	if (loadTimings.vertexCacheBefore.triangleCount > 0)
+	{
+		const auto& before = loadTimings.vertexCacheBefore;
+		const auto& after = loadTimings.vertexCacheAfter;
+
+		fmt::println(std::clog, "vertex cache: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+			before.getAcmr(), after.getAcmr(), before.getAtvr(), after.getAtvr());
+	}
+	else
+	{
+		fmt::println(std::clog, "vertex cache: n/a, no indexed triangle lists were imported");
+	}
+	printSummary("cpu", timings.cpu);
+	printSummary("gpu", timings.gpu);
+
+	if (not timings.passes.empty())
+	{
+		const auto getPassTimes = [&](const double HeadlessRenderer::PassTimings::* member) {
+			return timings.passes
+				| std::views::transform([&](const HeadlessRenderer::PassTimings& passTimings) { return passTimings.*member; })
+				| std::ranges::to<std::vector>();
+		};
+
+		printSummary("early pass", getPassTimes(&HeadlessRenderer::PassTimings::early));
+		printSummary("depth pyramid", getPassTimes(&HeadlessRenderer::PassTimings::depthPyramid));
+		printSummary("late pass", getPassTimes(&HeadlessRenderer::PassTimings::late));
+	}
+
+	if (not timings.culling.empty())
+	{
+		const auto getAverage = [&](const uint32_t CullStats::* member) {
+			const auto sum = std::ranges::fold_left(timings.culling, uint64_t(0), [&](const uint64_t sum, const CullStats& stats) {
+				return sum + stats.*member;
+			});
+
+			return double(sum) / timings.culling.size();
+		};
+
+		fmt::println(std::clog, "culling: avg {:.1f} of {} draws visible", getAverage(&CullStats::visibleDraws), timings.culling.front().draws);
+
+		if (drawMode == gltf::DrawMode::eOcclusionCulled)
+		{
+			fmt::println(std::clog, "occlusion: avg {:.1f} draws occluded, {:.1f} drawn late", getAverage(&CullStats::occludedDraws), getAverage(&CullStats::lateDraws));
+		}
+	}
+
+	if (not timings.clusterCulling.empty())
+	{
+		const auto getAverage = [&](const uint32_t ClusterCullStats::* member) {
+			const auto sum = std::ranges::fold_left(timings.clusterCulling, uint64_t(0), [&](const uint64_t sum, const ClusterCullStats& stats) {
+				return sum + stats.*member;
+			});
+
+			return double(sum) / timings.clusterCulling.size();
+		};
+
+		const auto& first = timings.clusterCulling.front();
+
+		fmt::println(std::clog, "cluster culling: avg {:.1f} of {} meshlets, {:.1f} of {} triangles visible",
+			getAverage(&ClusterCullStats::visibleMeshlets), first.meshlets,
+			getAverage(&ClusterCullStats::visibleTriangles), first.triangles);
+	}
+
+	// per-frame times go to stdout, so they can be redirected to a file
+	fmt::println("frame,cpu_ms,gpu_ms,culled_draws");
+	for (const auto& [frame, cpu] : std::views::enumerate(timings.cpu))
+	{
+		const auto gpu = std::cmp_less(frame, timings.gpu.size()) ? fmt::format("{:.3f}", timings.gpu[frame]) : "";
+
+		const auto culled = std::cmp_less(frame, timings.culling.size()) ?
+			fmt::format("{}", timings.culling[frame].draws - timings.culling[frame].visibleDraws) :
+			"";
+
+		fmt::println("{},{:.3f},{},{}", frame, cpu, gpu, culled);
+	}
+
+	return EXIT_SUCCESS;
+}
+
 int main(const int argc, const char *const *argv)
 {
 	// Initialize the command line parser
 	auto app = CLI::App();
 	auto gltfFile = std::string_view();
-	app.add_option("gltfFile", gltfFile, "Input glTF file")->required();
+	app.add_option("gltfFile", gltfFile, "Input glTF or GLB file")->required();
+
+	auto headless = false;
+	app.add_flag("--headless", headless, "Render offscreen without a window and report per-frame CPU/GPU times");
+
+	auto frameCount = 1000u;
+	app.add_option("--frames", frameCount, "Number of frames to render in headless mode");
+
+	auto cacheDirectory = std::filesystem::path();
+	app.add_option("--cache-dir", cacheDirectory, "Directory for the model and pipeline caches, none are read or written without it");
+
+	auto drawMode = gltf::DrawMode::eIndirect;
+	app.add_option("--draw-mode", drawMode, "direct: a draw call per primitive, indirect: a multi-draw indirect call per batch, culled: indirect after GPU frustum culling, cpu-culled: direct after CPU frustum culling, occlusion-culled: culled twice per frame, the second time against the depth of the first, cluster-culled: indirect with the meshlets of each draw culled on the GPU")
+		->transform(CLI::CheckedTransformer(DRAW_MODES, CLI::ignore_case));
+
+	auto parallelRecording = false;
+	app.add_flag("--parallel-recording", parallelRecording, "Record the draws on every thread into secondary command buffers");
+
+	auto lodPixelError = 1.0f;
+	app.add_option("--lod-pixel-error", lodPixelError, "Largest error in pixels of the simplified levels of detail drawn, 0 draws the full meshes")
+		->check(CLI::NonNegativeNumber);
 
 	CLI11_PARSE(app, argc, argv);
 
+	const auto cacheDirectoryOption = cacheDirectory.empty() ? std::nullopt : std::make_optional(cacheDirectory);
+
+	if (headless)
+	{
+		return RunHeadless(gltfFile, frameCount, cacheDirectoryOption, drawMode, parallelRecording, lodPixelError);
+	}
+
 	// Initialize GLFW
 	const auto GlfwErrorCallback = [](const int ErrorCode, const char *const Description)
 	{
@@ -1001,6 +1316,10 @@ int main(const int argc, const char *const *argv)
 	const auto renderThreadConfig = RenderThreadConfig{
 		.gltfFile = gltfFile,
 		.Window = Window,
+		.cacheDirectory = cacheDirectoryOption,
+		.drawMode = drawMode,
+		.parallelRecording = parallelRecording,
+		.lodPixelError = lodPixelError,
 	};
 
 	const auto renderThread = std::jthread(
@@ -0,0 +1,281 @@
+#include "gltf/loader.h"
+#include "headless.h"
+
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+constexpr auto WIDTH = 1440u;
+constexpr auto HEIGHT = 900u;
+
+namespace
+{
+
+std::vector<std::filesystem::path> findAssets(const std::filesystem::path& directory)
+{
+	const auto isAsset = [](const std::filesystem::directory_entry& entry) {
+		const auto extension = entry.path().extension();
+		return entry.is_regular_file() && (extension == ".gltf" || extension == ".glb");
+	};
+
+	auto result = std::filesystem::recursive_directory_iterator(directory)
+		| std::views::filter(isAsset)
+		| std::views::transform([](const std::filesystem::directory_entry& entry) { return entry.path(); })
+		| std::ranges::to<std::vector>();
+
+	// stable order, so reports can be compared between runs
+	std::ranges::sort(result);
+
+	return result;
+}
+
+boost::json::object makeStats(std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		return {};
+	}
+
+	std::ranges::sort(samples);
+
+	// nearest-rank percentile
+	const auto percentile = [&](const double p) {
+		const auto rank = static_cast<size_t>(std::ceil(p * samples.size()));
+		return samples[std::clamp(rank, size_t(1), samples.size()) - 1];
+	};
+
+	return {
+		{ "min", samples.front() },
+		{ "median", percentile(0.5) },
+		{ "p99", percentile(0.99) },
+	};
+}
+
+boost::json::object benchmarkAsset(
+	const std::filesystem::path& path,
+	const uint32_t iterations,
+	const uint32_t frameCount,
+	const std::optional<std::filesystem::path>& cacheDirectory,
+	const gltf::DrawMode drawMode,
+	const bool parallelRecording,
+	const float lodPixelError,
+	std::string& deviceName)
+{
+	using clock = std::chrono::steady_clock;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	auto loadTimings = std::vector<gltf::LoadTimings>();
+	auto totalTimes = std::vector<double>();
+	auto frameTimings = HeadlessRenderer::FrameTimings{};
+
+	for (auto iteration = 0u; iteration < iterations; ++iteration)
+	{
+		// a fresh device and loader per iteration, so cached samplers and pipelines don't hide cold load costs
+		auto renderer = HeadlessRenderer({
+			.extent = { .width = WIDTH, .height = HEIGHT },
+			.cacheDirectory = cacheDirectory,
+			.drawMode = drawMode,
+			.parallelRecording = parallelRecording,
+			.lodPixelError = lodPixelError,
+		});
+		deviceName = renderer.getDeviceName();
+
+		auto timings = gltf::LoadTimings{};
+
+		const auto start = clock::now();
+		const auto model = renderer.getLoader().loadFromFile(path.string(), &timings);
+		totalTimes.push_back(milliseconds(clock::now() - start).count());
+
+		loadTimings.push_back(timings);
+
+		if (iteration + 1 == iterations)
+		{
+			frameTimings = renderer.render(model, frameCount);
+		}
+	}
+
+	const auto phases = {
+		std::make_pair("modelCache", &gltf::LoadTimings::modelCache),
+		std::make_pair("parse", &gltf::LoadTimings::parse),
+		std::make_pair("imageDecode", &gltf::LoadTimings::imageDecode),
+		std::make_pair("optimizeIndices", &gltf::LoadTimings::optimizeIndices),
+		std::make_pair("buildLods", &gltf::LoadTimings::buildLods),
+		std::make_pair("loadBuffers", &gltf::LoadTimings::loadBuffers),
+		std::make_pair("createMaterialsSSBO", &gltf::LoadTimings::createMaterialsSSBO),
+		std::make_pair("createImages", &gltf::LoadTimings::createImages),
+		std::make_pair("upload", &gltf::LoadTimings::upload),
+		std::make_pair("createPipelines", &gltf::LoadTimings::createPipelines),
+		std::make_pair("descriptorWrites", &gltf::LoadTimings::descriptorWrites),
+	};
+
+	auto load = boost::json::object();
+
+	for (const auto& [name, member] : phases)
+	{
+		const auto samples = loadTimings
+			| std::views::transform([&](const gltf::LoadTimings& timings) { return (timings.*member).count(); })
+			| std::ranges::to<std::vector>();
+
+		load[name] = makeStats(samples);
+	}
+
+	load["total"] = makeStats(totalTimes);
+
+	auto result = boost::json::object{
+		{ "path", path.generic_string() },
+		{ "load", std::move(load) },
+		{ "frame", {
+			{ "cpu", makeStats(frameTimings.cpu) },
+			{ "gpu", makeStats(frameTimings.gpu) },
+			{ "stateCommands", {
+				{ "issued", frameTimings.commands.issued },
+				{ "skipped", frameTimings.commands.skipped },
+			}},
+		}},
+	};
+
+	// only the loads that imported the asset instead of mapping the cache entry have these
+	if (const auto& first = loadTimings.front(); first.vertexCacheBefore.triangleCount > 0)
+	{
+		result["vertexCache"] = {
+			{ "triangles", first.vertexCacheBefore.triangleCount },
+			{ "vertices", first.vertexCacheBefore.vertexCount },
+			{ "acmrBefore", first.vertexCacheBefore.getAcmr() },
+			{ "acmrAfter", first.vertexCacheAfter.getAcmr() },
+			{ "atvrBefore", first.vertexCacheBefore.getAtvr() },
+			{ "atvrAfter", first.vertexCacheAfter.getAtvr() },
+		};
+	}
+
+	if (not frameTimings.culling.empty())
+	{
+		const auto getStats = [&](const uint32_t CullStats::* member) {
+			return makeStats(frameTimings.culling
+				| std::views::transform([&](const CullStats& stats) { return double(stats.*member); })
+				| std::ranges::to<std::vector>());
+		};
+
+		result["culling"] = {
+			{ "draws", frameTimings.culling.front().draws },
+			{ "visibleDraws", getStats(&CullStats::visibleDraws) },
+			{ "occludedDraws", getStats(&CullStats::occludedDraws) },
+			{ "lateDraws", getStats(&CullStats::lateDraws) },
+		};
+	}
+
+	if (not frameTimings.clusterCulling.empty())
+	{
+		const auto getStats = [&](const uint32_t ClusterCullStats::* member) {
+			return makeStats(frameTimings.clusterCulling
+				| std::views::transform([&](const ClusterCullStats& stats) { return double(stats.*member); })
+				| std::ranges::to<std::vector>());
+		};
+
+		result["clusterCulling"] = {
+			{ "meshlets", frameTimings.clusterCulling.front().meshlets },
+			{ "triangles", frameTimings.clusterCulling.front().triangles },
+			{ "visibleMeshlets", getStats(&ClusterCullStats::visibleMeshlets) },
+			{ "visibleTriangles", getStats(&ClusterCullStats::visibleTriangles) },
+		};
+	}
+
+	if (not frameTimings.passes.empty())
+	{
+		const auto getStats = [&](const double HeadlessRenderer::PassTimings::* member) {
+			return makeStats(frameTimings.passes
+				| std::views::transform([&](const HeadlessRenderer::PassTimings& timings) { return timings.*member; })
+				| std::ranges::to<std::vector>());
+		};
+
+		result["frame"].as_object()["passes"] = {
+			{ "early", getStats(&HeadlessRenderer::PassTimings::early) },
+			{ "depthPyramid", getStats(&HeadlessRenderer::PassTimings::depthPyramid) },
+			{ "late", getStats(&HeadlessRenderer::PassTimings::late) },
+		};
+	}
+
+	return result;
+}
+
+}
+
+int main(const int argc, const char* const* argv)
+{
+	auto app = CLI::App("Gorgon load and frame time benchmark");
+
+	auto assetDirectory = std::filesystem::path();
+	app.add_option("assetDirectory", assetDirectory, "Directory searched recursively for glTF assets")->required();
+
+	auto iterations = 5u;
+	app.add_option("--iterations", iterations, "Number of loads per asset")->check(CLI::PositiveNumber);
+
+	auto frameCount = 300u;
+	app.add_option("--frames", frameCount, "Number of frames rendered per asset");
+
+	auto outputFile = std::filesystem::path("gorgon-bench.json");
+	app.add_option("--output", outputFile, "Output JSON file");
+
+	// off by default, so every iteration measures a cold load
+	auto cacheDirectory = std::filesystem::path();
+	app.add_option("--cache-dir", cacheDirectory, "Directory for the model and pipeline caches, warm iterations load from them");
+
+	auto drawMode = gltf::DrawMode::eIndirect;
+	app.add_option("--draw-mode", drawMode, "direct: a draw call per primitive, indirect: a multi-draw indirect call per batch, culled: indirect after GPU frustum culling, cpu-culled: direct after CPU frustum culling, occlusion-culled: culled twice per frame, the second time against the depth of the first, cluster-culled: indirect with the meshlets of each draw culled on the GPU")
+		->transform(CLI::CheckedTransformer(DRAW_MODES, CLI::ignore_case));
+
+	auto parallelRecording = false;
+	app.add_flag("--parallel-recording", parallelRecording, "Record the draws on every thread into secondary command buffers");
+
+	auto lodPixelError = 1.0f;
+	app.add_option("--lod-pixel-error", lodPixelError, "Largest error in pixels of the simplified levels of detail drawn, 0 draws the full meshes")
+		->check(CLI::NonNegativeNumber);
+
+	CLI11_PARSE(app, argc, argv);
+
+	const auto assets = findAssets(assetDirectory);
+	const auto cacheDirectoryOption = cacheDirectory.empty() ? std::nullopt : std::make_optional(cacheDirectory);
+
+	if (assets.empty())
+	{
+		fmt::println(std::cerr, "No glTF assets found in {}", assetDirectory.string());
+		return EXIT_FAILURE;
+	}
+
+	auto results = boost::json::array();
+	auto deviceName = std::string();
+
+	for (const auto& asset : assets)
+	{
+		fmt::println(std::clog, "{}", asset.string());
+
+		// one broken asset doesn't end the run, it's left out of the report
+		try
+		{
+			results.push_back(benchmarkAsset(asset, iterations, frameCount, cacheDirectoryOption, drawMode, parallelRecording, lodPixelError, deviceName));
+		}
+		catch (const std::exception& e)
+		{
+			fmt::println(std::clog, "skipping {}: {}", asset.string(), e.what());
+		}
+	}
+
+	const auto report = boost::json::object{
+		{ "device", deviceName },
+		{ "iterations", iterations },
+		{ "frames", frameCount },
+		{ "drawMode", std::ranges::find(DRAW_MODES, drawMode, &decltype(DRAW_MODES)::value_type::second)->first },
+		{ "parallelRecording", parallelRecording },
+		{ "lodPixelError", lodPixelError },
+		{ "assets", std::move(results) },
+	};
+
+	auto file = std::ofstream(outputFile);
+
+	if (!file)
+	{
+		fmt::println(std::cerr, "Failed to open {}", outputFile.string());
+		return EXIT_FAILURE;
+	}
+
+	file << boost::json::serialize(report) << '\n';
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// TODO: temp solution, rework == add input
+class OrbitCamera
+{
+public:
+	float dolly = 0.5f;					   // distance from center
+	float azimuth = 0.0f;				   // horizontal angle (radians)
+	float altitude = glm::radians(30.0f);  // vertical angle (radians)
+	float spinSpeed = glm::radians(45.0f); // radians per second
+
+	void update(const float deltaTime)
+	{
+		azimuth += spinSpeed * deltaTime;
+	}
+
+	glm::mat4 getViewProj(const vk::Extent2D& surfaceExtent) const
+	{
+		// view matrix
+		constexpr auto target = glm::vec3(0);
+		constexpr auto up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		const auto altitude_sin = glm::sin(altitude);
+		const auto altitude_cos = glm::cos(altitude);
+		const auto azimuth_sin = glm::sin(azimuth);
+		const auto azimuth_cos = glm::cos(azimuth);
+
+		const auto x = dolly * altitude_cos * azimuth_sin;
+		const auto y = dolly * altitude_sin;
+		const auto z = dolly * altitude_cos * azimuth_cos;
+
+		const auto position = glm::vec3(x, y, z);
+
+		const auto view = glm::lookAt(position, target, up);
+
+		// projection matrix
+		const auto width = static_cast<float>(surfaceExtent.width);
+		const auto height = static_cast<float>(surfaceExtent.height);
+		constexpr float fovY = glm::radians(45.0f);
+		const float aspect = width / height;
+		constexpr float nearPlane = 0.01f;
+		constexpr float farPlane = 100.0f;
+
+		const auto proj = glm::perspective(fovY, aspect, nearPlane, farPlane);
+
+		return proj * view;
+	}
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <shaders/shared.inl>
+
+namespace gltf
+{
+
+struct PrimitivePipelineInfo
+{
+	vk::Format position; // float or, with KHR_mesh_quantization, 8 and 16 bit ones
+	std::optional<vk::Format> normal;
+	std::optional<vk::Format> tangent;
+	std::optional<vk::Format> texcoord0;
+	std::optional<vk::Format> texcoord1;
+	std::optional<vk::Format> color0;
+	bool hasBaseColorTexture;
+	bool hasMetallicRoughnessTexture;
+	bool hasNormalTexture;
+	bool hasOcclusionTexture;
+	bool hasEmissiveTexture;
+
+	auto operator<=>(const PrimitivePipelineInfo&) const = default;
+};
+
+}
+
+namespace std {
+
+template<>
+struct hash<gltf::PrimitivePipelineInfo> {
+	size_t operator()(const gltf::PrimitivePipelineInfo& val) const {
+		return boost::pfr::hash_fields(val);
+	}
+};
+
+}
+
+namespace gltf
+{
+
+// of each attribute in an interleaved vertex, what glTF requires of vertex attributes
+constexpr auto VERTEX_ATTRIBUTE_ALIGNMENT = vk::DeviceSize(4);
+
+// Flattened CPU side of a model, everything needed to create it on the GPU.
+// Tables are plain data, so the model cache writes and maps them as is.
+struct Asset
+{
+	// decoded texels
+	struct Image
+	{
+		std::span<const std::byte> texels;
+		vk::Format format;
+		vk::Extent3D extent;
+	};
+
+	struct Sampler
+	{
+		vk::Filter magFilter;
+		vk::Filter minFilter;
+		vk::SamplerAddressMode addressModeU;
+		vk::SamplerAddressMode addressModeV;
+
+		bool operator==(const Sampler&) const = default;
+	};
+
+	struct BufferRange
+	{
+		uint32_t buffer;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		vk::DeviceSize stride;
+	};
+
+	struct Primitive
+	{
+		PrimitivePipelineInfo pipelineInfo;
+		vk::PrimitiveTopology topology;
+		uint32_t count;
+		uint32_t materialIndex;
+		uint32_t vertexBufferCount;
+		// the positions alone, for passes that only need depth, then the other attributes interleaved
+		// in attribute order, each aligned to VERTEX_ATTRIBUTE_ALIGNMENT, unless there are none
+		std::array<BufferRange, VERTEX_INPUT_NUM> vertexBuffers;
+		bool indexed;
+		vk::IndexType indexType;
+		BufferRange indices;
+		glm::vec3 boundsMin; // object space, from the POSITION accessor
+		glm::vec3 boundsMax;
+		uint32_t firstMeshlet;
+		uint32_t meshletCount; // 0 unless an indexed triangle list with positions
+		uint32_t firstLod; // into lods
+		uint32_t lodCount; // at least the full mesh
+	};
+
+	struct Mesh
+	{
+		uint32_t firstPrimitive;
+		uint32_t primitiveCount;
+	};
+
+	// node instances in scene order, the children of a node are contiguous
+	struct Node
+	{
+		glm::mat4 modelMatrix; // includes all parent transforms
+		int32_t mesh; // -1 if none
+		uint32_t firstChild;
+		uint32_t childCount;
+		uint32_t firstInstance; // into instanceTransforms
+		uint32_t instanceCount; // EXT_mesh_gpu_instancing, 0 if the mesh is drawn once at modelMatrix
+	};
+
+	struct Scene
+	{
+		uint32_t firstNode;
+		uint32_t nodeCount;
+	};
+
+	// files the asset was imported from, the glTF/GLB file first
+	std::vector<std::filesystem::path> sources;
+	std::vector<uint64_t> sourceHashes; // of the bytes imported from each source, empty without a model cache
+
+	std::vector<std::span<const std::byte>> buffers;
+	std::vector<Image> images;
+	std::vector<Sampler> samplers;
+	std::span<const std::byte> materials; // laid out like the shader's material array, default material last
+	uint32_t materialCount; // including the default material
+	std::span<const Primitive> primitives;
+	std::span<const Mesh> meshes;
+	std::span<const Node> nodes;
+	std::span<const glm::mat4> instanceTransforms; // relative to the node's modelMatrix
+	std::span<const Scene> scenes;
+	std::span<const Meshlet> meshlets;
+	std::span<const uint32_t> meshletVertices; // see MeshletData
+	std::span<const uint32_t> meshletTriangles;
+	std::span<const Lod> lods; // of every primitive, the levels of a primitive share its index range
+
+	// whatever the spans point into: the source files and decoded images, or the mapped cache entry
+	std::shared_ptr<const void> storage;
+};
+
+}
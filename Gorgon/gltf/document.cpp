@@ -0,0 +1,368 @@
+#include "document.h"
+
+namespace
+{
+
+constexpr auto GLB_MAGIC = 0x46546C67u; // "glTF"
+constexpr auto GLB_CHUNK_JSON = 0x4E4F534Au; // "JSON"
+constexpr auto GLB_CHUNK_BIN = 0x004E4942u; // "BIN\0"
+constexpr auto GLB_HEADER_SIZE = 12u;
+constexpr auto GLB_CHUNK_HEADER_SIZE = 8u;
+
+// tinygltf insists on loading every buffer and image itself, mapped ones get this 1 byte stand-in
+constexpr auto PLACEHOLDER_URI = "data:application/octet-stream;base64,AA==";
+
+using ByteSpan = std::span<const std::byte>;
+
+struct GlbChunks
+{
+	std::string_view json;
+	ByteSpan bin;
+};
+
+std::optional<GlbChunks> parseGlb(const ByteSpan data)
+{
+	const auto readU32 = [&](const size_t offset) {
+		auto result = uint32_t{};
+		std::memcpy(&result, data.data() + offset, sizeof(result));
+		return result;
+	};
+
+	if (data.size() < GLB_HEADER_SIZE || readU32(0) != GLB_MAGIC)
+	{
+		return std::nullopt;
+	}
+
+	if (const auto version = readU32(4); version != 2)
+	{
+		throw std::runtime_error(fmt::format("unsupported GLB version {}", version));
+	}
+	const auto length = std::min<size_t>(readU32(8), data.size());
+
+	auto result = GlbChunks{};
+
+	for (auto offset = size_t(GLB_HEADER_SIZE); offset + GLB_CHUNK_HEADER_SIZE <= length;)
+	{
+		const auto chunkLength = size_t(readU32(offset));
+		const auto chunkType = readU32(offset + 4);
+		const auto chunkOffset = offset + GLB_CHUNK_HEADER_SIZE;
+		const auto chunk = data.subspan(chunkOffset, std::min(chunkLength, length - chunkOffset));
+
+		if (chunkType == GLB_CHUNK_JSON && result.json.empty())
+		{
+			result.json = std::string_view(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		}
+		else if (chunkType == GLB_CHUNK_BIN && result.bin.empty())
+		{
+			result.bin = chunk;
+		}
+
+		offset = chunkOffset + chunkLength;
+	}
+
+	return result;
+}
+
+// relative URI of an external file, percent-decoded and interpreted as UTF-8
+std::filesystem::path uriToPath(const std::string_view uri)
+{
+	auto decoded = std::u8string();
+	decoded.reserve(uri.size());
+
+	for (auto i = size_t(0); i < uri.size(); ++i)
+	{
+		auto value = 0;
+
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			const auto [ptr, ec] = std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16);
+
+			if (ec == std::errc() && ptr == uri.data() + i + 3)
+			{
+				decoded.push_back(static_cast<char8_t>(value));
+				i += 2;
+				continue;
+			}
+		}
+
+		decoded.push_back(static_cast<char8_t>(uri[i]));
+	}
+
+	return std::filesystem::path(decoded);
+}
+
+size_t getSize(const boost::json::object& object, const boost::json::string_view key, const size_t defaultValue = 0)
+{
+	const auto* value = object.if_contains(key);
+	return value ? value->to_number<size_t>() : defaultValue;
+}
+
+struct ImageLoaderData
+{
+	gltf::Document& document;
+	const std::vector<std::optional<ByteSpan>>& imageSources;
+};
+
+// Only records where the encoded image is, decoding happens later in parallel
+bool storeImageData(
+	tinygltf::Image* image,
+	const int imageIndex,
+	std::string* err,
+	std::string* warn,
+	int reqWidth,
+	int reqHeight,
+	const unsigned char* bytes,
+	int size,
+	void* userData)
+{
+	auto& data = *static_cast<ImageLoaderData*>(userData);
+	auto& document = data.document;
+
+	assert(std::cmp_less(imageIndex, document.images.size()));
+
+	if (const auto& source = data.imageSources[imageIndex])
+	{
+		document.images[imageIndex] = source.value();
+	}
+	else
+	{
+		const auto begin = reinterpret_cast<const std::byte*>(bytes);
+		const auto& storage = document.imageStorage.emplace_back(begin, begin + size);
+		document.images[imageIndex] = storage;
+	}
+
+	return true;
+}
+
+}
+
+namespace gltf
+{
+
+Document loadDocument(const std::filesystem::path& path)
+{
+	auto document = Document{};
+
+	// a moved MappedFile keeps its address, spans stay valid while the vector grows
+	const auto mapFile = [&](const std::filesystem::path& filePath) {
+		document.paths.push_back(filePath);
+		return document.files.emplace_back(filePath).data();
+	};
+
+	const auto fileData = mapFile(path);
+	const auto glb = parseGlb(fileData);
+
+	const auto jsonText = glb ?
+		glb->json :
+		std::string_view(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+
+	auto json = boost::json::parse(jsonText);
+	auto& root = json.as_object();
+
+	const auto baseDir = path.parent_path();
+
+	// nullopt for data URIs, those are left to tinygltf
+	auto mappedBuffers = std::vector<std::optional<ByteSpan>>();
+
+	if (auto* buffers = root.if_contains("buffers"))
+	{
+		for (auto& value : buffers->as_array())
+		{
+			auto& buffer = value.as_object();
+			const auto byteLength = getSize(buffer, "byteLength");
+
+			const auto mapped = [&] -> std::optional<ByteSpan> {
+				const auto* uri = buffer.if_contains("uri");
+
+				if (not uri)
+				{
+					// GLB-stored buffer
+					if (not glb || glb->bin.size() < byteLength)
+					{
+						throw std::runtime_error(fmt::format("BIN chunk of {} is shorter than its buffer's {} bytes", path.generic_string(), byteLength));
+					}
+
+					return glb->bin.first(byteLength);
+				}
+
+				const auto uriString = std::string_view(uri->as_string());
+
+				if (uriString.starts_with("data:"))
+				{
+					return std::nullopt;
+				}
+
+				const auto bufferPath = baseDir / uriToPath(uriString);
+				const auto bufferData = mapFile(bufferPath);
+
+				if (bufferData.size() < byteLength)
+				{
+					throw std::runtime_error(fmt::format("{} is shorter than its buffer's {} bytes", bufferPath.generic_string(), byteLength));
+				}
+
+				return bufferData.first(byteLength);
+			}();
+
+			if (mapped)
+			{
+				buffer = { { "byteLength", 1 }, { "uri", PLACEHOLDER_URI } };
+			}
+
+			mappedBuffers.push_back(mapped);
+		}
+	}
+
+	// images in mapped buffer views or external files are decoded straight from the mapping
+	auto imageSources = std::vector<std::optional<ByteSpan>>();
+
+	if (auto* images = root.if_contains("images"))
+	{
+		for (auto& value : images->as_array())
+		{
+			auto& image = value.as_object();
+
+			const auto source = [&] -> std::optional<ByteSpan> {
+				if (const auto* uri = image.if_contains("uri"))
+				{
+					const auto uriString = std::string_view(uri->as_string());
+
+					if (uriString.starts_with("data:"))
+					{
+						return std::nullopt;
+					}
+
+					return mapFile(baseDir / uriToPath(uriString));
+				}
+
+				const auto* bufferViewIndex = image.if_contains("bufferView");
+
+				if (not bufferViewIndex)
+				{
+					return std::nullopt;
+				}
+
+				const auto& bufferView = root.at("bufferViews").as_array().at(bufferViewIndex->to_number<size_t>()).as_object();
+				const auto& buffer = mappedBuffers.at(getSize(bufferView, "buffer"));
+
+				return buffer.transform([&](const ByteSpan data) {
+					return data.subspan(getSize(bufferView, "byteOffset"), getSize(bufferView, "byteLength"));
+				});
+			}();
+
+			if (source)
+			{
+				image.erase("bufferView");
+				image.erase("mimeType");
+				image["uri"] = PLACEHOLDER_URI;
+			}
+
+			imageSources.push_back(source);
+		}
+	}
+
+	document.images.resize(imageSources.size());
+
+	const auto patchedJson = boost::json::serialize(json);
+
+	auto imageLoaderData = ImageLoaderData{
+		.document = document,
+		.imageSources = imageSources,
+	};
+
+	auto loader = tinygltf::TinyGLTF();
+	loader.SetImageLoader(storeImageData, &imageLoaderData);
+
+	auto error = std::string();
+	auto warning = std::string();
+
+	const auto result = loader.LoadASCIIFromString(
+		&document.model,
+		&error,
+		&warning,
+		patchedJson.data(),
+		static_cast<unsigned int>(patchedJson.size()),
+		baseDir.string()
+	);
+
+	if (not warning.empty())
+	{
+		fmt::println(std::clog, "{}: {}", path.generic_string(), warning);
+	}
+
+	if (not result)
+	{
+		throw std::runtime_error(fmt::format("cannot load {}: {}", path.generic_string(), error));
+	}
+
+	for (const auto& [mapped, buffer] : std::views::zip(mappedBuffers, document.model.buffers))
+	{
+		const auto data = reinterpret_cast<const std::byte*>(buffer.data.data());
+		document.buffers.push_back(mapped.value_or(ByteSpan(data, buffer.data.size())));
+	}
+
+	return document;
+}
+
+void DecodedImage::Deleter::operator()(stbi_uc* pixels) const
+{
+	stbi_image_free(pixels);
+}
+
+std::span<const std::byte> DecodedImage::data() const
+{
+	static constexpr auto FALLBACK_TEXEL = std::array{ std::byte(0xFF), std::byte(0xFF), std::byte(0xFF), std::byte(0xFF) };
+
+	if (not pixels)
+	{
+		return FALLBACK_TEXEL;
+	}
+
+	const auto size = size_t(extent.width) * extent.height * 4;
+	return std::span(reinterpret_cast<const std::byte*>(pixels.get()), size);
+}
+
+std::vector<DecodedImage> decodeImages(const Document& document, ThreadPool& threadPool)
+{
+	auto result = std::vector<DecodedImage>(document.images.size());
+
+	threadPool.parallelFor(document.images.size(), [&](const size_t index) {
+		const auto& encoded = document.images[index];
+
+		if (encoded.empty())
+		{
+			return;
+		}
+
+		auto width = 0;
+		auto height = 0;
+		auto components = 0;
+
+		auto* pixels = stbi_load_from_memory(
+			reinterpret_cast<const stbi_uc*>(encoded.data()),
+			static_cast<int>(encoded.size()),
+			&width,
+			&height,
+			&components,
+			STBI_rgb_alpha
+		);
+
+		if (not pixels)
+		{
+			fmt::println(std::clog, "failed to decode image {}: {}", index, stbi_failure_reason());
+			return;
+		}
+
+		result[index] = DecodedImage{
+			.pixels = std::unique_ptr<stbi_uc, DecodedImage::Deleter>(pixels),
+			.extent = vk::Extent3D{
+				.width = static_cast<uint32_t>(width),
+				.height = static_cast<uint32_t>(height),
+				.depth = 1,
+			},
+		};
+	});
+
+	return result;
+}
+
+}
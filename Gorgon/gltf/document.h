@@ -0,0 +1,49 @@
+#pragma once
+#include "util/mapped_file.h"
+#include "util/thread_pool.h"
+
+namespace gltf
+{
+
+// Parsed glTF/GLB file. Buffers stored in the .glb itself or in external files
+// are memory mapped, tinygltf never copies them.
+struct Document
+{
+	tinygltf::Model model;
+
+	// keeps the spans below valid
+	std::vector<MappedFile> files;
+	std::vector<std::filesystem::path> paths; // of files, the glTF/GLB file first
+
+	// contents of model.buffers, model.buffers[i].data only holds a placeholder for mapped buffers
+	std::vector<std::span<const std::byte>> buffers;
+
+	// encoded image files, one per model.images entry. tinygltf doesn't decode them,
+	// model.images[i].image stays empty
+	std::vector<std::span<const std::byte>> images;
+
+	// images tinygltf only handed out temporarily (data URIs), the spans above point here
+	std::vector<std::vector<std::byte>> imageStorage;
+};
+
+// RGBA8 texels
+struct DecodedImage
+{
+	struct Deleter
+	{
+		void operator()(stbi_uc* pixels) const;
+	};
+
+	// null for an image that has no data or failed to decode, it stands in as a single white texel
+	std::unique_ptr<stbi_uc, Deleter> pixels;
+	vk::Extent3D extent = { .width = 1, .height = 1, .depth = 1 };
+
+	std::span<const std::byte> data() const;
+};
+
+Document loadDocument(const std::filesystem::path& path);
+
+// Decodes all of document.images, one image per task
+std::vector<DecodedImage> decodeImages(const Document& document, ThreadPool& threadPool);
+
+}
@@ -1,15 +1,27 @@
 #include "loader.h"
+#include "util/hash.h"
 #include <shaders/shared.inl>
 
 namespace
 {
 
+vk::raii::Semaphore createTimelineSemaphore(const vk::raii::Device& device)
+{
+	const auto typeCreateInfo = vk::SemaphoreTypeCreateInfo{
+		.semaphoreType = vk::SemaphoreType::eTimeline,
+		.initialValue = 0,
+	};
+
+	const auto createInfo = vk::SemaphoreCreateInfo{ .pNext = &typeCreateInfo };
+	return device.createSemaphore(createInfo);
+}
+
 vk::raii::DescriptorPool createDescriptorPool(const vk::raii::Device& device)
 {
 	const auto poolSizes = {
 		vk::DescriptorPoolSize{
 			.type = vk::DescriptorType::eStorageBuffer,
-			.descriptorCount = 256u, // TODO
+			.descriptorCount = 1024u, // TODO
 		},
 	};
 
@@ -43,318 +55,892 @@ namespace gltf
 {
 
 Loader::Loader(const CreateInfo& info)
-	: device(info.device)
+	: pipelineCache(info.physicalDevice, info.device, info.pipelineCachePath)
+	, device(info.device)
 	, vma(info.vma)
 	, transferCommandBuffer(info.transferCommandBuffer)
 	, transferQueue(info.transferQueue)
+	, transferQueueMutex(info.transferQueueMutex)
+	, transferQueueFamilyIndex(info.transferQueueFamilyIndex)
+	, graphicsQueueFamilyIndex(info.graphicsQueueFamilyIndex)
+	, threadPool(info.threadPool)
+	, framesInFlight(info.framesInFlight)
+	, maxClusterIndexCount([&] {
+		if (not info.clusterCulling)
+		{
+			return uint64_t(0);
+		}
+
+		const auto maxRange = vk::DeviceSize(info.physicalDevice.getProperties().limits.maxStorageBufferRange);
+		return std::min(info.clusterIndexBudget, maxRange) / sizeof(uint32_t);
+	}())
+	, uploadTimeline(createTimelineSemaphore(info.device))
+	, stagingRing(info.vma, info.stagingRingSize)
 	, pipelineLayoutData(createPipelineLayoutData(info.device))
 	, descriptorPool(createDescriptorPool(info.device))
 	, bindlessDescriptorPool(createBindlessDescriptorPool(info.device))
 	, shader(Shader(info.device, "shaders/combined.spv"))
 	, surfaceFormat(info.surfaceFormat)
 	, depthFormat(info.depthFormat)
+	, modelCache(info.modelCacheDirectory.transform([&](const std::filesystem::path& directory) {
+		// packed materials follow the shader's layout, entries must not outlive it
+		const auto reflection = boost::json::serialize(shader.getReflection());
+		return ModelCache(directory, hashBytes(std::as_bytes(std::span(reflection))));
+	}))
+	, cullShader(Shader(info.device, "shaders/cull.spv"))
+	, occlusionCullShader(Shader(info.device, "shaders/occlusion_cull.spv"))
+	, clusterCullShader(Shader(info.device, "shaders/cluster_cull.spv"))
+	, cullingPipelineData(createCullingPipelineData())
 {}
 
-vk::Sampler Loader::getSampler(const vk::SamplerCreateInfo& info)
+Loader::~Loader()
 {
-	auto it = samplers.find(info);
-	if (it == samplers.end()) {
-		const auto& [new_it, inserted] = samplers.emplace(info, device.createSampler(info));
-		assert(inserted);
+	const auto lock = std::scoped_lock(pendingStoresMutex);
 
-		return new_it->second;
+	for (const auto& store : pendingStores)
+	{
+		store.wait();
 	}
-	return it->second;
 }
 
-vk::Pipeline Loader::getPipeline(const PrimitivePipelineInfo& info)
+Model Loader::loadFromFile(const std::string_view& gltfFile, LoadTimings* timings)
 {
-	const auto createPipeline = [&]
+	auto localTimings = LoadTimings{};
+	auto& loadTimings = timings ? *timings : localTimings;
+	loadTimings = LoadTimings{};
+
+	const auto path = std::filesystem::path(gltfFile);
+
+	const auto cachedAsset = [&] -> std::optional<Asset> {
+		if (not modelCache)
+		{
+			return std::nullopt;
+		}
+
+		const auto timer = ScopedTimer(loadTimings.modelCache);
+		return modelCache->load(path);
+	}();
+
+	if (cachedAsset)
 	{
-		auto bindingDescriptions = vku::small::vector<vk::VertexInputBindingDescription, VERTEX_INPUT_NUM>();
-		auto attributeDescriptions = vku::small::vector<vk::VertexInputAttributeDescription, VERTEX_INPUT_NUM>();
+		return createModel(*cachedAsset, loadTimings);
+	}
 
-		auto addDescription = [&, bindingIndex = uint32_t(0)](const uint32_t location, const vk::Format format) mutable {
-			const auto bindingDescription = vk::VertexInputBindingDescription{
-				.binding = bindingIndex++,
-				.inputRate = vk::VertexInputRate::eVertex,
-			};
+	auto asset = importFile(path, loadTimings);
+	auto model = createModel(asset, loadTimings);
 
-			const auto attributeDescription = vk::VertexInputAttributeDescription{
-				.location = location,
-				.binding = bindingDescription.binding,
-				.format = format,
-			};
+	// writing the entry stays off the load, the task keeps the asset's storage alive
+	if (modelCache)
+	{
+		const auto lock = std::scoped_lock(pendingStoresMutex);
+
+		std::erase_if(pendingStores, [](const std::future<void>& store) {
+			return store.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		});
+
+		pendingStores.push_back(threadPool.submit([this, asset = std::move(asset)] {
+			modelCache->store(asset);
+		}));
+	}
 
-			bindingDescriptions.emplace_back(bindingDescription);
-			attributeDescriptions.emplace_back(attributeDescription);
+	return model;
+}
+
+Model Loader::createModel(const Asset& asset, LoadTimings& loadTimings)
+{
+	// every permutation the model needs is compiled up front on the thread pool,
+	// outside of loadMutex so concurrent loads compile at the same time too
+	{
+		const auto timer = ScopedTimer(loadTimings.createPipelines);
+		createPipelines(asset.primitives);
+	}
+
+	const auto lock = std::scoped_lock(loadMutex);
+
+	// buffers, materials and images go out in a single submission
+	auto uploadBatch = UploadBatch({
+		.device = device,
+		.stagingRing = stagingRing,
+		.commandBuffer = transferCommandBuffer,
+		.queue = transferQueue,
+		.queueMutex = transferQueueMutex,
+		.timeline = uploadTimeline,
+		.timelineValue = uploadTimelineValue,
+		.srcQueueFamilyIndex = transferQueueFamilyIndex,
+		.dstQueueFamilyIndex = graphicsQueueFamilyIndex,
+	});
+
+	auto buffers = [&] {
+		const auto timer = ScopedTimer(loadTimings.loadBuffers);
+		return loadBuffers(uploadBatch, asset.buffers);
+	}();
+
+	auto materialsSSBO = [&] {
+		const auto timer = ScopedTimer(loadTimings.createMaterialsSSBO);
+		return createMaterialsSSBO(uploadBatch, asset.materials);
+	}();
+
+	auto imageData = [&] {
+		const auto timer = ScopedTimer(loadTimings.createImages);
+		return createImages(uploadBatch, asset.images);
+	}();
+
+	const auto samplers = [&] {
+		const auto transform = [&](const Asset::Sampler& sampler) {
+			const auto samplerInfo = vk::SamplerCreateInfo{
+				.magFilter = sampler.magFilter,
+				.minFilter = sampler.minFilter,
+				.addressModeU = sampler.addressModeU,
+				.addressModeV = sampler.addressModeV,
+				//.anisotropyEnable = true, // TODO
 			};
 
-		// POSITION
-		addDescription(0, vk::Format::eR32G32B32Sfloat);
+			return getSampler(samplerInfo);
+		};
 
-		union {
-			PrimitiveFlags data;
-			PrimitiveFlagsInt packed = 0;
+		return asset.samplers
+			| std::views::transform(transform)
+			| std::ranges::to<std::vector>();
+	}();
 
-			static_assert(sizeof(packed) >= sizeof(data));
-		} primitiveFlags;
+	const auto createPrimitive = [&](const Asset::Primitive& primitive) {
+		auto vertexBindData = Primitive::VertexBindData();
 
-		// NORMAL
-		if (info.hasNormal)
+		for (const auto& range : std::span(primitive.vertexBuffers).first(primitive.vertexBufferCount))
 		{
-			addDescription(1, vk::Format::eR32G32B32Sfloat);
-			primitiveFlags.data.normal = 1;
+			vertexBindData.add(*buffers[range.buffer].vmaBuffer, range.offset, range.size, range.stride);
 		}
 
-		// TANGENT
-		if (info.hasTangent)
-		{
-			addDescription(2, vk::Format::eR32G32B32A32Sfloat);
-			primitiveFlags.data.tangent = 1;
-		}
+		auto indexedData = [&] -> decltype(Primitive::indexedData) {
+			if (not primitive.indexed)
+			{
+				return std::nullopt;
+			}
+
+			const auto& range = primitive.indices;
 
-		const auto checkTexcoordFormat = [](const vk::Format val) {
-			const auto formats = {
-				vk::Format::eR32G32Sfloat,
-				vk::Format::eR8G8Unorm,
-				vk::Format::eR16G16Unorm,
+			return Primitive::IndexedData{
+				.buffer = *buffers[range.buffer].vmaBuffer,
+				.offset = range.offset,
+				.size = range.size,
+				.type = primitive.indexType,
 			};
+		}();
+
+		return Primitive{
+			.vertexBindData = std::move(vertexBindData),
+			.topology = primitive.topology,
+			.pipeline = getPipeline(primitive.pipelineInfo),
+			.count = primitive.count,
+			.indexedData = std::move(indexedData),
+			.materialIndex = primitive.materialIndex,
+			.firstMeshlet = primitive.firstMeshlet,
+			.meshletCount = primitive.meshletCount,
+			.firstLod = primitive.firstLod,
+			.lodCount = primitive.lodCount,
+			.bounds = { .min = primitive.boundsMin, .max = primitive.boundsMax },
+		};
+	};
+
+	auto primitives = asset.primitives
+		| std::views::transform(createPrimitive)
+		| std::ranges::to<std::vector>();
+
+	// depth first, children after their parent
+	const auto createDrawList = [&](const Asset::Scene& scene) {
+		auto drawList = DrawList();
 
-			for (const auto format : formats) {
-				if (format == val)
+		const auto addNodes = [&](this auto self, const std::span<const Asset::Node> nodes) -> void {
+			for (const auto& node : nodes)
+			{
+				if (node.mesh != -1)
 				{
-					return true;
+					const auto& mesh = asset.meshes[node.mesh];
+
+					const auto addMesh = [&](const glm::mat4& modelMatrix) {
+						for (auto index = mesh.firstPrimitive; index < mesh.firstPrimitive + mesh.primitiveCount; ++index)
+						{
+							drawList.add(modelMatrix, index, primitives[index]);
+						}
+					};
+
+					if (node.instanceCount == 0)
+					{
+						addMesh(node.modelMatrix);
+					}
+
+					// a draw per instance, the draw list instances them again
+					for (const auto& transform : asset.instanceTransforms.subspan(node.firstInstance, node.instanceCount))
+					{
+						addMesh(node.modelMatrix * transform);
+					}
 				}
+
+				self(asset.nodes.subspan(node.firstChild, node.childCount));
 			}
+		};
+
+		addNodes(asset.nodes.subspan(scene.firstNode, scene.nodeCount));
+
+		return drawList;
+	};
+
+	auto drawLists = asset.scenes
+		| std::views::transform(createDrawList)
+		| std::ranges::to<std::vector>();
+
+	auto drawRecords = std::vector<DrawRecord>();
+	auto batchRecords = std::vector<BatchRecord>();
+	auto indirectCommands = std::vector<std::byte>();
+	auto clusterData = DrawList::ClusterData{ .maxIndexCount = maxClusterIndexCount };
+
+	for (auto& drawList : drawLists)
+	{
+		drawList.build(primitives, drawRecords, batchRecords, indirectCommands, clusterData);
+	}
+
+	// descriptors and buffers need a size even without draws
+	if (drawRecords.empty())
+	{
+		drawRecords.emplace_back();
+		batchRecords.emplace_back();
+		indirectCommands.resize(sizeof(vk::DrawIndexedIndirectCommand));
+	}
+
+	// without clustered batches nothing reads the cluster commands
+	if (clusterData.commands.empty())
+	{
+		clusterData.commands.resize(sizeof(vk::DrawIndexedIndirectCommand));
+	}
+
+	// and without meshlets
+	const auto emptyMeshlets = std::array{ Meshlet() };
+	const auto emptyIndices = std::array{ 0u };
+
+	const auto meshlets = asset.meshlets.empty() ? std::span(emptyMeshlets) : asset.meshlets;
+	const auto meshletVertices = asset.meshletVertices.empty() ? std::span(emptyIndices) : asset.meshletVertices;
+	const auto meshletTriangles = asset.meshletTriangles.empty() ? std::span(emptyIndices) : asset.meshletTriangles;
+
+	if (clusterData.records.empty())
+	{
+		clusterData.records.emplace_back();
+	}
+
+	auto drawRecordsSSBO = createDeviceBuffer(
+		uploadBatch,
+		std::as_bytes(std::span(drawRecords)),
+		vk::BufferUsageFlagBits::eStorageBuffer
+	);
 
-			return false;
+	auto batchRecordsSSBO = createDeviceBuffer(
+		uploadBatch,
+		std::as_bytes(std::span(batchRecords)),
+		vk::BufferUsageFlagBits::eStorageBuffer
+	);
+
+	auto indirectCommandsBuffer = createDeviceBuffer(uploadBatch, indirectCommands, vk::BufferUsageFlagBits::eIndirectBuffer);
+
+	// every primitive has at least its full mesh, unless there are none
+	const auto emptyLods = std::array{ Lod() };
+	const auto lods = asset.lods.empty() ? std::span(emptyLods) : asset.lods;
+
+	auto lodsSSBO = createDeviceBuffer(uploadBatch, std::as_bytes(lods), vk::BufferUsageFlagBits::eStorageBuffer);
+
+	auto meshletsSSBO = createDeviceBuffer(uploadBatch, std::as_bytes(meshlets), vk::BufferUsageFlagBits::eStorageBuffer);
+	auto meshletVerticesSSBO = createDeviceBuffer(uploadBatch, std::as_bytes(meshletVertices), vk::BufferUsageFlagBits::eStorageBuffer);
+	auto meshletTrianglesSSBO = createDeviceBuffer(uploadBatch, std::as_bytes(meshletTriangles), vk::BufferUsageFlagBits::eStorageBuffer);
+
+	auto clusterRecordsSSBO = createDeviceBuffer(
+		uploadBatch,
+		std::as_bytes(std::span(clusterData.records)),
+		vk::BufferUsageFlagBits::eStorageBuffer
+	);
+
+	// copied into the frame's commands before each cluster cull
+	auto clusterCommandsBuffer = createDeviceBuffer(uploadBatch, clusterData.commands, vk::BufferUsageFlagBits::eTransferSrc);
+
+	// nothing was visible before the first frame
+	auto visibilityBuffer = createDeviceBuffer(
+		uploadBatch,
+		std::vector<std::byte>(drawRecords.size() * sizeof(uint32_t)),
+		vk::BufferUsageFlagBits::eStorageBuffer
+	);
+
+	// the rest of the model is built while the GPU copies
+	{
+		const auto timer = ScopedTimer(loadTimings.upload);
+
+		uploadBatch.submit();
+	}
+
+	const auto descriptorWritesStart = ScopedTimer::clock::now();
+
+	auto descriptorSetsRAII = [&] {
+		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
+			.descriptorPool = descriptorPool,
+		}.setSetLayouts(*pipelineLayoutData.descriptorSetLayout);
+
+		return device.allocateDescriptorSets(allocateInfo);
+	}(); 
+
+	auto bindlessDescriptorSetsRAII = [&] {
+		constexpr auto descriptorCount = 256u;
+
+		const auto countInfo = vk::DescriptorSetVariableDescriptorCountAllocateInfo{}
+			.setDescriptorCounts(descriptorCount);
+
+		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
+			.pNext = &countInfo,
+			.descriptorPool = bindlessDescriptorPool,
+		}.setSetLayouts(*pipelineLayoutData.bindlessDescriptorSetLayout);
+
+		return device.allocateDescriptorSets(allocateInfo);
+	}();
+
+	auto descriptorSets = std::vector<vk::DescriptorSet>();
+	descriptorSets.reserve(descriptorSetsRAII.size() + bindlessDescriptorSetsRAII.size());
+
+	for (const auto& descriptorSet : descriptorSetsRAII)
+	{
+		descriptorSets.push_back(*descriptorSet);
+	}
+
+	for (auto& descriptorSet : bindlessDescriptorSetsRAII)
+	{
+		descriptorSets.push_back(*descriptorSet);
+	}
+
+	std::ranges::move(bindlessDescriptorSetsRAII, std::back_inserter(descriptorSetsRAII));
+	bindlessDescriptorSetsRAII.clear();
+
+	auto descriptorWrites = std::vector<vk::WriteDescriptorSet>();
+	descriptorWrites.reserve(3);
+
+	const auto materialsBufferInfo = vk::DescriptorBufferInfo{
+		.buffer = *materialsSSBO.vmaBuffer,
+		.range = vk::WholeSize,
+	};
+
+	const auto drawRecordsBufferInfo = vk::DescriptorBufferInfo{
+		.buffer = *drawRecordsSSBO.vmaBuffer,
+		.range = vk::WholeSize,
+	};
+
+	// the infos are referenced until the update below
+	const auto addStorageBufferWrite = [&](const uint32_t binding, const vk::DescriptorBufferInfo& bufferInfo) {
+		const auto descriptorWrite = vk::WriteDescriptorSet{
+			.dstSet = descriptorSets[0],
+			.dstBinding = binding,
+			.dstArrayElement = 0,
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+		}.setBufferInfo(bufferInfo);
+
+		descriptorWrites.push_back(descriptorWrite);
+	};
+
+	addStorageBufferWrite(0, materialsBufferInfo);
+	addStorageBufferWrite(1, drawRecordsBufferInfo);
+
+	const auto descriptorImageInfos = [&] {
+		const auto transform = [&](const ImageData& data) {
+			return vk::DescriptorImageInfo{
+				.sampler = samplers[0], // TODO
+				.imageView = data.imageView,
+				.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+			};
 		};
 
-		// TEXCOORD_0
-		if (info.texcoord0)
+		return imageData
+			| std::views::transform(transform)
+			| std::ranges::to<std::vector>();
+	}();
+
+	if(not descriptorImageInfos.empty())
+	{
+		const auto descriptorWrite = vk::WriteDescriptorSet{
+			.dstSet = descriptorSets[1],
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorType = vk::DescriptorType::eCombinedImageSampler,
+		}.setImageInfo(descriptorImageInfos);
+
+		descriptorWrites.push_back(descriptorWrite);
+	}
+
+	device.updateDescriptorSets(descriptorWrites, {});
+
+	// only ever written on the GPU, nothing to upload
+	auto cullingFrames = std::vector<Model::Data::CullingFrame>();
+
+	{
+		// a culling set, then a cluster culling set per frame
+		auto setLayouts = std::vector<vk::DescriptorSetLayout>();
+
+		for (auto frameIndex = 0u; frameIndex < framesInFlight; ++frameIndex)
 		{
-			const auto format = info.texcoord0.value();
+			setLayouts.push_back(*cullingPipelineData.descriptorSetLayout);
+			setLayouts.push_back(*cullingPipelineData.clusterDescriptorSetLayout);
+		}
+
+		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
+			.descriptorPool = descriptorPool,
+		}.setSetLayouts(setLayouts);
 
-			assert(checkTexcoordFormat(format));
+		auto cullDescriptorSetsRAII = device.allocateDescriptorSets(allocateInfo);
 
-			addDescription(3, format);
-			primitiveFlags.data.texcoord_0 = 1;
+		for (auto frameIndex = 0u; frameIndex < framesInFlight; ++frameIndex)
+		{
+			cullingFrames.push_back({
+				.commands = Buffer{ vma.createBuffer(
+					indirectCommands.size(),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+					0
+				) },
+				.drawCounts = Buffer{ vma.createBuffer(
+					batchRecords.size() * sizeof(uint32_t),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+					0
+				) },
+				.stats = Buffer{ vma.createBuffer(
+					sizeof(CullStats),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+					VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT
+				) },
+				.descriptorSet = *cullDescriptorSetsRAII[frameIndex * 2],
+				.clusterCommands = Buffer{ vma.createBuffer(
+					clusterData.commands.size(),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+					0
+				) },
+				.clusterIndices = Buffer{ vma.createBuffer(
+					std::max(clusterData.indexCount, uint64_t(1)) * sizeof(uint32_t),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer,
+					0
+				) },
+				.clusterStats = Buffer{ vma.createBuffer(
+					sizeof(ClusterCullStats),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+					VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT
+				) },
+				.clusterDescriptorSet = *cullDescriptorSetsRAII[frameIndex * 2 + 1],
+			});
 		}
 
-		// TEXCOORD_1
-		if (info.texcoord1)
+		std::ranges::move(cullDescriptorSetsRAII, std::back_inserter(descriptorSetsRAII));
+	}
+
+	{
+		auto bufferInfos = std::vector<std::array<vk::DescriptorBufferInfo, 7>>();
+		bufferInfos.reserve(cullingFrames.size());
+
+		auto cullDescriptorWrites = std::vector<vk::WriteDescriptorSet>();
+
+		for (const auto& frame : cullingFrames)
 		{
-			const auto format = info.texcoord1.value();
+			const auto& infos = bufferInfos.emplace_back(std::to_array({
+				vk::DescriptorBufferInfo{ .buffer = *drawRecordsSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *batchRecordsSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.commands.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.drawCounts.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.stats.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *visibilityBuffer.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *lodsSSBO.vmaBuffer, .range = vk::WholeSize },
+			}));
+
+			// bindings in the order of the infos
+			cullDescriptorWrites.push_back(vk::WriteDescriptorSet{
+				.dstSet = frame.descriptorSet,
+				.dstBinding = 0,
+				.dstArrayElement = 0,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+			}.setBufferInfo(infos));
+		}
+
+		auto clusterBufferInfos = std::vector<std::array<vk::DescriptorBufferInfo, 8>>();
+		clusterBufferInfos.reserve(cullingFrames.size());
+
+		for (const auto& frame : cullingFrames)
+		{
+			const auto& infos = clusterBufferInfos.emplace_back(std::to_array({
+				vk::DescriptorBufferInfo{ .buffer = *drawRecordsSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *meshletsSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *meshletVerticesSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *meshletTrianglesSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *clusterRecordsSSBO.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.clusterCommands.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.clusterIndices.vmaBuffer, .range = vk::WholeSize },
+				vk::DescriptorBufferInfo{ .buffer = *frame.clusterStats.vmaBuffer, .range = vk::WholeSize },
+			}));
+
+			cullDescriptorWrites.push_back(vk::WriteDescriptorSet{
+				.dstSet = frame.clusterDescriptorSet,
+				.dstBinding = 0,
+				.dstArrayElement = 0,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+			}.setBufferInfo(infos));
+		}
+
+		device.updateDescriptorSets(cullDescriptorWrites, {});
+	}
+
+	loadTimings.descriptorWrites += ScopedTimer::clock::now() - descriptorWritesStart;
+
+	// hands the staging ring back
+	{
+		const auto timer = ScopedTimer(loadTimings.upload);
+		uploadBatch.wait();
+	}
+
+	auto modelData = Model::Data
+	{
+		.buffers = std::move(buffers),
+		.primitives = std::move(primitives),
+		.drawLists = std::move(drawLists),
+		.drawRecords = std::move(drawRecordsSSBO),
+		.batchRecords = std::move(batchRecordsSSBO),
+		.indirectCommands = std::move(indirectCommandsBuffer),
+		.lods = asset.lods | std::ranges::to<std::vector>(),
+		.lodsSSBO = std::move(lodsSSBO),
+		.cullingFrames = std::move(cullingFrames),
+		.visibility = std::move(visibilityBuffer),
+		.cullPipeline = *cullingPipelineData.pipeline,
+		.cullPipelineLayout = *cullingPipelineData.pipelineLayout,
+		.occlusionCullPipeline = *cullingPipelineData.occlusionPipeline,
+		.occlusionCullPipelineLayout = *cullingPipelineData.occlusionPipelineLayout,
+		.meshlets = std::move(meshletsSSBO),
+		.meshletVertices = std::move(meshletVerticesSSBO),
+		.meshletTriangles = std::move(meshletTrianglesSSBO),
+		.clusterRecords = std::move(clusterRecordsSSBO),
+		.clusterCommands = std::move(clusterCommandsBuffer),
+		.clusterCommandsSize = clusterData.commands.size(),
+		.clusterCullPipeline = *cullingPipelineData.clusterPipeline,
+		.clusterCullPipelineLayout = *cullingPipelineData.clusterPipelineLayout,
+		.materialsSSBO = std::move(materialsSSBO),
+		.imageData = std::move(imageData),
+		.pipelineLayout = *pipelineLayoutData.pipelineLayout,
+		.descriptorSetsRAII = std::move(descriptorSetsRAII),
+		.descriptorSets = std::move(descriptorSets),
+		.acquireBarriers = uploadBatch.takeAcquireBarriers(),
+		.device = device,
+	};
+
+	return Model(std::move(modelData));
+}
 
-			assert(checkTexcoordFormat(format));
+vk::Sampler Loader::getSampler(const vk::SamplerCreateInfo& info)
+{
+	auto it = samplers.find(info);
+	if (it == samplers.end()) {
+		const auto& [new_it, inserted] = samplers.emplace(info, device.createSampler(info));
+		assert(inserted);
 
-			addDescription(4, format);
-			primitiveFlags.data.texcoord_1 = 1;
+		return new_it->second;
+	}
+	return it->second;
+}
+
+vk::Pipeline Loader::getPipeline(const PrimitivePipelineInfo& info)
+{
+	{
+		const auto lock = std::shared_lock(pipelinesMutex);
+
+		if (const auto it = pipelines.find(info); it != pipelines.end())
+		{
+			return it->second;
 		}
+	}
 
-		// COLOR3_0
-		if (info.color0)
+	// compiled without holding the lock, if another thread got there first its pipeline is kept
+	auto pipeline = createPipeline(info);
+
+	const auto lock = std::scoped_lock(pipelinesMutex);
+	const auto& [it, inserted] = pipelines.emplace(info, std::move(pipeline));
+
+	return it->second;
+}
+
+void Loader::createPipelines(const std::span<const Asset::Primitive> primitives)
+{
+	const auto missing = [&] {
+		auto unique = std::unordered_set<PrimitivePipelineInfo>();
+
+		const auto lock = std::shared_lock(pipelinesMutex);
+
+		for (const auto& primitive : primitives)
 		{
-			const auto format = info.color0.value();
-
-			switch (format) {
-			case vk::Format::eR32G32B32Sfloat:
-			case vk::Format::eR8G8B8Unorm:
-			case vk::Format::eR16G16B16Unorm: 
-				addDescription(5, format);
-				primitiveFlags.data.color_0 = 1;
-				break;
-			case vk::Format::eR32G32B32A32Sfloat:
-			case vk::Format::eR8G8B8A8Unorm:
-			case vk::Format::eR16G16B16A16Unorm:
-				addDescription(6, format);
-				primitiveFlags.data.color_0 = 2;
-				break;
-			default: assert(false);
+			if (not pipelines.contains(primitive.pipelineInfo))
+			{
+				unique.insert(primitive.pipelineInfo);
 			}
 		}
 
-		primitiveFlags.data.hasBaseColorTexture = info.hasBaseColorTexture;
-		primitiveFlags.data.hasMetallicRoughnessTexture = info.hasMetallicRoughnessTexture;
-		primitiveFlags.data.hasNormalTexture = info.hasNormalTexture;
-		primitiveFlags.data.hasOcclusionTexture = info.hasOcclusionTexture;
-		primitiveFlags.data.hasEmissiveTexture = info.hasEmissiveTexture;
+		return unique | std::ranges::to<std::vector>();
+	}();
 
-		const auto vertexInputState = vk::PipelineVertexInputStateCreateInfo{}
-			.setVertexBindingDescriptions(bindingDescriptions)
-			.setVertexAttributeDescriptions(attributeDescriptions);
+	threadPool.parallelFor(missing.size(), [&](const size_t index) {
+		getPipeline(missing[index]);
+	});
+}
 
-		// Input assembly
-		const auto inputAssemblyState = vk::PipelineInputAssemblyStateCreateInfo{
-			.topology = vk::PrimitiveTopology::eTriangleList,
-			.primitiveRestartEnable = false
-		};
+vk::raii::Pipeline Loader::createPipeline(const PrimitivePipelineInfo& info) const
+{
+	auto bindingDescriptions = vku::small::vector<vk::VertexInputBindingDescription, VERTEX_INPUT_NUM>();
+	auto attributeDescriptions = vku::small::vector<vk::VertexInputAttributeDescription, VERTEX_INPUT_NUM>();
 
-		// Viewport state
-		const auto viewportState = vk::PipelineViewportStateCreateInfo{
-			.viewportCount = 1,
-			.scissorCount = 1,
-		};
+	// positions in binding 0, the other attributes interleaved in binding 1, see Asset::Primitive::vertexBuffers
+	auto attributeOffset = uint32_t(0);
 
-		// Rasterization State
-		const auto rasterizationState = vk::PipelineRasterizationStateCreateInfo{
-			.polygonMode = vk::PolygonMode::eFill,
-			.cullMode = vk::CullModeFlagBits::eBack,
-			.lineWidth = 1.0f,
-		};
+	auto addDescription = [&](const uint32_t location, const vk::Format format) {
+		const auto binding = location == 0 ? 0u : 1u;
+		const auto offset = location == 0 ? 0u : attributeOffset;
 
-		// Multisample state
-		const auto multisampleState = vk::PipelineMultisampleStateCreateInfo{
-			.rasterizationSamples = vk::SampleCountFlagBits::e1,
-			.minSampleShading = 1.0f,
-		};
+		if (binding == 1)
+		{
+			const auto alignment = static_cast<uint32_t>(VERTEX_ATTRIBUTE_ALIGNMENT);
+			attributeOffset += (vk::blockSize(format) + alignment - 1) & ~(alignment - 1);
+		}
 
-		// Depth
-		const auto depthStencilState = vk::PipelineDepthStencilStateCreateInfo{
-			.depthTestEnable = true,
-			.depthWriteEnable = true,
-			.depthCompareOp = vk::CompareOp::eLess,
-		};
+		if (not std::ranges::contains(bindingDescriptions, binding, &vk::VertexInputBindingDescription::binding))
+		{
+			bindingDescriptions.emplace_back(vk::VertexInputBindingDescription{
+				.binding = binding,
+				.inputRate = vk::VertexInputRate::eVertex,
+			});
+		}
 
-		// Color blend state
-		const auto colorBlendAttachmentState = vk::PipelineColorBlendAttachmentState{
-			.colorWriteMask = ~vk::ColorComponentFlags(),
+		attributeDescriptions.emplace_back(vk::VertexInputAttributeDescription{
+			.location = location,
+			.binding = binding,
+			.format = format,
+			.offset = offset,
+		});
 		};
 
-		const auto colorBlendState = vk::PipelineColorBlendStateCreateInfo{
-		}.setAttachments(colorBlendAttachmentState);
+	// POSITION, KHR_mesh_quantization leaves its dequantization to the node transforms
+	addDescription(0, info.position);
 
-		// Dynamic state
-		const auto dynamicStates = {
-			vk::DynamicState::ePrimitiveTopology,
-			vk::DynamicState::eVertexInputBindingStride,
-			vk::DynamicState::eFrontFace,
-			vk::DynamicState::eViewport,
-			vk::DynamicState::eScissor,
-		};
+	union {
+		PrimitiveFlags data;
+		PrimitiveFlagsInt packed = 0;
 
-		const auto dynamicState = vk::PipelineDynamicStateCreateInfo{}.setDynamicStates(dynamicStates);
+		static_assert(sizeof(packed) >= sizeof(data));
+	} primitiveFlags;
 
-		const auto SpecializationMapEntries = {
-			vk::SpecializationMapEntry{
-				.constantID = 0,
-				.offset = 0,
-				.size = sizeof(primitiveFlags.packed),
-			},
-		};
+	// NORMAL
+	if (info.normal)
+	{
+		addDescription(1, info.normal.value());
+		primitiveFlags.data.normal = 1;
+	}
 
-		const auto specializationInfo = vk::SpecializationInfo{
-			.dataSize = sizeof(primitiveFlags.packed),
-			.pData = &primitiveFlags.packed,
-		}.setMapEntries(SpecializationMapEntries);
-		//.setData(primitiveFlags.packed); TODO:
+	// TANGENT
+	if (info.tangent)
+	{
+		addDescription(2, info.tangent.value());
+		primitiveFlags.data.tangent = 1;
+	}
 
-		const auto createPipelineShaderStageCreateInfo = [&](const vk::ShaderStageFlagBits stage) {
-			return vk::PipelineShaderStageCreateInfo{
-				.stage = stage,
-				.module = *shader.getModule(),
-				.pName = "main",
-				.pSpecializationInfo = &specializationInfo,
-			};
+	const auto checkTexcoordFormat = [](const vk::Format val) {
+		const auto formats = {
+			vk::Format::eR32G32Sfloat,
+			vk::Format::eR8G8Unorm,
+			vk::Format::eR16G16Unorm,
+			// KHR_mesh_quantization
+			vk::Format::eR8G8Snorm,
+			vk::Format::eR8G8Uscaled,
+			vk::Format::eR8G8Sscaled,
+			vk::Format::eR16G16Snorm,
+			vk::Format::eR16G16Uscaled,
+			vk::Format::eR16G16Sscaled,
 		};
 
-		const auto stages = {
-			createPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment),
-			createPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex),
-		};
+		for (const auto format : formats) {
+			if (format == val)
+			{
+				return true;
+			}
+		}
 
-		const auto pipelineRendering = vk::PipelineRenderingCreateInfo{}
-		.setColorAttachmentFormats(surfaceFormat)
-		.setDepthAttachmentFormat(depthFormat);
-
-		const auto createInfo = vk::GraphicsPipelineCreateInfo{
-			.pNext = &pipelineRendering,
-			.pVertexInputState = &vertexInputState,
-			.pInputAssemblyState = &inputAssemblyState,
-			.pViewportState = &viewportState,
-			.pRasterizationState = &rasterizationState,
-			.pMultisampleState = &multisampleState,
-			.pDepthStencilState = &depthStencilState,
-			.pColorBlendState = &colorBlendState,
-			.pDynamicState = &dynamicState,
-			.layout = *pipelineLayoutData.pipelineLayout,
-		}.setStages(stages);
-
-		return device.createGraphicsPipeline(nullptr, createInfo);
+		return false;
 	};
 
-	auto it = pipelines.find(info);
-	if (it == pipelines.end()) {
-		const auto& [new_it, inserted] = pipelines.emplace(info, createPipeline());
-		assert(inserted);
+	// TEXCOORD_0
+	if (info.texcoord0)
+	{
+		const auto format = info.texcoord0.value();
 
-		return new_it->second;
+		assert(checkTexcoordFormat(format));
+
+		addDescription(3, format);
+		primitiveFlags.data.texcoord_0 = 1;
 	}
-	return it->second;
-}
 
-std::vector<Buffer> Loader::loadBuffers(const std::vector<std::span<const std::byte>>& buffers)
-{
-	if (not buffers.size())
+	// TEXCOORD_1
+	if (info.texcoord1)
 	{
-		return {};
+		const auto format = info.texcoord1.value();
+
+		assert(checkTexcoordFormat(format));
+
+		addDescription(4, format);
+		primitiveFlags.data.texcoord_1 = 1;
 	}
 
-	transferCommandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	// COLOR3_0
+	if (info.color0)
+	{
+		const auto format = info.color0.value();
+
+		switch (format) {
+		case vk::Format::eR32G32B32Sfloat:
+		case vk::Format::eR8G8B8Unorm:
+		case vk::Format::eR16G16B16Unorm: 
+			addDescription(5, format);
+			primitiveFlags.data.color_0 = 1;
+			break;
+		case vk::Format::eR32G32B32A32Sfloat:
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR16G16B16A16Unorm:
+			addDescription(6, format);
+			primitiveFlags.data.color_0 = 2;
+			break;
+		default: assert(false);
+		}
+	}
+
+	primitiveFlags.data.hasBaseColorTexture = info.hasBaseColorTexture;
+	primitiveFlags.data.hasMetallicRoughnessTexture = info.hasMetallicRoughnessTexture;
+	primitiveFlags.data.hasNormalTexture = info.hasNormalTexture;
+	primitiveFlags.data.hasOcclusionTexture = info.hasOcclusionTexture;
+	primitiveFlags.data.hasEmissiveTexture = info.hasEmissiveTexture;
+
+	const auto vertexInputState = vk::PipelineVertexInputStateCreateInfo{}
+		.setVertexBindingDescriptions(bindingDescriptions)
+		.setVertexAttributeDescriptions(attributeDescriptions);
+
+	// Input assembly
+	const auto inputAssemblyState = vk::PipelineInputAssemblyStateCreateInfo{
+		.topology = vk::PrimitiveTopology::eTriangleList,
+		.primitiveRestartEnable = false
+	};
+
+	// Viewport state
+	const auto viewportState = vk::PipelineViewportStateCreateInfo{
+		.viewportCount = 1,
+		.scissorCount = 1,
+	};
 
-	auto buffers_temp = [&] {
-		const auto transform = [&](const std::span<const std::byte>& buffer) {
-			const auto size = buffer.size();
+	// Rasterization State
+	const auto rasterizationState = vk::PipelineRasterizationStateCreateInfo{
+		.polygonMode = vk::PolygonMode::eFill,
+		.cullMode = vk::CullModeFlagBits::eBack,
+		.lineWidth = 1.0f,
+	};
 
-			auto stagingBuffer = vma.createBuffer(
-				size,
-				vk::BufferUsageFlagBits::eTransferSrc,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT // TODO:  VMA_ALLOCATION_CREATE_MAPPED_BIT?
-			);
+	// Multisample state
+	const auto multisampleState = vk::PipelineMultisampleStateCreateInfo{
+		.rasterizationSamples = vk::SampleCountFlagBits::e1,
+		.minSampleShading = 1.0f,
+	};
 
-			const auto result = stagingBuffer.CopyMemoryToAllocation(
-				buffer.data(),
-				size
-			);
-			assert(result == vk::Result::eSuccess);
+	// Depth
+	const auto depthStencilState = vk::PipelineDepthStencilStateCreateInfo{
+		.depthTestEnable = true,
+		.depthWriteEnable = true,
+		.depthCompareOp = vk::CompareOp::eLess,
+	};
 
-			constexpr auto usage = vk::BufferUsageFlagBits::eVertexBuffer
-				| vk::BufferUsageFlagBits::eIndexBuffer
-				| vk::BufferUsageFlagBits::eTransferDst;
+	// Color blend state
+	const auto colorBlendAttachmentState = vk::PipelineColorBlendAttachmentState{
+		.colorWriteMask = ~vk::ColorComponentFlags(),
+	};
 
-			auto deviceBuffer = vma.createBuffer(
-				size,
-				usage,
-				0
-			);
+	const auto colorBlendState = vk::PipelineColorBlendStateCreateInfo{
+	}.setAttachments(colorBlendAttachmentState);
 
-			const auto copyRegion = vk::BufferCopy{ .size = size };
+	// Dynamic state
+	const auto dynamicStates = {
+		vk::DynamicState::ePrimitiveTopology,
+		vk::DynamicState::eVertexInputBindingStride,
+		vk::DynamicState::eFrontFace,
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
 
-			transferCommandBuffer.copyBuffer(*stagingBuffer, *deviceBuffer, copyRegion);
+	const auto dynamicState = vk::PipelineDynamicStateCreateInfo{}.setDynamicStates(dynamicStates);
 
-			return std::make_pair(std::move(stagingBuffer), std::move(deviceBuffer));
+	const auto SpecializationMapEntries = {
+		vk::SpecializationMapEntry{
+			.constantID = 0,
+			.offset = 0,
+			.size = sizeof(primitiveFlags.packed),
+		},
+	};
+
+	const auto specializationInfo = vk::SpecializationInfo{
+		.dataSize = sizeof(primitiveFlags.packed),
+		.pData = &primitiveFlags.packed,
+	}.setMapEntries(SpecializationMapEntries);
+	//.setData(primitiveFlags.packed); TODO:
+
+	const auto createPipelineShaderStageCreateInfo = [&](const vk::ShaderStageFlagBits stage) {
+		return vk::PipelineShaderStageCreateInfo{
+			.stage = stage,
+			.module = *shader.getModule(),
+			.pName = "main",
+			.pSpecializationInfo = &specializationInfo,
 		};
+	};
 
-		return buffers |
-			std::views::transform(transform) |
-			std::ranges::to<std::vector>();
-	}();
+	const auto stages = {
+		createPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eFragment),
+		createPipelineShaderStageCreateInfo(vk::ShaderStageFlagBits::eVertex),
+	};
 
-	transferCommandBuffer.end();
+	const auto pipelineRendering = vk::PipelineRenderingCreateInfo{}
+	.setColorAttachmentFormats(surfaceFormat)
+	.setDepthAttachmentFormat(depthFormat);
+
+	const auto createInfo = vk::GraphicsPipelineCreateInfo{
+		.pNext = &pipelineRendering,
+		.pVertexInputState = &vertexInputState,
+		.pInputAssemblyState = &inputAssemblyState,
+		.pViewportState = &viewportState,
+		.pRasterizationState = &rasterizationState,
+		.pMultisampleState = &multisampleState,
+		.pDepthStencilState = &depthStencilState,
+		.pColorBlendState = &colorBlendState,
+		.pDynamicState = &dynamicState,
+		.layout = *pipelineLayoutData.pipelineLayout,
+	}.setStages(stages);
+
+	return device.createGraphicsPipeline(pipelineCache.get(), createInfo);
+}
 
-	const auto commandBufferInfo = vk::CommandBufferSubmitInfo{ .commandBuffer = *transferCommandBuffer };
-	const auto submitInfo = vk::SubmitInfo2{}.setCommandBufferInfos(commandBufferInfo);
+std::vector<Buffer> Loader::loadBuffers(UploadBatch& batch, const std::vector<std::span<const std::byte>>& buffers)
+{
+	const auto transform = [&](const std::span<const std::byte>& buffer) {
+		constexpr auto usage = vk::BufferUsageFlagBits::eVertexBuffer
+			| vk::BufferUsageFlagBits::eIndexBuffer
+			| vk::BufferUsageFlagBits::eTransferDst;
+
+		auto deviceBuffer = vma.createBuffer(
+			buffer.size(),
+			usage,
+			0
+		);
 
-	transferQueue.submit2(submitInfo);
-	transferQueue.waitIdle();
+		batch.copyToBuffer(buffer, *deviceBuffer);
+
+		return Buffer(std::move(deviceBuffer));
+	};
 
-	return buffers_temp
-		| std::views::transform([](auto& pair) { return Buffer(std::move(pair.second)); })
+	return buffers
+		| std::views::transform(transform)
 		| std::ranges::to<std::vector>();
 }
 
-Buffer Loader::createMaterialsSSBO(const std::vector<Material>& materials)
+std::vector<std::byte> Loader::packMaterials(const std::vector<Material>& materials) const
 {
 	const auto& reflection = shader.getReflection();
 
@@ -389,15 +975,8 @@ Buffer Loader::createMaterialsSSBO(const std::vector<Material>& materials)
 		return offset + size;
 	}();
 
-	const auto bufferSize = structSize * materials.size();
-
-	auto stagingBuffer = vma.createBuffer(
-		bufferSize,
-		vk::BufferUsageFlagBits::eTransferSrc,
-		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-	);
-
-	auto mapped = stagingBuffer.MapMemory();
+	auto result = std::vector<std::byte>(structSize * materials.size());
+	auto mapped = result.data();
 
 	for (auto index = 0u; index < materials.size(); ++index, mapped += structSize)
 	{
@@ -500,64 +1079,34 @@ Buffer Loader::createMaterialsSSBO(const std::vector<Material>& materials)
 		}
 	}
 
-	stagingBuffer.UnmapMemory();
+	return result;
+}
 
-	constexpr auto usage = vk::BufferUsageFlagBits::eStorageBuffer
-		| vk::BufferUsageFlagBits::eTransferDst;
+Buffer Loader::createMaterialsSSBO(UploadBatch& batch, const std::span<const std::byte> materials)
+{
+	return createDeviceBuffer(batch, materials, vk::BufferUsageFlagBits::eStorageBuffer);
+}
 
+Buffer Loader::createDeviceBuffer(UploadBatch& batch, const std::span<const std::byte> data, const vk::BufferUsageFlags usage)
+{
 	auto deviceBuffer = vma.createBuffer(
-		bufferSize,
-		usage,
+		data.size(),
+		usage | vk::BufferUsageFlagBits::eTransferDst,
 		0
 	);
 
-	transferCommandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-
-	const auto copyRegion = vk::BufferCopy{ .size = bufferSize };
-
-	transferCommandBuffer.copyBuffer(*stagingBuffer, *deviceBuffer, copyRegion);
-	transferCommandBuffer.end();
-
-	const auto commandBufferInfo = vk::CommandBufferSubmitInfo{ .commandBuffer = *transferCommandBuffer };
-	const auto submitInfo = vk::SubmitInfo2{}.setCommandBufferInfos(commandBufferInfo);
-
-	transferQueue.submit2(submitInfo);
-	transferQueue.waitIdle();
+	batch.copyToBuffer(data, *deviceBuffer);
 
 	return Buffer{ .vmaBuffer = std::move(deviceBuffer) };
 }
 
-std::vector<ImageData> Loader::createImages(const std::vector<ImageInfo>& imageInfos)
+std::vector<ImageData> Loader::createImages(UploadBatch& batch, const std::vector<Asset::Image>& imageInfos)
 {
-	if (not imageInfos.size())
-	{
-		return {};
-	}
-
 	auto imageData = std::vector<ImageData>();
 	imageData.reserve(imageInfos.size());
 
-	auto stagingBuffers = std::vector<VmaBuffer>();
-	imageData.reserve(imageInfos.size());
-
-	transferCommandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-
 	for (const auto& info: imageInfos)
 	{
-		const auto size = info.imageBuffer.size();
-
-		auto stagingBuffer = vma.createBuffer(
-			size,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-		);
-
-		const auto result = stagingBuffer.CopyMemoryToAllocation(
-			info.imageBuffer.data(),
-			size
-		);
-		assert(result == vk::Result::eSuccess);
-
 		auto vmaImage = [&] {
 			const auto createInfo = vk::ImageCreateInfo{
 				.imageType = vk::ImageType::e2D,
@@ -574,62 +1123,7 @@ std::vector<ImageData> Loader::createImages(const std::vector<ImageInfo>& imageI
 			return vma.createImage(createInfo, 0);
 		}();
 
-		// to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-		{
-			const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
-				.dstStageMask = vk::PipelineStageFlagBits2::eCopy,
-				.dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
-				.newLayout = vk::ImageLayout::eTransferDstOptimal,
-				.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
-				.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
-				.image = *vmaImage,
-				.subresourceRange = COLOR_SUBRESOURCE_RANGE,
-			};
-
-			const auto dependencyInfo = vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarrier);
-			transferCommandBuffer.pipelineBarrier2(dependencyInfo);
-		}
-
-		constexpr auto COLOR_SUBRESOURCE_LAYERS = vk::ImageSubresourceLayers{
-			.aspectMask = vk::ImageAspectFlagBits::eColor,
-			.mipLevel = 0,
-			.baseArrayLayer = 0,
-			.layerCount = 1,
-		};
-
-		const auto copyRegion = vk::BufferImageCopy2{
-			.bufferOffset = 0,
-			.imageSubresource = COLOR_SUBRESOURCE_LAYERS,
-			.imageExtent = info.extent,
-		};
-
-		const auto copyBufferToImageInfo = vk::CopyBufferToImageInfo2
-		{
-			.srcBuffer = *stagingBuffer,
-			.dstImage = *vmaImage,
-			.dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
-		}.setRegions(copyRegion);
-
-		transferCommandBuffer.copyBufferToImage2(copyBufferToImageInfo);
-
-		// to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-		{
-			const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
-				.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
-				.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
-				.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
-				.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
-				.oldLayout = vk::ImageLayout::eTransferDstOptimal,
-				.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-				.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
-				.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
-				.image = *vmaImage,
-				.subresourceRange = COLOR_SUBRESOURCE_RANGE,
-			};
-
-			const auto dependencyInfo = vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarrier);
-			transferCommandBuffer.pipelineBarrier2(dependencyInfo);
-		}
+		batch.copyToImage(info.texels, *vmaImage, info.extent);
 
 		auto imageView = [&] {
 			const auto createInfo = vk::ImageViewCreateInfo{
@@ -642,19 +1136,42 @@ std::vector<ImageData> Loader::createImages(const std::vector<ImageInfo>& imageI
 			return device.createImageView(createInfo);
 		}();
 
-		stagingBuffers.push_back(std::move(stagingBuffer));
 		imageData.push_back({ .image = std::move(vmaImage), .imageView = std::move(imageView) });
 	}
 
-	transferCommandBuffer.end();
+	return imageData;
+}
 
-	const auto commandBufferInfo = vk::CommandBufferSubmitInfo{ .commandBuffer = *transferCommandBuffer };
-	const auto submitInfo = vk::SubmitInfo2{}.setCommandBufferInfos(commandBufferInfo);
-	transferQueue.submit2(submitInfo);
+PendingModel Loader::loadFromFileAsync(const std::string_view& gltfFile)
+{
+	auto future = threadPool.submit([this, gltfFile = std::string(gltfFile)] {
+		return loadFromFile(gltfFile);
+	});
 
-	transferQueue.waitIdle();
+	return PendingModel(std::move(future));
+}
 
-	return imageData;
+PendingModel::PendingModel(std::future<Model>&& future)
+	: future(std::move(future))
+{}
+
+PendingModel::~PendingModel()
+{
+	// the load references the loader, don't let it outlive it
+	if (future.valid())
+	{
+		future.wait();
+	}
+}
+
+bool PendingModel::isReady() const
+{
+	return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+Model PendingModel::get()
+{
+	return future.get();
 }
 
 Loader::PipelineLayoutData Loader::createPipelineLayoutData(const vk::raii::Device& device)
@@ -667,6 +1184,12 @@ Loader::PipelineLayoutData Loader::createPipelineLayoutData(const vk::raii::Devi
 				.descriptorCount = 1,
 				.stageFlags = vk::ShaderStageFlagBits::eFragment,
 			},
+			vk::DescriptorSetLayoutBinding{
+				.binding = 1,
+				.descriptorType = vk::DescriptorType::eStorageBuffer,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eVertex,
+			},
 		};
 
 		const auto descriptorSetLayoutCreateInfo = vk::DescriptorSetLayoutCreateInfo{
@@ -734,4 +1257,140 @@ Loader::PipelineLayoutData Loader::createPipelineLayoutData(const vk::raii::Devi
 	};
 }
 
+Loader::CullingPipelineData Loader::createCullingPipelineData() const
+{
+	auto descriptorSetLayout = [&] {
+		// draw records, batch records, commands, draw counts, stats, visibility, levels of detail
+		const auto descriptorSetLayoutBindings = std::views::iota(0u, 7u)
+			| std::views::transform([](const uint32_t binding) {
+				return vk::DescriptorSetLayoutBinding{
+					.binding = binding,
+					.descriptorType = vk::DescriptorType::eStorageBuffer,
+					.descriptorCount = 1,
+					.stageFlags = vk::ShaderStageFlagBits::eCompute,
+				};
+			})
+			| std::ranges::to<std::vector>();
+
+		const auto descriptorSetLayoutCreateInfo = vk::DescriptorSetLayoutCreateInfo{
+		}.setBindings(descriptorSetLayoutBindings);
+
+		return device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo);
+	}();
+
+	auto pipelineLayout = [&] {
+		constexpr auto pushConstantRange = vk::PushConstantRange{
+			.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			.size = sizeof(CullPushConstants),
+		};
+
+		const auto createInfo = vk::PipelineLayoutCreateInfo{}
+			.setSetLayouts(*descriptorSetLayout)
+			.setPushConstantRanges(pushConstantRange);
+
+		return device.createPipelineLayout(createInfo);
+	}();
+
+	auto pipeline = [&] {
+		const auto createInfo = vk::ComputePipelineCreateInfo{
+			.stage = {
+				.stage = vk::ShaderStageFlagBits::eCompute,
+				.module = *cullShader.getModule(),
+				.pName = "main",
+			},
+			.layout = *pipelineLayout,
+		};
+
+		return device.createComputePipeline(pipelineCache.get(), createInfo);
+	}();
+
+	auto depthPyramidSetLayout = DepthPyramid::createDescriptorSetLayout(device);
+
+	auto occlusionPipelineLayout = [&] {
+		constexpr auto pushConstantRange = vk::PushConstantRange{
+			.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			.size = sizeof(OcclusionCullPushConstants),
+		};
+
+		const auto setLayouts = { *descriptorSetLayout, *depthPyramidSetLayout };
+
+		const auto createInfo = vk::PipelineLayoutCreateInfo{}
+			.setSetLayouts(setLayouts)
+			.setPushConstantRanges(pushConstantRange);
+
+		return device.createPipelineLayout(createInfo);
+	}();
+
+	auto occlusionPipeline = [&] {
+		const auto createInfo = vk::ComputePipelineCreateInfo{
+			.stage = {
+				.stage = vk::ShaderStageFlagBits::eCompute,
+				.module = *occlusionCullShader.getModule(),
+				.pName = "main",
+			},
+			.layout = *occlusionPipelineLayout,
+		};
+
+		return device.createComputePipeline(pipelineCache.get(), createInfo);
+	}();
+
+	auto clusterDescriptorSetLayout = [&] {
+		// draw records, meshlets, meshlet vertices, meshlet triangles, cluster records,
+		// commands, indices, stats
+		const auto descriptorSetLayoutBindings = std::views::iota(0u, 8u)
+			| std::views::transform([](const uint32_t binding) {
+				return vk::DescriptorSetLayoutBinding{
+					.binding = binding,
+					.descriptorType = vk::DescriptorType::eStorageBuffer,
+					.descriptorCount = 1,
+					.stageFlags = vk::ShaderStageFlagBits::eCompute,
+				};
+			})
+			| std::ranges::to<std::vector>();
+
+		const auto descriptorSetLayoutCreateInfo = vk::DescriptorSetLayoutCreateInfo{
+		}.setBindings(descriptorSetLayoutBindings);
+
+		return device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo);
+	}();
+
+	auto clusterPipelineLayout = [&] {
+		constexpr auto pushConstantRange = vk::PushConstantRange{
+			.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			.size = sizeof(ClusterCullPushConstants),
+		};
+
+		const auto createInfo = vk::PipelineLayoutCreateInfo{}
+			.setSetLayouts(*clusterDescriptorSetLayout)
+			.setPushConstantRanges(pushConstantRange);
+
+		return device.createPipelineLayout(createInfo);
+	}();
+
+	auto clusterPipeline = [&] {
+		const auto createInfo = vk::ComputePipelineCreateInfo{
+			.stage = {
+				.stage = vk::ShaderStageFlagBits::eCompute,
+				.module = *clusterCullShader.getModule(),
+				.pName = "main",
+			},
+			.layout = *clusterPipelineLayout,
+		};
+
+		return device.createComputePipeline(pipelineCache.get(), createInfo);
+	}();
+
+	return CullingPipelineData{
+		.descriptorSetLayout = std::move(descriptorSetLayout),
+		.pipelineLayout = std::move(pipelineLayout),
+		.pipeline = std::move(pipeline),
+		.depthPyramidSetLayout = std::move(depthPyramidSetLayout),
+		.occlusionPipelineLayout = std::move(occlusionPipelineLayout),
+		.occlusionPipeline = std::move(occlusionPipeline),
+		.clusterDescriptorSetLayout = std::move(clusterDescriptorSetLayout),
+		.clusterPipelineLayout = std::move(clusterPipelineLayout),
+		.clusterPipeline = std::move(clusterPipeline),
+	};
+}
+
 }
\ No newline at end of file
@@ -1,97 +1,150 @@
 #pragma once
 #include "model.h"
+#include "asset.h"
+#include "model_cache.h"
 #include <vk/vma.h>
 #include "vk/shader.h"
+#include "vk/pipeline_cache.h"
+#include "vk/upload_batch.h"
+#include "util/thread_pool.h"
+#include "util/index_optimizer.h"
 
 namespace gltf
 {
 
-struct PrimitivePipelineInfo
+// Wall time spent in each load phase, in milliseconds, and how the imported index data does
+// in the vertex cache. Loads from the model cache import nothing and leave the statistics at 0.
+struct LoadTimings
 {
-	bool hasNormal;
-	bool hasTangent;
-	std::optional<vk::Format> texcoord0;
-	std::optional<vk::Format> texcoord1;
-	std::optional<vk::Format> color0;
-	bool hasBaseColorTexture;
-	bool hasMetallicRoughnessTexture;
-	bool hasNormalTexture;
-	bool hasOcclusionTexture;
-	bool hasEmissiveTexture;
-
-	auto operator<=>(const PrimitivePipelineInfo&) const = default;
+	using Duration = std::chrono::duration<double, std::milli>;
+
+	Duration modelCache; // hashing sources and mapping the cache entry, entries are written in the background
+	Duration parse;
+	Duration imageDecode;
+	Duration optimizeIndices; // ordering the primitives for the vertex cache, overdraw and vertex fetch
+	Duration buildLods; // simplifying the primitives
+	Duration loadBuffers;
+	Duration createMaterialsSSBO;
+	Duration createImages;
+	Duration upload; // submitting the upload batch and waiting for it
+	Duration createPipelines;
+	Duration descriptorWrites;
+
+	VertexCacheStats vertexCacheBefore; // of the indices as the glTF stores them
+	VertexCacheStats vertexCacheAfter; // of the full meshes as drawn
 };
 
-}
+// Adds the lifetime of the scope to the given duration
+class ScopedTimer
+{
+public:
+	using clock = std::chrono::steady_clock;
 
-namespace std {
+	ScopedTimer(LoadTimings::Duration& duration) : duration(duration), start(clock::now()) {}
+	~ScopedTimer() { duration += clock::now() - start; }
 
-template<>
-struct hash<gltf::PrimitivePipelineInfo> {
-	size_t operator()(const gltf::PrimitivePipelineInfo& val) const {
-		return boost::pfr::hash_fields(val);
-	}
-};
+	ScopedTimer(const ScopedTimer&) = delete;
 
-}
+private:
+	LoadTimings::Duration& duration;
+	clock::time_point start;
+};
 
-namespace gltf
+// Handle to a model which is loaded on a worker thread
+class PendingModel
 {
+public:
+	PendingModel(std::future<Model>&& future);
+	PendingModel(PendingModel&&) noexcept = default;
+	~PendingModel();
+
+	// true once parsing, decoding and uploads have finished
+	bool isReady() const;
+	Model get();
+
+private:
+	std::future<Model> future;
+};
 
 class Loader
 {
 public:
 	struct CreateInfo
 	{
+		const vk::raii::PhysicalDevice& physicalDevice;
 		const vk::raii::Device& device;
 		const VulkanMemoryAllocator& vma;
 		const vk::raii::CommandBuffer& transferCommandBuffer;
 		const vk::raii::Queue& transferQueue;
+		std::mutex& transferQueueMutex; // the transfer queue may be shared with the render loop
+		uint32_t transferQueueFamilyIndex;
+		uint32_t graphicsQueueFamilyIndex; // models are released to it when it differs from the transfer family
+		ThreadPool& threadPool;
 		vk::Format surfaceFormat;
 		vk::Format depthFormat;
+		std::optional<std::filesystem::path> modelCacheDirectory; // nullopt disables the model cache
+		std::optional<std::filesystem::path> pipelineCachePath; // nullopt keeps the pipeline cache in memory
+		vk::DeviceSize stagingRingSize = 64 * 1024 * 1024; // bounds the host-visible memory used by uploads
+		uint32_t framesInFlight; // each gets its own culling output
+		bool clusterCulling = false; // sizes the compacted cluster index buffers, only DrawMode::eClusterCulled reads them
+		vk::DeviceSize clusterIndexBudget = 256 * 1024 * 1024; // per frame in flight, batches beyond it are not clustered
 	};
 
-    Model loadFromFile(const std::string_view& gltfFile);
+	// Both are thread-safe, concurrent loads overlap in parsing, decoding and pipeline compilation
+    Model loadFromFile(const std::string_view& gltfFile, LoadTimings* timings = nullptr);
+	PendingModel loadFromFileAsync(const std::string_view& gltfFile);
 
 	Loader(const CreateInfo& info);
 	Loader(const Loader&) = delete;
-	Loader(Loader&&) noexcept = default;
+	~Loader(); // waits for model cache entries still being written
 
 private:
 	vk::Sampler getSampler(const vk::SamplerCreateInfo& info);
     std::unordered_map<vk::SamplerCreateInfo, vk::raii::Sampler> samplers;
 
+	// thread-safe, compiles on a miss
 	vk::Pipeline getPipeline(const PrimitivePipelineInfo& info);
+	void createPipelines(const std::span<const Asset::Primitive> primitives);
+	vk::raii::Pipeline createPipeline(const PrimitivePipelineInfo& info) const;
     std::unordered_map<PrimitivePipelineInfo, vk::raii::Pipeline> pipelines;
+	std::shared_mutex pipelinesMutex;
+	PipelineCache pipelineCache;
 
-	std::vector<Buffer> loadBuffers(const std::vector<std::span<const std::byte>>& buffers);
-	Buffer createMaterialsSSBO(const std::vector<Material>& materials);
-
-	struct ImageInfo {
-		std::span<const std::byte> imageBuffer;
-		vk::Format format;
-		vk::Extent3D extent;
-
-		bool operator==(const ImageInfo& rh) const
-		{
-			return imageBuffer.data() == rh.imageBuffer.data()
-				&& imageBuffer.size() == rh.imageBuffer.size()
-				&& format == rh.format
-				&& extent == rh.extent;
-		}
-	};
+	// parses and decodes the source files, without touching the GPU
+	Asset importFile(const std::filesystem::path& path, LoadTimings& timings);
+	Model createModel(const Asset& asset, LoadTimings& timings);
 
-	std::vector<ImageData> createImages(const std::vector<ImageInfo>& imageInfos);
+	// record into the model's upload batch, the resources are usable once it completes
+	std::vector<Buffer> loadBuffers(UploadBatch& batch, const std::vector<std::span<const std::byte>>& buffers);
+	std::vector<std::byte> packMaterials(const std::vector<Material>& materials) const;
+	Buffer createMaterialsSSBO(UploadBatch& batch, const std::span<const std::byte> materials);
+	std::vector<ImageData> createImages(UploadBatch& batch, const std::vector<Asset::Image>& images);
+	Buffer createDeviceBuffer(UploadBatch& batch, const std::span<const std::byte> data, const vk::BufferUsageFlags usage);
 
 	const vk::raii::Device& device;
 	const VulkanMemoryAllocator& vma;
 	const vk::raii::CommandBuffer& transferCommandBuffer;
 	const vk::raii::Queue& transferQueue; 
+	std::mutex& transferQueueMutex;
+	uint32_t transferQueueFamilyIndex;
+	uint32_t graphicsQueueFamilyIndex;
+	ThreadPool& threadPool;
+	uint32_t framesInFlight;
+	uint64_t maxClusterIndexCount; // 0 without cluster culling
+
+	// guards uploads: the transfer command buffer, the upload timeline, the sampler cache and descriptor pools
+	std::mutex loadMutex;
+	const vk::raii::Semaphore uploadTimeline;
+	uint64_t uploadTimelineValue = 0;
+	StagingRing stagingRing;
 	const vk::raii::DescriptorPool descriptorPool;
 	const vk::raii::DescriptorPool bindlessDescriptorPool;
 	Shader shader;
 	vk::Format surfaceFormat;
 	vk::Format depthFormat;
+	std::optional<ModelCache> modelCache;
+	std::mutex pendingStoresMutex;
+	std::vector<std::future<void>> pendingStores; // model cache entries written on threadPool
 
 	struct PipelineLayoutData {
 		vk::raii::PipelineLayout pipelineLayout;
@@ -100,6 +153,25 @@ private:
 	} pipelineLayoutData;
 
 	static PipelineLayoutData createPipelineLayoutData(const vk::raii::Device& device);
+
+	// culling compute passes, shared by every model
+	Shader cullShader;
+	Shader occlusionCullShader;
+	Shader clusterCullShader;
+
+	struct CullingPipelineData {
+		vk::raii::DescriptorSetLayout descriptorSetLayout;
+		vk::raii::PipelineLayout pipelineLayout;
+		vk::raii::Pipeline pipeline;
+		vk::raii::DescriptorSetLayout depthPyramidSetLayout;
+		vk::raii::PipelineLayout occlusionPipelineLayout; // the culling set, then the depth pyramid
+		vk::raii::Pipeline occlusionPipeline;
+		vk::raii::DescriptorSetLayout clusterDescriptorSetLayout;
+		vk::raii::PipelineLayout clusterPipelineLayout;
+		vk::raii::Pipeline clusterPipeline;
+	} cullingPipelineData;
+
+	CullingPipelineData createCullingPipelineData() const;
 	//static vk::raii::DescriptorPool createBindlessDescriptorPool(const vk::raii::Device& device);
 };
 
@@ -1,4 +1,9 @@
 #include "loader.h"
+#include "document.h"
+#include "util/meshlet.h"
+#include "util/simplify.h"
+#include "util/index_optimizer.h"
+#include "util/hash.h"
 
 namespace
 {
@@ -34,37 +39,258 @@ vk::DeviceSize getElemSize(const tinygltf::Accessor& accessor)
 	return tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
 }
 
-std::optional<vk::Format> GltfToVkFormat(const tinygltf::Accessor& accessor) {
-	using Key = std::pair<int, int>;
-	static const std::unordered_map<Key, vk::Format> formatMap = {
-		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_FLOAT}, vk::Format::eR32G32Sfloat},
-		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE}, vk::Format::eR8G8Unorm},
-		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT}, vk::Format::eR16G16Unorm},
-		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT}, vk::Format::eR32G32B32Sfloat},
-		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE}, vk::Format::eR8G8B8Unorm},
-		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT}, vk::Format::eR16G16B16Unorm},
-		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_FLOAT}, vk::Format::eR32G32B32A32Sfloat},
-		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE}, vk::Format::eR8G8B8A8Unorm},
-		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT}, vk::Format::eR16G16B16A16Unorm},
+// The bytes an accessor's elements span, throws unless they lie within its buffer view and buffer
+std::span<const std::byte> getAccessorBytes(const gltf::Document& document, const tinygltf::Accessor& accessor)
+{
+	const auto& bufferViews = document.model.bufferViews;
+
+	if (accessor.sparse.count != 0)
+	{
+		throw std::runtime_error("sparse accessors are not supported");
+	}
+
+	if (accessor.bufferView < 0 || static_cast<size_t>(accessor.bufferView) >= bufferViews.size())
+	{
+		throw std::runtime_error(fmt::format("accessor without a valid buffer view ({})", accessor.bufferView));
+	}
+
+	const auto& bufferView = bufferViews[accessor.bufferView];
+
+	if (bufferView.buffer < 0 || static_cast<size_t>(bufferView.buffer) >= document.buffers.size())
+	{
+		throw std::runtime_error(fmt::format("buffer view {} references a missing buffer", accessor.bufferView));
+	}
+
+	const auto buffer = document.buffers[bufferView.buffer];
+
+	if (bufferView.byteOffset > buffer.size() || bufferView.byteLength > buffer.size() - bufferView.byteOffset)
+	{
+		throw std::runtime_error(fmt::format("buffer view {} overruns buffer {}", accessor.bufferView, bufferView.buffer));
+	}
+
+	if (accessor.count == 0)
+	{
+		return {};
+	}
+
+	const auto elemSize = getElemSize(accessor);
+	const auto stride = std::max(vk::DeviceSize(bufferView.byteStride), elemSize);
+
+	// written so that no term overflows, (count - 1) * stride + elemSize <= byteLength - byteOffset
+	const auto fits = accessor.byteOffset <= bufferView.byteLength
+		&& elemSize <= bufferView.byteLength - accessor.byteOffset
+		&& accessor.count - 1 <= (bufferView.byteLength - accessor.byteOffset - elemSize) / stride;
+
+	if (not fits)
+	{
+		throw std::runtime_error(fmt::format("accessor of {} elements overruns buffer view {}", accessor.count, accessor.bufferView));
+	}
+
+	return buffer.subspan(bufferView.byteOffset + accessor.byteOffset, (accessor.count - 1) * stride + elemSize);
+}
+
+// what a normalized accessor of the integer component type divides by
+float getNormalizationDivisor(const int componentType)
+{
+	float result;
+
+	switch (componentType) {
+	case TINYGLTF_COMPONENT_TYPE_BYTE: result = 127.0f; break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: result = 255.0f; break;
+	case TINYGLTF_COMPONENT_TYPE_SHORT: result = 32767.0f; break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: result = 65535.0f; break;
+	default: assert(false);
+	}
+
+	return result;
+}
+
+// Elements of a float or integer accessor, normalized integers mapped to [0, 1] or [-1, 1].
+// N is the number of components its type has.
+template<glm::length_t N>
+std::vector<glm::vec<N, float>> readAccessor(const gltf::Document& document, const tinygltf::Accessor& accessor)
+{
+	assert(tinygltf::GetNumComponentsInType(accessor.type) == N);
+
+	const auto& bufferView = document.model.bufferViews[accessor.bufferView];
+	const auto elemSize = getElemSize(accessor);
+	const auto stride = std::max(bufferView.byteStride, elemSize);
+	const auto bytes = getAccessorBytes(document, accessor);
+
+	const auto readComponent = [&](const std::byte* source) {
+		const auto read = [&]<typename T>(std::type_identity<T>) {
+			auto value = T();
+			std::memcpy(&value, source, sizeof(value));
+			return value;
+		};
+
+		const auto normalize = [&](const float value) {
+			return accessor.normalized ? std::max(value / getNormalizationDivisor(accessor.componentType), -1.0f) : value;
+		};
+
+		float result;
+
+		switch (accessor.componentType) {
+		case TINYGLTF_COMPONENT_TYPE_FLOAT: result = read(std::type_identity<float>()); break;
+		case TINYGLTF_COMPONENT_TYPE_BYTE: result = normalize(read(std::type_identity<int8_t>())); break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: result = normalize(read(std::type_identity<uint8_t>())); break;
+		case TINYGLTF_COMPONENT_TYPE_SHORT: result = normalize(read(std::type_identity<int16_t>())); break;
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: result = normalize(read(std::type_identity<uint16_t>())); break;
+		default: assert(false);
+		}
+
+		return result;
 	};
 
-	if (auto it = formatMap.find({ accessor.type, accessor.componentType }); it != formatMap.end())
+	const auto componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+
+	auto result = std::vector<glm::vec<N, float>>(accessor.count);
+
+	for (auto&& [index, value] : std::views::enumerate(result))
 	{
-		return it->second;
+		const auto element = bytes.data() + index * stride;
+
+		for (auto component = glm::length_t(0); component < N; ++component)
+		{
+			value[component] = readComponent(element + component * componentSize);
+		}
 	}
 
-	assert(false);
-	return std::nullopt;
+	return result;
+}
+
+// An index accessor widened to 32 bits, throws on an index of a vertex past vertexCount.
+// Everything downstream (optimizers, simplifier, meshlets) relies on that check.
+std::vector<uint32_t> readIndices(const gltf::Document& document, const tinygltf::Accessor& accessor, const uint32_t vertexCount)
+{
+	const auto bytes = getAccessorBytes(document, accessor);
+
+	const auto read = [&]<typename T>(std::type_identity<T>) {
+		auto values = std::vector<T>(accessor.count);
+		std::memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+
+		return values
+			| std::views::transform([](const T value) { return static_cast<uint32_t>(value); })
+			| std::ranges::to<std::vector>();
+	};
+
+	std::vector<uint32_t> result;
+
+	switch (accessor.componentType) {
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: result = read(std::type_identity<uint8_t>()); break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: result = read(std::type_identity<uint16_t>()); break;
+	case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: result = read(std::type_identity<uint32_t>()); break;
+	default: throw std::runtime_error(fmt::format("invalid index component type {}", accessor.componentType));
+	}
+
+	if (std::ranges::any_of(result, [&](const uint32_t vertex) { return vertex >= vertexCount; }))
+	{
+		throw std::runtime_error(fmt::format("index past the {} vertices of its primitive", vertexCount));
+	}
+
+	return result;
+}
+
+// TRS of the EXT_mesh_gpu_instancing attributes, relative to the node
+std::vector<glm::mat4> getInstanceTransforms(const gltf::Document& document, const tinygltf::Node& node)
+{
+	const auto extension = node.extensions.find("EXT_mesh_gpu_instancing");
+
+	if (extension == node.extensions.end() || not extension->second.Has("attributes"))
+	{
+		return {};
+	}
+
+	const auto& attributes = extension->second.Get("attributes");
+
+	const auto getAccessor = [&](const std::string& name) -> const tinygltf::Accessor* {
+		return attributes.Has(name) ?
+			&document.model.accessors[attributes.Get(name).GetNumberAsInt()] :
+			nullptr;
+	};
+
+	const auto translations = getAccessor("TRANSLATION");
+	const auto rotations = getAccessor("ROTATION");
+	const auto scales = getAccessor("SCALE");
+
+	const auto count = [&] {
+		for (const auto accessor : { translations, rotations, scales })
+		{
+			if (accessor)
+			{
+				return accessor->count;
+			}
+		}
+
+		return size_t(0);
+	}();
+
+	auto result = std::vector<glm::mat4>(count, MAT4_IDENTITY);
+
+	// T * R * S, like the node's own transform
+	if (translations)
+	{
+		for (auto&& [transform, translation] : std::views::zip(result, readAccessor<3>(document, *translations)))
+		{
+			transform = glm::translate(MAT4_IDENTITY, translation);
+		}
+	}
+
+	if (rotations)
+	{
+		for (auto&& [transform, rotation] : std::views::zip(result, readAccessor<4>(document, *rotations)))
+		{
+			transform *= glm::mat4_cast(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+		}
+	}
+
+	if (scales)
+	{
+		for (auto&& [transform, scale] : std::views::zip(result, readAccessor<3>(document, *scales)))
+		{
+			transform = glm::scale(transform, scale);
+		}
+	}
+
+	return result;
 }
 
-std::optional<vk::Format> GltfImageToVkFormat(const tinygltf::Image& image, const bool unorm) {
-	using Key = std::tuple<int, int, bool>;
-	static const std::unordered_map<Key, vk::Format> formatMap = {
-		{{4, 8, false}, vk::Format::eR8G8B8A8Srgb},
-		{{4, 8, true}, vk::Format::eR8G8B8A8Unorm},
+// integer components are normalized or, with KHR_mesh_quantization, converted to float as they are
+std::optional<vk::Format> GltfToVkFormat(const tinygltf::Accessor& accessor) {
+	using Key = std::tuple<int, int, bool>; // type, component type, normalized
+	static const std::map<Key, vk::Format> formatMap = {
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_FLOAT, false}, vk::Format::eR32G32Sfloat},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_BYTE, true}, vk::Format::eR8G8Snorm},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_BYTE, false}, vk::Format::eR8G8Sscaled},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, true}, vk::Format::eR8G8Unorm},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, false}, vk::Format::eR8G8Uscaled},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_SHORT, true}, vk::Format::eR16G16Snorm},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_SHORT, false}, vk::Format::eR16G16Sscaled},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, true}, vk::Format::eR16G16Unorm},
+		{{TINYGLTF_TYPE_VEC2, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, false}, vk::Format::eR16G16Uscaled},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_FLOAT, false}, vk::Format::eR32G32B32Sfloat},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_BYTE, true}, vk::Format::eR8G8B8Snorm},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_BYTE, false}, vk::Format::eR8G8B8Sscaled},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, true}, vk::Format::eR8G8B8Unorm},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, false}, vk::Format::eR8G8B8Uscaled},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_SHORT, true}, vk::Format::eR16G16B16Snorm},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_SHORT, false}, vk::Format::eR16G16B16Sscaled},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, true}, vk::Format::eR16G16B16Unorm},
+		{{TINYGLTF_TYPE_VEC3, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, false}, vk::Format::eR16G16B16Uscaled},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_FLOAT, false}, vk::Format::eR32G32B32A32Sfloat},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_BYTE, true}, vk::Format::eR8G8B8A8Snorm},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_BYTE, false}, vk::Format::eR8G8B8A8Sscaled},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, true}, vk::Format::eR8G8B8A8Unorm},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, false}, vk::Format::eR8G8B8A8Uscaled},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_SHORT, true}, vk::Format::eR16G16B16A16Snorm},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_SHORT, false}, vk::Format::eR16G16B16A16Sscaled},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, true}, vk::Format::eR16G16B16A16Unorm},
+		{{TINYGLTF_TYPE_VEC4, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, false}, vk::Format::eR16G16B16A16Uscaled},
 	};
 
-	if (auto it = formatMap.find({ image.component, image.bits, unorm }); it != formatMap.end())
+	const auto normalized = accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT && accessor.normalized;
+
+	if (auto it = formatMap.find({ accessor.type, accessor.componentType, normalized }); it != formatMap.end())
 	{
 		return it->second;
 	}
@@ -73,7 +299,36 @@ std::optional<vk::Format> GltfImageToVkFormat(const tinygltf::Image& image, cons
 	return std::nullopt;
 }
 
-vk::SamplerCreateInfo GltfToVkSamplerInfo(const tinygltf::Sampler& sampler)
+// Format of a quantized POSITION or NORMAL. Three component 8 and 16 bit formats are rarely
+// supported for vertex input, the four component ones read the padding every vertex has in
+// the repacked buffer, see VERTEX_ATTRIBUTE_ALIGNMENT.
+vk::Format getVec3Format(const tinygltf::Accessor& accessor)
+{
+	const auto format = GltfToVkFormat(accessor).value();
+
+	vk::Format result;
+
+	switch (format) {
+	case vk::Format::eR8G8B8Snorm: result = vk::Format::eR8G8B8A8Snorm; break;
+	case vk::Format::eR8G8B8Sscaled: result = vk::Format::eR8G8B8A8Sscaled; break;
+	case vk::Format::eR8G8B8Unorm: result = vk::Format::eR8G8B8A8Unorm; break;
+	case vk::Format::eR8G8B8Uscaled: result = vk::Format::eR8G8B8A8Uscaled; break;
+	case vk::Format::eR16G16B16Snorm: result = vk::Format::eR16G16B16A16Snorm; break;
+	case vk::Format::eR16G16B16Sscaled: result = vk::Format::eR16G16B16A16Sscaled; break;
+	case vk::Format::eR16G16B16Unorm: result = vk::Format::eR16G16B16A16Unorm; break;
+	case vk::Format::eR16G16B16Uscaled: result = vk::Format::eR16G16B16A16Uscaled; break;
+	default: result = format;
+	}
+
+	return result;
+}
+
+// images are always decoded to 8 bit RGBA
+vk::Format getImageFormat(const bool unorm) {
+	return unorm ? vk::Format::eR8G8B8A8Unorm : vk::Format::eR8G8B8A8Srgb;
+}
+
+gltf::Asset::Sampler GltfToAssetSampler(const tinygltf::Sampler& sampler)
 {
 	const auto magFilter = [&] {
 		vk::Filter result;
@@ -119,70 +374,85 @@ vk::SamplerCreateInfo GltfToVkSamplerInfo(const tinygltf::Sampler& sampler)
 		return result;
 	};
 
-	return vk::SamplerCreateInfo{
+	return gltf::Asset::Sampler{
 		.magFilter = magFilter,
 		.minFilter = minFilter,
 		.addressModeU = samplerAddressMode(sampler.wrapS),
 		.addressModeV = samplerAddressMode(sampler.wrapT),
-		//.anisotropyEnable = true, // TODO
 	};
 }
 
-vk::SamplerCreateInfo getDefaultSamplerInfo()
-{
-	static auto defaultSamplerInfo = vk::SamplerCreateInfo{
-		.magFilter = vk::Filter::eLinear,
-		.minFilter = vk::Filter::eLinear,
-		.addressModeU = vk::SamplerAddressMode::eRepeat,
-		.addressModeV = vk::SamplerAddressMode::eRepeat,
-		//.anisotropyEnable = true, // TODO
-	};
+// how much worse than Tipsify's ACMR the overdraw order may make the vertex cache
+constexpr auto OVERDRAW_THRESHOLD = 1.05f;
 
-	return defaultSamplerInfo;
-}
+constexpr auto DEFAULT_SAMPLER = gltf::Asset::Sampler{
+	.magFilter = vk::Filter::eLinear,
+	.minFilter = vk::Filter::eLinear,
+	.addressModeU = vk::SamplerAddressMode::eRepeat,
+	.addressModeV = vk::SamplerAddressMode::eRepeat,
+};
+
+// everything an imported asset points into
+struct ImportStorage
+{
+	gltf::Document document;
+	std::vector<gltf::DecodedImage> decodedImages;
+	std::vector<std::byte> materials;
+	std::vector<gltf::Asset::Primitive> primitives;
+	std::vector<gltf::Asset::Mesh> meshes;
+	std::vector<gltf::Asset::Node> nodes;
+	std::vector<glm::mat4> instanceTransforms;
+	std::vector<gltf::Asset::Scene> scenes;
+	MeshletData meshlets;
+	std::vector<Lod> lods;
+	std::vector<uint32_t> indices; // of the rewritten primitives, every level of each
+	std::vector<std::byte> vertices; // of every primitive, see Asset::Primitive::vertexBuffers
+};
 
 }
 
 namespace gltf
 {
 
-Model Loader::loadFromFile(const std::string_view& gltfFile)
+Asset Loader::importFile(const std::filesystem::path& path, LoadTimings& loadTimings)
 {
-	tinygltf::Model model;
-	{
-		auto loader = tinygltf::TinyGLTF();
-		const auto filename = std::string(gltfFile);
-
-		// TODO: handle errors and warnings
-		const auto result = loader.LoadASCIIFromFile(
-			&model,
-			nullptr, // err
-			nullptr, // warn
-			filename
-		);
-
-		assert(result);
-	}
+	auto storage = std::make_shared<ImportStorage>();
 
-	auto buffers = [&] {
-		const auto transform = [](const tinygltf::Buffer& buffer) {
+	storage->document = [&] {
+		const auto timer = ScopedTimer(loadTimings.parse);
+		return loadDocument(path);
+	}();
 
-			const auto size = buffer.data.size() * sizeof(decltype(buffer.data)::value_type);
-			const auto data = reinterpret_cast<const std::byte*>(buffer.data.data());
+	const auto& document = storage->document;
+	const auto& model = document.model;
 
-			return std::span<const std::byte>(data, size);
-		};
+	// not under loadMutex, concurrent loads decode at the same time
+	storage->decodedImages = [&] {
+		const auto timer = ScopedTimer(loadTimings.imageDecode);
+		return decodeImages(document, threadPool);
+	}();
 
-		const auto spans = model.buffers
-			| std::views::transform(transform)
-			| std::ranges::to<std::vector>();
+	// the cache entry is keyed on exactly the bytes imported, not on whatever the files hold once it's stored
+	const auto sourceHashes = [&] {
+		if (not modelCache)
+		{
+			return std::vector<uint64_t>();
+		}
 
+		const auto timer = ScopedTimer(loadTimings.modelCache);
 
-		return loadBuffers(spans);
+		return document.files
+			| std::views::transform([](const MappedFile& file) { return hashBytes(file.data()); })
+			| std::ranges::to<std::vector>();
 	}();
 
-	auto samplers = std::vector<vk::Sampler>();
-	auto imageInfos = std::vector<ImageInfo>();
+	auto asset = Asset{
+		.sources = document.paths,
+		.sourceHashes = sourceHashes,
+		.buffers = document.buffers,
+	};
+
+	auto imageKeys = std::vector<std::pair<int, bool>>(); // source image, unorm
 
 	auto materials = [&] {
 		const auto transform = [&](const tinygltf::Material& material){
@@ -196,38 +466,29 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 				const auto& texture = model.textures[textureInfo.index];
 
 				assert(texture.source != -1); // TODO
-				const auto& image = model.images[texture.source];
 
 				const auto getTextureIndex = [&] {
+					const auto imageKey = std::make_pair(texture.source, unorm);
 
-					const auto data = reinterpret_cast<const std::byte*>(image.image.data());
-					const auto imageSize = image.image.size() * sizeof(decltype(image.image)::value_type);
-
-					const auto extent = [&]() {
-						return vk::Extent3D{
-							.width = static_cast<uint32_t>(image.width),
-							.height = static_cast<uint32_t>(image.height),
-							.depth = 1,
-						};
-					};
-
-					const auto imageInfo = ImageInfo{
-						.imageBuffer = std::span<const std::byte>(data, imageSize),
-						.format = GltfImageToVkFormat(image, unorm).value(),
-						.extent = extent(),
-					};
+					auto it = std::ranges::find(imageKeys, imageKey);
 
-					auto it = std::ranges::find(imageInfos, imageInfo);
-
-					if (it != imageInfos.end())
+					if (it != imageKeys.end())
 					{
-						const auto result = std::distance(imageInfos.begin(), it);
+						const auto result = std::distance(imageKeys.begin(), it);
 						return static_cast<uint32_t>(result);
 					}
 					else
 					{
-						imageInfos.push_back(imageInfo);
-						const auto result = imageInfos.size() - 1;
+						const auto& image = storage->decodedImages[texture.source];
+
+						imageKeys.push_back(imageKey);
+						asset.images.push_back(Asset::Image{
+							.texels = image.data(),
+							.format = getImageFormat(unorm),
+							.extent = image.extent,
+						});
+
+						const auto result = asset.images.size() - 1;
 						return static_cast<uint32_t>(result);
 					}
 				};
@@ -237,23 +498,21 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 				};
 
 				const auto getSamplerIndex = [&] {
-					const auto samplerInfo = texture.sampler != -1 ?
-						GltfToVkSamplerInfo(model.samplers[texture.sampler]) :
-						getDefaultSamplerInfo();
-
-					const auto sampler = getSampler(samplerInfo);
+					const auto sampler = texture.sampler != -1 ?
+						GltfToAssetSampler(model.samplers[texture.sampler]) :
+						DEFAULT_SAMPLER;
 
-					auto it = std::ranges::find(samplers, sampler);
+					auto it = std::ranges::find(asset.samplers, sampler);
 
-					if (it != samplers.end())
+					if (it != asset.samplers.end())
 					{
-						const auto result = std::distance(samplers.begin(), it);
+						const auto result = std::distance(asset.samplers.begin(), it);
 						return static_cast<uint32_t>(result);
 					}
 					else
 					{
-						samplers.push_back(sampler);
-						const auto result = samplers.size() - 1;
+						asset.samplers.push_back(sampler);
+						const auto result = asset.samplers.size() - 1;
 						return static_cast<uint32_t>(result);
 					}
 				};
@@ -291,8 +550,30 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 		return result;
 	}();
 
-	auto materialsSSBO = createMaterialsSSBO(materials);
-	auto imageData = createImages(imageInfos);
+	storage->materials = [&] {
+		const auto timer = ScopedTimer(loadTimings.createMaterialsSSBO);
+		return packMaterials(materials);
+	}();
+
+	// the glTF attributes of each primitive, repacked once the vertex order is known
+	struct VertexSource
+	{
+		std::array<vk::DeviceSize, VERTEX_INPUT_NUM> elemSizes; // of the vertex buffers
+		uint32_t vertexCount;
+	};
+	auto vertexSources = std::vector<VertexSource>();
+
+	// an indexed triangle list with positions, the import rewrites its index data and vertex order
+	struct GeometrySource
+	{
+		uint32_t primitive;
+		std::vector<uint32_t> indices;
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> vertexOrder; // the source vertex of each optimized one
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+	auto geometrySources = std::vector<GeometrySource>();
 
 	const auto createPrimitive = [&](const tinygltf::Primitive& primitive) {
 		const auto getPrimitiveMode = [&] {
@@ -313,36 +594,65 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 			return result;
 		};
 
-		auto vertexBindData = Primitive::VertexBindData();
+		auto result = Asset::Primitive{
+			.topology = getPrimitiveMode(),
+		};
+
+		const auto getBufferRange = [&](const tinygltf::Accessor& accessor) {
+			getAccessorBytes(document, accessor); // throws when the range overruns its buffer
 
-		const auto getBindingData = [&](const tinygltf::Accessor& accessor) {
 			const auto& bufferView = model.bufferViews[accessor.bufferView];
-			const auto& buffer = buffers[bufferView.buffer].vmaBuffer;
-			const auto offset = accessor.byteOffset + bufferView.byteOffset/* + buffer.offset()*/;
 			const auto elemSize = getElemSize(accessor);
 			const auto stride = std::max(bufferView.byteStride, elemSize);
-			const auto size = accessor.count * stride - (stride - elemSize);
 
-			return std::make_tuple(*buffer, offset, size, stride);
+			return Asset::BufferRange{
+				.buffer = static_cast<uint32_t>(bufferView.buffer),
+				.offset = accessor.byteOffset + bufferView.byteOffset,
+				.size = accessor.count * stride - (stride - elemSize),
+				.stride = stride,
+			};
 		};
 
-		auto primitivePipelineInfo = PrimitivePipelineInfo{};
+		auto& primitivePipelineInfo = result.pipelineInfo;
 
 		const auto& accessors = model.accessors;
 
-		auto count = uint32_t{};
-		auto drawFunc = &Primitive::DrawNonIndexed;
+		const tinygltf::Accessor* positions = nullptr;
+		auto& vertexSource = vertexSources.emplace_back();
 
 		const auto position_l = [&](const tinygltf::Accessor& accessor) {
-			count = accessor.count;
+			result.count = accessor.count;
+			positions = &accessor;
+			primitivePipelineInfo.position = getVec3Format(accessor);
+
+			// min and max hold the stored values, normalized ones map to positions like the vertices do
+			const auto getBound = [&](const std::vector<double>& values) {
+				const auto bound = glm::vec3(values[0], values[1], values[2]);
+
+				return accessor.normalized ?
+					glm::max(bound / getNormalizationDivisor(accessor.componentType), glm::vec3(-1.0f)) :
+					bound;
+			};
+
+			// required for POSITION, without them the primitive is never culled
+			if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3)
+			{
+				result.boundsMin = getBound(accessor.minValues);
+				result.boundsMax = getBound(accessor.maxValues);
+			}
+			else
+			{
+				result.boundsMin = glm::vec3(-std::numeric_limits<float>::max());
+				result.boundsMax = glm::vec3(std::numeric_limits<float>::max());
+			}
 		};
 
 		const auto normal_l = [&](const tinygltf::Accessor& accessor) {
-			primitivePipelineInfo.hasNormal = true;
+			primitivePipelineInfo.normal = getVec3Format(accessor);
 		};
 
 		const auto tangent_l = [&](const tinygltf::Accessor& accessor) {
-			primitivePipelineInfo.hasTangent = true;
+			primitivePipelineInfo.tangent = GltfToVkFormat(accessor).value();
 		};
 
 		const auto texcoord0_l = [&](const tinygltf::Accessor& accessor) {
@@ -374,57 +684,67 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 			if (const auto it = primitive.attributes.find(attribute.first); it != primitive.attributes.end())
 			{
 				const auto& accessor = accessors[it->second];
-				const auto [buffer, offset, size, stride] = getBindingData(accessor);
 
-				vertexBindData.add(buffer, offset, size, stride);
+				vertexSource.elemSizes[result.vertexBufferCount] = getElemSize(accessor);
+				result.vertexBuffers[result.vertexBufferCount++] = getBufferRange(accessor);
 
 				attribute.second(accessor);
 			}
 		}
 
-		auto indexedData = [&] -> decltype(Primitive::indexedData) {
-			if (const auto indices = primitive.indices; indices != -1)
-			{
-				const auto& accessor = accessors[indices];
-				const auto [buffer, offset, size, stride] = getBindingData(accessor);
+		assert(positions); // TODO
+		vertexSource.vertexCount = static_cast<uint32_t>(positions->count);
 
-				const auto indexType = [&]
-				{
-					vk::IndexType result;
+		// the vertices are repacked by reading vertexCount elements of every attribute
+		const auto hasVertexCount = [&](const pair_t& attribute) {
+			const auto it = primitive.attributes.find(attribute.first);
+			return it == primitive.attributes.end() || accessors[it->second].count == positions->count;
+		};
 
-					switch (accessor.componentType) {
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: result = vk::IndexType::eUint8; break;
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: result = vk::IndexType::eUint16; break;
-					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: result = vk::IndexType::eUint32; break;
-					default: assert(false);
-					}
+		if (not std::ranges::all_of(attributes, hasVertexCount))
+		{
+			throw std::runtime_error(fmt::format("vertex attributes of a primitive differ in count from its {} positions", positions->count));
+		}
 
-					return result;
-				}();
+		if (const auto indices = primitive.indices; indices != -1)
+		{
+			const auto& accessor = accessors[indices];
 
-				auto result = Primitive::IndexedData
-				{
-					.buffer = buffer,
-					.offset = offset,
-					.size = size,
-					.type = indexType,
-				};
+			const auto indexType = [&]
+			{
+				vk::IndexType result;
 
-				count = accessor.count;
-				drawFunc = &Primitive::DrawIndexed;
-				return std::make_optional(std::move(result));
-			}
+				switch (accessor.componentType) {
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: result = vk::IndexType::eUint8; break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: result = vk::IndexType::eUint16; break;
+				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: result = vk::IndexType::eUint32; break;
+				default: assert(false);
+				}
+
+				return result;
+			}();
+
+			result.indexed = true;
+			result.indexType = indexType;
+			result.indices = getBufferRange(accessor);
+			result.count = accessor.count;
+		}
 
-			return std::nullopt;
-		}();
+		// reordered for the vertex cache, overdraw and vertex fetch, then simplified and split into meshlets
+		if (result.indexed && result.topology == vk::PrimitiveTopology::eTriangleList && positions && result.count > 0)
+		{
+			geometrySources.push_back(GeometrySource{
+				.primitive = static_cast<uint32_t>(storage->primitives.size()),
+				.indices = readIndices(document, accessors[primitive.indices], vertexSource.vertexCount),
+				.positions = readAccessor<3>(document, *positions),
+			});
+		}
 
-		const auto materialIndex = [&] {
-			return primitive.material != -1 ?
-				static_cast<uint32_t>(primitive.material) :
-				static_cast<uint32_t>(model.materials.size());
-		}();
+		result.materialIndex = primitive.material != -1 ?
+			static_cast<uint32_t>(primitive.material) :
+			static_cast<uint32_t>(model.materials.size());
 
-		const auto& material = materials[materialIndex];
+		const auto& material = materials[result.materialIndex];
 
 		primitivePipelineInfo.hasBaseColorTexture = material.baseColorTexture.has_value();
 		primitivePipelineInfo.hasMetallicRoughnessTexture = material.metallicRoughnessTexture.has_value();
@@ -432,159 +752,312 @@ Model Loader::loadFromFile(const std::string_view& gltfFile)
 		primitivePipelineInfo.hasOcclusionTexture = material.occlusionTexture.has_value();
 		primitivePipelineInfo.hasEmissiveTexture = material.emissiveTexture.has_value();
 
-		return Primitive{
-			.vertexBindData = std::move(vertexBindData),
-			.topology = getPrimitiveMode(),
-			.pipeline = getPipeline(primitivePipelineInfo),
-			.count = count,
-			.indexedData = std::move(indexedData),
-			.materialIndex = materialIndex,
-			.drawFunc = drawFunc,
-		};
+		return result;
 	};
 
-	const auto createMesh = [&](const tinygltf::Mesh& mesh) {
-		auto primitives = mesh.primitives
-			| std::views::transform([&](const auto& primitive) { return createPrimitive(primitive); })
-			| std::ranges::to<std::vector>();
+	for (const auto& mesh : model.meshes)
+	{
+		storage->meshes.push_back(Asset::Mesh{
+			.firstPrimitive = static_cast<uint32_t>(storage->primitives.size()),
+			.primitiveCount = static_cast<uint32_t>(mesh.primitives.size()),
+		});
+
+		std::ranges::transform(mesh.primitives, std::back_inserter(storage->primitives), createPrimitive);
+	}
+
+	// a primitive at a time on every thread
+	{
+		const auto timer = ScopedTimer(loadTimings.optimizeIndices);
+
+		threadPool.parallelFor(geometrySources.size(), [&](const size_t index) {
+			auto& source = geometrySources[index];
+			const auto vertexCount = static_cast<uint32_t>(source.positions.size());
+
+			source.before = getVertexCacheStats(source.indices, vertexCount);
+
+			auto clusterStarts = std::vector<uint32_t>();
+			optimizeVertexCache(source.indices, vertexCount, clusterStarts);
+			optimizeOverdraw(source.indices, clusterStarts, source.positions, OVERDRAW_THRESHOLD);
+
+			source.vertexOrder = optimizeVertexFetch(source.indices, vertexCount);
+			source.positions = source.vertexOrder
+				| std::views::transform([&](const uint32_t vertex) { return source.positions[vertex]; })
+				| std::ranges::to<std::vector>();
+
+			source.after = getVertexCacheStats(source.indices, static_cast<uint32_t>(source.positions.size()));
+		});
+	}
+
+	for (const auto& source : geometrySources)
+	{
+		loadTimings.vertexCacheBefore += source.before;
+		loadTimings.vertexCacheAfter += source.after;
+	}
+
+	const auto lodChains = [&] {
+		const auto timer = ScopedTimer(loadTimings.buildLods);
+
+		auto result = std::vector<LodChain>(geometrySources.size());
+
+		threadPool.parallelFor(geometrySources.size(), [&](const size_t index) {
+			result[index] = buildLodChain(geometrySources[index].indices, geometrySources[index].positions);
+		});
+
+		return result;
+	}();
+
+	// Rewritten primitives draw every level from one 32 bit index range in a buffer of their own,
+	// starting with the full mesh. The other primitives keep pointing into the glTF buffers and only
+	// have the full mesh. The vertices of every primitive are repacked into another buffer.
+	const auto vertexBuffer = static_cast<uint32_t>(asset.buffers.size());
+	const auto indexBuffer = vertexBuffer + 1;
+
+	auto primitiveSources = std::vector<std::pair<const GeometrySource*, const LodChain*>>(storage->primitives.size());
+
+	for (const auto& [source, chain] : std::views::zip(geometrySources, lodChains))
+	{
+		primitiveSources[source.primitive] = std::make_pair(&source, &chain);
+	}
+
+	for (auto&& [primitive, sources] : std::views::zip(storage->primitives, primitiveSources))
+	{
+		const auto [source, chain] = sources;
+
+		primitive.firstLod = static_cast<uint32_t>(storage->lods.size());
+
+		if (not source)
+		{
+			primitive.lodCount = 1;
+			storage->lods.push_back(Lod{ .firstIndex = 0, .indexCount = primitive.count, .error = 0.0f });
+			continue;
+		}
 
-		return Mesh{
-			.primitives = std::move(primitives),
+		// for cluster culling, which needs the positions to bound the meshlets
+		primitive.firstMeshlet = static_cast<uint32_t>(storage->meshlets.meshlets.size());
+		primitive.meshletCount = buildMeshlets(source->indices, source->positions, storage->meshlets);
+
+		primitive.indexType = vk::IndexType::eUint32;
+		primitive.indices = Asset::BufferRange{
+			.buffer = indexBuffer,
+			.offset = storage->indices.size() * sizeof(uint32_t),
+			.size = chain->indices.size() * sizeof(uint32_t),
+			.stride = sizeof(uint32_t),
 		};
-	};
+		primitive.lodCount = static_cast<uint32_t>(chain->lods.size());
 
-	auto meshes = model.meshes
-		| std::views::transform([&](const auto& mesh) { return createMesh(mesh); })
-		| std::ranges::to<std::vector>();
+		storage->lods.append_range(chain->lods);
+		storage->indices.append_range(chain->indices);
+	}
 
-	const auto createNode = [&](this auto self, const tinygltf::Node& node, const glm::mat4& parentTransform) -> Node {
-		const auto modelMatix = parentTransform * getNodeMat4(node);
+	// Primitives with the same strides share a position array and an attribute array, with their
+	// vertices at the same place in both, so their draws batch from one set of bindings
+	{
+		const auto alignAttribute = [](const vk::DeviceSize size) {
+			return (size + VERTEX_ATTRIBUTE_ALIGNMENT - 1) & ~(VERTEX_ATTRIBUTE_ALIGNMENT - 1);
+		};
 
-		auto children = node.children
-			| std::views::transform([&](const auto& childIndex) { return self(model.nodes[childIndex], modelMatix); })
-			| std::ranges::to<std::vector>();
+		const auto getStrides = [&](const Asset::Primitive& primitive, const VertexSource& vertexSource) {
+			const auto attributeSizes = std::span(vertexSource.elemSizes).first(primitive.vertexBufferCount).subspan(1)
+				| std::views::transform(alignAttribute);
 
-		return Node{
-			.modelMatix = modelMatix,
-			.mesh = node.mesh == -1 ? std::nullopt : std::make_optional(std::ref(meshes[node.mesh])),
-			.frontFace = glm::determinant(modelMatix) > 0.0f ? vk::FrontFace::eCounterClockwise : vk::FrontFace::eClockwise,
-			.children = std::move(children),
+			return std::make_pair(alignAttribute(vertexSource.elemSizes[0]), std::reduce(attributeSizes.begin(), attributeSizes.end(), vk::DeviceSize(0)));
 		};
-	};
 
-	const auto createScene = [&](const tinygltf::Scene& scene) {
-		auto nodes = scene.nodes
-			| std::views::transform([&](const auto& nodeIndex) { return createNode(model.nodes[nodeIndex], MAT4_IDENTITY); })
-			| std::ranges::to<std::vector>();
+		struct VertexGroup
+		{
+			uint32_t vertexCount;
+			vk::DeviceSize positionsOffset;
+			vk::DeviceSize attributesOffset;
+		};
+		auto groups = std::map<std::pair<vk::DeviceSize, vk::DeviceSize>, VertexGroup>(); // by position and attribute stride
 
-		return Scene{
-			.nodes = std::move(nodes)
+		// the vertices of unoptimized primitives keep their order
+		const auto getVertexCount = [&](const GeometrySource* source, const VertexSource& vertexSource) {
+			return source ? static_cast<uint32_t>(source->vertexOrder.size()) : vertexSource.vertexCount;
 		};
-	};
 
-	auto scenes = model.scenes
-		| std::views::transform([&](const auto& scene) { return createScene(scene); })
-		| std::ranges::to<std::vector>();
+		auto firstVertices = std::vector<uint32_t>();
 
-	auto descriptorSetsRAII = [&] {
-		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
-			.descriptorPool = descriptorPool,
-		}.setSetLayouts(*pipelineLayoutData.descriptorSetLayout);
+		for (const auto& [primitive, vertexSource, sources] : std::views::zip(storage->primitives, vertexSources, primitiveSources))
+		{
+			auto& group = groups[getStrides(primitive, vertexSource)];
 
-		return device.allocateDescriptorSets(allocateInfo);
-	}(); 
+			firstVertices.push_back(group.vertexCount);
+			group.vertexCount += getVertexCount(sources.first, vertexSource);
+		}
 
-	auto bindlessDescriptorSetsRAII = [&] {
-		constexpr auto descriptorCount = 256u;
+		auto size = vk::DeviceSize(0);
 
-		const auto countInfo = vk::DescriptorSetVariableDescriptorCountAllocateInfo{}
-			.setDescriptorCounts(descriptorCount);
+		for (auto& [strides, group] : groups)
+		{
+			group.positionsOffset = size;
+			size += group.vertexCount * strides.first;
+			group.attributesOffset = size;
+			size += group.vertexCount * strides.second;
+		}
 
-		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
-			.pNext = &countInfo,
-			.descriptorPool = bindlessDescriptorPool,
-		}.setSetLayouts(*pipelineLayoutData.bindlessDescriptorSetLayout);
+		storage->vertices.resize(size);
 
-		return device.allocateDescriptorSets(allocateInfo);
-	}();
+		for (auto&& [primitive, vertexSource, sources, firstVertex] : std::views::zip(storage->primitives, vertexSources, primitiveSources, firstVertices))
+		{
+			const auto strides = getStrides(primitive, vertexSource);
+			const auto& group = groups.at(strides);
+			const auto vertexOrder = sources.first ? std::span(sources.first->vertexOrder) : std::span<const uint32_t>();
+			const auto vertexCount = getVertexCount(sources.first, vertexSource);
 
-	auto descriptorSets = std::vector<vk::DescriptorSet>();
-	descriptorSets.reserve(descriptorSetsRAII.size() + bindlessDescriptorSetsRAII.size());
+			const auto positionsOffset = group.positionsOffset + firstVertex * strides.first;
+			const auto attributesOffset = group.attributesOffset + firstVertex * strides.second;
+			auto attributeOffset = attributesOffset;
 
-	for (const auto& descriptorSet : descriptorSetsRAII)
+			for (const auto& [index, range, elemSize] : std::views::zip(std::views::iota(0u), std::span(primitive.vertexBuffers).first(primitive.vertexBufferCount), vertexSource.elemSizes))
+			{
+				const auto bytes = document.buffers[range.buffer].subspan(range.offset);
+				const auto [offset, stride] = index == 0 ?
+					std::make_pair(positionsOffset, strides.first) :
+					std::make_pair(attributeOffset, strides.second);
+
+				for (auto vertex = 0u; vertex < vertexCount; ++vertex)
+				{
+					const auto sourceVertex = vertexOrder.empty() ? vertex : vertexOrder[vertex];
+					std::memcpy(storage->vertices.data() + offset + vertex * stride, bytes.data() + sourceVertex * range.stride, elemSize);
+				}
+
+				if (index > 0)
+				{
+					attributeOffset += alignAttribute(elemSize);
+				}
+			}
+
+			primitive.vertexBufferCount = strides.second > 0 ? 2 : 1;
+			primitive.vertexBuffers[0] = Asset::BufferRange{
+				.buffer = vertexBuffer,
+				.offset = positionsOffset,
+				.size = vertexCount * strides.first,
+				.stride = strides.first,
+			};
+			primitive.vertexBuffers[1] = Asset::BufferRange{
+				.buffer = vertexBuffer,
+				.offset = attributesOffset,
+				.size = vertexCount * strides.second,
+				.stride = strides.second,
+			};
+		}
+	}
+
+	if (not storage->vertices.empty())
 	{
-		descriptorSets.push_back(*descriptorSet);
+		asset.buffers.push_back(std::as_bytes(std::span(storage->vertices)));
 	}
 
-	for (auto& descriptorSet : bindlessDescriptorSetsRAII)
+	if (not storage->indices.empty())
 	{
-		descriptorSets.push_back(*descriptorSet);
+		asset.buffers.push_back(std::as_bytes(std::span(storage->indices)));
 	}
 
-	std::ranges::move(bindlessDescriptorSetsRAII, std::back_inserter(descriptorSetsRAII));
-	bindlessDescriptorSetsRAII.clear();
+	// glTF buffers only the repacked vertices and rewritten indices were read from aren't uploaded
+	{
+		auto used = std::vector<bool>(asset.buffers.size());
 
-	auto descriptorWrites = std::vector<vk::WriteDescriptorSet>();
-	descriptorWrites.reserve(1 + imageData.size());
+		const auto getRanges = [](Asset::Primitive& primitive) {
+			auto result = std::span(primitive.vertexBuffers).first(primitive.vertexBufferCount)
+				| std::views::transform([](Asset::BufferRange& range) { return &range; })
+				| std::ranges::to<std::vector>();
 
-	{
-		const auto descriptorBufferInfo = vk::DescriptorBufferInfo{
-			.buffer = *materialsSSBO.vmaBuffer,
-			.range = vk::WholeSize,
+			if (primitive.indexed)
+			{
+				result.push_back(&primitive.indices);
+			}
+
+			return result;
 		};
 
-		const auto descriptorWrite = vk::WriteDescriptorSet{
-			.dstSet = descriptorSets[0],
-			.dstBinding = 0,
-			.dstArrayElement = 0,
-			.descriptorType = vk::DescriptorType::eStorageBuffer,
-		}.setBufferInfo(descriptorBufferInfo);
+		for (auto& primitive : storage->primitives)
+		{
+			for (const auto range : getRanges(primitive))
+			{
+				used[range->buffer] = true;
+			}
+		}
 
-		descriptorWrites.push_back(descriptorWrite);
-	}
+		auto remap = std::vector<uint32_t>(asset.buffers.size());
+		auto buffers = std::vector<std::span<const std::byte>>();
 
-	const auto descriptorImageInfos = [&] {
-		const auto transform = [&](const ImageData& data) {
-			return vk::DescriptorImageInfo{
-				.sampler = samplers[0], // TODO
-				.imageView = data.imageView,
-				.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
-			};
-		};
+		for (const auto& [index, buffer] : std::views::enumerate(asset.buffers))
+		{
+			if (used[index])
+			{
+				remap[index] = static_cast<uint32_t>(buffers.size());
+				buffers.push_back(buffer);
+			}
+		}
 
-		return imageData
-			| std::views::transform(transform)
-			| std::ranges::to<std::vector>();
-	}();
+		for (auto& primitive : storage->primitives)
+		{
+			for (const auto range : getRanges(primitive))
+			{
+				range->buffer = remap[range->buffer];
+			}
+		}
 
-	if(not descriptorImageInfos.empty())
-	{
-		const auto descriptorWrite = vk::WriteDescriptorSet{
-			.dstSet = descriptorSets[1],
-			.dstBinding = 1,
-			.dstArrayElement = 0,
-			.descriptorType = vk::DescriptorType::eCombinedImageSampler,
-		}.setImageInfo(descriptorImageInfos);
-
-		descriptorWrites.push_back(descriptorWrite);
+		asset.buffers = std::move(buffers);
 	}
 
-	device.updateDescriptorSets(descriptorWrites, {});
+	// instantiates the node hierarchy, the children are laid out before recursing so they stay contiguous
+	const auto addNodes = [&](this auto self, const std::vector<int>& nodeIndices, const glm::mat4& parentTransform) -> std::pair<uint32_t, uint32_t> {
+		auto& nodes = storage->nodes;
 
-	auto modelData = Model::Data
-	{
-		.buffers = std::move(buffers),
-		.meshes = std::move(meshes),
-		.scenes = std::move(scenes),
-		.materialsSSBO = std::move(materialsSSBO),
-		.imageData = std::move(imageData),
-		.pipelineLayout = *pipelineLayoutData.pipelineLayout,
-		.descriptorSetsRAII = std::move(descriptorSetsRAII),
-		.descriptorSets = std::move(descriptorSets),
-		.device = device,
+		const auto first = static_cast<uint32_t>(nodes.size());
+		nodes.resize(nodes.size() + nodeIndices.size());
+
+		for (const auto& [index, nodeIndex] : std::views::enumerate(nodeIndices))
+		{
+			const auto& node = model.nodes[nodeIndex];
+			const auto modelMatrix = parentTransform * getNodeMat4(node);
+			const auto [firstChild, childCount] = self(node.children, modelMatrix);
+
+			const auto instanceTransforms = node.mesh != -1 ?
+				getInstanceTransforms(document, node) :
+				std::vector<glm::mat4>();
+
+			nodes[first + index] = Asset::Node{
+				.modelMatrix = modelMatrix,
+				.mesh = node.mesh,
+				.firstChild = firstChild,
+				.childCount = childCount,
+				.firstInstance = static_cast<uint32_t>(storage->instanceTransforms.size()),
+				.instanceCount = static_cast<uint32_t>(instanceTransforms.size()),
+			};
+
+			storage->instanceTransforms.append_range(instanceTransforms);
+		}
+
+		return std::make_pair(first, static_cast<uint32_t>(nodeIndices.size()));
 	};
 
-	return Model(std::move(modelData));
+	for (const auto& scene : model.scenes)
+	{
+		const auto [firstNode, nodeCount] = addNodes(scene.nodes, MAT4_IDENTITY);
+
+		storage->scenes.push_back(Asset::Scene{
+			.firstNode = firstNode,
+			.nodeCount = nodeCount,
+		});
+	}
+
+	asset.materials = storage->materials;
+	asset.materialCount = static_cast<uint32_t>(materials.size());
+	asset.primitives = storage->primitives;
+	asset.meshes = storage->meshes;
+	asset.nodes = storage->nodes;
+	asset.instanceTransforms = storage->instanceTransforms;
+	asset.scenes = storage->scenes;
+	asset.meshlets = storage->meshlets.meshlets;
+	asset.meshletVertices = storage->meshlets.vertices;
+	asset.meshletTriangles = storage->meshlets.triangles;
+	asset.lods = storage->lods;
+	asset.storage = std::move(storage);
+
+	return asset;
 }
 
 }
@@ -1,78 +1,195 @@
 #include "model.h"
-#include <shaders/shared.inl>
+#include "util/radix_sort.h"
+#include "util/frustum.h"
 
-namespace gltf
+namespace
 {
 
-// TODO: handle no POSITION case 
-void Primitive::Draw(const DrawInfo& info) const
+// Bit widths of the draw sort key, most significant first. Ids beyond their width
+// wrap around, which only costs sorting quality
+constexpr auto SORT_KEY_PIPELINE_BITS = 10u;
+constexpr auto SORT_KEY_MATERIAL_BITS = 14u;
+constexpr auto SORT_KEY_VERTEX_BUFFERS_BITS = 16u;
+constexpr auto SORT_KEY_DEPTH_BITS = 24u;
+
+static_assert(SORT_KEY_PIPELINE_BITS + SORT_KEY_MATERIAL_BITS + SORT_KEY_VERTEX_BUFFERS_BITS + SORT_KEY_DEPTH_BITS == 64);
+
+uint64_t getKeyBits(const uint64_t value, const uint32_t bits, const uint32_t shift)
 {
-	const auto& commandBuffer = info.commandBuffer;
+	return (value & ((uint64_t(1) << bits) - 1)) << shift;
+}
 
-	const auto pushConstantsInfo = vk::PushConstantsInfo{
-		.layout = info.pipelineLayout,
-		.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-		.offset = offsetof(PushConstants, materialIndex),
-		.size = sizeof(PushConstants::materialIndex),
-		.pValues = &materialIndex,
+uint64_t makeSortKey(const uint32_t pipelineId, const uint32_t materialIndex, const uint32_t vertexBuffersId)
+{
+	constexpr auto vertexBuffersShift = SORT_KEY_DEPTH_BITS;
+	constexpr auto materialShift = vertexBuffersShift + SORT_KEY_VERTEX_BUFFERS_BITS;
+	constexpr auto pipelineShift = materialShift + SORT_KEY_MATERIAL_BITS;
+
+	return getKeyBits(pipelineId, SORT_KEY_PIPELINE_BITS, pipelineShift)
+		| getKeyBits(materialIndex, SORT_KEY_MATERIAL_BITS, materialShift)
+		| getKeyBits(vertexBuffersId, SORT_KEY_VERTEX_BUFFERS_BITS, vertexBuffersShift);
+}
+
+// the bits of a positive float sort like the float, anything behind the camera goes first
+uint64_t getDepthKey(const float depth)
+{
+	return depth > 0.0f ? std::bit_cast<uint32_t>(depth) >> (32 - SORT_KEY_DEPTH_BITS) : 0;
+}
+
+// box around the transformed box, clamped so an unbounded primitive stays finite
+Bvh::Box getWorldBounds(const glm::mat4& modelMatrix, const gltf::Primitive::Bounds& bounds)
+{
+	const auto center = glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	const auto extent = glm::mat3(
+		glm::abs(glm::vec3(modelMatrix[0])),
+		glm::abs(glm::vec3(modelMatrix[1])),
+		glm::abs(glm::vec3(modelMatrix[2]))
+	) * ((bounds.max - bounds.min) * 0.5f);
+
+	constexpr auto limit = std::numeric_limits<float>::max();
+
+	return Bvh::Box{
+		.min = glm::clamp(center - extent, -limit, limit),
+		.max = glm::clamp(center + extent, -limit, limit),
 	};
+}
+
+// minimum maxDrawIndirectCount guaranteed with multiDrawIndirect
+constexpr auto MAX_BATCH_DRAW_COUNT = uint32_t(65535);
+
+// fewest draw calls or batches recorded by a thread of parallel recording
+constexpr auto MIN_CHUNK_SIZE = size_t(256);
 
-	commandBuffer.pushConstants2(pushConstantsInfo);
+uint32_t getIndexSize(const vk::IndexType type)
+{
+	switch (type)
+	{
+	case vk::IndexType::eUint8: return 1;
+	case vk::IndexType::eUint16: return 2;
+	case vk::IndexType::eUint32: return 4;
+	default: assert(false); return 1;
+	}
+}
 
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+// Vertex count from the bound offsets to a draw's offsets, the same for every binding,
+// or nullopt if the draw can't be reached from those bindings
+std::optional<int32_t> getVertexOffset(const gltf::Primitive::VertexBindData& bound, const gltf::Primitive::VertexBindData& draw)
+{
+	if (not std::ranges::equal(bound.buffers, draw.buffers) || not std::ranges::equal(bound.strides, draw.strides))
+	{
+		return std::nullopt;
+	}
 
-	// dynamic states
-	commandBuffer.setPrimitiveTopology(topology);
-	commandBuffer.setFrontFace(info.frontFace);
+	auto vertexOffset = std::optional<vk::DeviceSize>();
 
+	for (const auto& [boundOffset, offset, stride] : std::views::zip(bound.offsets, draw.offsets, draw.strides))
 	{
-		const auto& surfaceExtent = info.surfaceExtent;
+		if (offset < boundOffset || (stride == 0 && offset != boundOffset))
+		{
+			return std::nullopt;
+		}
 
-		// https://www.saschawillems.de/blog/2019/03/29/flipping-the-vulkan-viewport/
-		const auto viewport = vk::Viewport{
-			.y = float(surfaceExtent.height),
-			.width = float(surfaceExtent.width),
-			.height = -float(surfaceExtent.height),
-			.maxDepth = 1,
-		};
-		commandBuffer.setViewport(0, viewport);
+		if (stride == 0)
+		{
+			continue;
+		}
+
+		const auto distance = offset - boundOffset;
+
+		if (distance % stride != 0 || (vertexOffset && *vertexOffset != distance / stride))
+		{
+			return std::nullopt;
+		}
 
-		const auto scissor = vk::Rect2D{ .extent = surfaceExtent };
-		commandBuffer.setScissor(0, scissor);
+		vertexOffset = distance / stride;
 	}
 
-	commandBuffer.bindVertexBuffers2(
-		0,
-		vertexBindData.buffers,
-		vertexBindData.offsets,
-		vertexBindData.sizes,
-		vertexBindData.strides
-	);
+	if (vertexOffset.value_or(0) > vk::DeviceSize(std::numeric_limits<int32_t>::max()))
+	{
+		return std::nullopt;
+	}
 
-	(this->*drawFunc)(info);
+	return static_cast<int32_t>(vertexOffset.value_or(0));
 }
 
-void Primitive::DrawIndexed(const DrawInfo& info) const
+// Index count from the bound offset to a draw's first index, or nullopt if unreachable
+std::optional<uint32_t> getFirstIndex(const gltf::Primitive::IndexedData& bound, const gltf::Primitive::IndexedData& draw)
 {
-	assert(indexedData);
+	if (bound.buffer != draw.buffer || bound.type != draw.type || draw.offset < bound.offset)
+	{
+		return std::nullopt;
+	}
 
-	const auto& commandBuffer = info.commandBuffer;
+	const auto indexSize = getIndexSize(draw.type);
+	const auto distance = draw.offset - bound.offset;
 
-	commandBuffer.bindIndexBuffer2(
-		indexedData->buffer,
-		indexedData->offset,
-		indexedData->size,
-		indexedData->type
-	);
+	if (distance % indexSize != 0 || distance / indexSize > std::numeric_limits<uint32_t>::max())
+	{
+		return std::nullopt;
+	}
 
-	commandBuffer.drawIndexed(count, 1, 0, 0, 0);
+	return static_cast<uint32_t>(distance / indexSize);
 }
 
-void Primitive::DrawNonIndexed(const DrawInfo& info) const
+template<typename T>
+void appendBytes(std::vector<std::byte>& bytes, const T& value)
 {
-	info.commandBuffer.draw(count, 1, 0, 0 );
+	const auto valueBytes = std::as_bytes(std::span(&value, 1));
+	bytes.insert(bytes.end(), valueBytes.begin(), valueBytes.end());
 }
 
+// Bounds the error of the levels of detail by pixelError at every distance. At distance 1, a pixel
+// is 2 / viewportHeight of clip space, which the projection scales up from view space.
+LodSelection getLodSelection(const glm::mat4& viewProj, const uint32_t viewportHeight, const float pixelError)
+{
+	const auto pixelSize = viewportHeight > 0 ? 2.0f / (float(viewportHeight) * getProjectionScale(viewProj)) : 0.0f;
+
+	return LodSelection{
+		.cameraPosition = getCameraPosition(viewProj),
+		.maxErrorPerDistance = pixelError * pixelSize,
+	};
+}
+
+// the coarsest level within the selection's bound, like selectLod of the culling passes
+const Lod& selectLod(
+	const std::span<const Lod> lods,
+	const glm::mat4& modelMatrix,
+	const gltf::Primitive::Bounds& bounds,
+	const LodSelection& selection)
+{
+	const auto scale = std::max({
+		glm::length(glm::vec3(modelMatrix[0])),
+		glm::length(glm::vec3(modelMatrix[1])),
+		glm::length(glm::vec3(modelMatrix[2])),
+	});
+
+	const auto center = glm::vec3(modelMatrix * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+	const auto radius = glm::length(bounds.max - bounds.min) * 0.5f * scale;
+	const auto distance = std::max(glm::distance(center, selection.cameraPosition) - radius, 0.0f);
+
+	auto lod = lods.begin();
+
+	while (std::next(lod) != lods.end() && std::next(lod)->error * scale <= distance * selection.maxErrorPerDistance)
+	{
+		++lod;
+	}
+
+	return *lod;
+}
+
+template<typename T>
+void permute(std::vector<T>& values, const std::span<const uint32_t> order)
+{
+	values = order
+		| std::views::transform([&](const uint32_t index) { return std::move(values[index]); })
+		| std::ranges::to<std::vector>();
+}
+
+}
+
+namespace gltf
+{
+
 void Primitive::VertexBindData::add(
 	const vk::Buffer buffer,
 	const vk::DeviceSize offset,
@@ -85,83 +202,871 @@ void Primitive::VertexBindData::add(
 	strides.emplace_back(stride);
 }
 
-void Mesh::Draw(const DrawInfo& info) const
+void DrawList::add(const glm::mat4& modelMatrix, const uint32_t primitiveIndex, const Primitive& primitive)
 {
-	const auto primitiveDrawInfo = Primitive::DrawInfo{
-		.commandBuffer = info.commandBuffer,
-		.surfaceExtent = info.surfaceExtent,
-		.pipelineLayout = info.pipelineLayout,
-	};
+	modelMatrices.push_back(modelMatrix);
+	bounds.push_back(primitive.bounds);
+	frontFaces.push_back(glm::determinant(modelMatrix) > 0.0f ? vk::FrontFace::eCounterClockwise : vk::FrontFace::eClockwise);
+	pipelines.push_back(primitive.pipeline);
+	topologies.push_back(primitive.topology);
+	vertexBindings.push_back(primitiveIndex);
+	indexData.push_back(primitive.indexedData.value_or(Primitive::IndexedData{}));
+	counts.push_back(primitive.count);
+	materialIndices.push_back(primitive.materialIndex);
 
-	std::ranges::for_each(primitives, [&](const Primitive& primitive) { primitive.Draw(primitiveDrawInfo); });
+	const auto pipelineId = pipelineIds.try_emplace(primitive.pipeline, static_cast<uint32_t>(pipelineIds.size())).first->second;
+
+	// primitives rarely share all their bindings, the primitive stands in for its vertex buffers
+	sortKeys.push_back(makeSortKey(pipelineId, primitive.materialIndex, primitiveIndex));
 }
 
-void Node::Draw(const DrawInfo& info) const
+void DrawList::build(
+	const std::span<const Primitive> primitives,
+	std::vector<DrawRecord>& records,
+	std::vector<BatchRecord>& batchRecords,
+	std::vector<std::byte>& indirectCommands,
+	ClusterData& clusterData)
 {
-	if (this->mesh)
+	static_assert(sizeof(DrawRecord) % 16 == 0, "must match the storage buffer's array stride");
+	static_assert(sizeof(Meshlet) % 16 == 0, "must match the storage buffer's array stride");
+
+	assert(batches.empty());
+
+	firstRecord = static_cast<uint32_t>(records.size());
+	firstBatch = static_cast<uint32_t>(batchRecords.size());
+
+	// in sort key order, so batches come out grouped by pipeline and the draws of a primitive are adjacent
 	{
-		const auto mvp = info.viewProj * modelMatix;
+		auto order = std::views::iota(uint32_t(0), static_cast<uint32_t>(size())) | std::ranges::to<std::vector>();
 
-		const auto pushConstantsInfo = vk::PushConstantsInfo{
-			.layout = info.pipelineLayout,
-			.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
-			.offset = offsetof(PushConstants, mvp),
-			.size = sizeof(PushConstants::mvp),
-			.pValues = &mvp,
-		};
+		std::ranges::stable_sort(order, {}, [&](const uint32_t index) {
+			return std::tuple(sortKeys[index], vertexBindings[index], frontFaces[index]);
+		});
+
+		permute(modelMatrices, order);
+		permute(bounds, order);
+		permute(frontFaces, order);
+		permute(pipelines, order);
+		permute(topologies, order);
+		permute(vertexBindings, order);
+		permute(indexData, order);
+		permute(counts, order);
+		permute(materialIndices, order);
+		permute(sortKeys, order);
+	}
 
-		info.commandBuffer.pushConstants2(pushConstantsInfo);
+	instanceGroups.resize(size());
+
+	for (auto index = size_t(0); index < size(); ++index)
+	{
+		const auto instancesPrevious = index > 0
+			&& sortKeys[index] == sortKeys[index - 1]
+			&& vertexBindings[index] == vertexBindings[index - 1]
+			&& frontFaces[index] == frontFaces[index - 1];
+
+		instanceGroups[index] = instancesPrevious ? instanceGroups[index - 1] : static_cast<uint32_t>(index);
+	}
+
+	bvh = [&] {
+		const auto worldBounds = std::views::zip_transform(getWorldBounds, modelMatrices, bounds)
+			| std::ranges::to<std::vector>();
+
+		return Bvh(worldBounds);
+	}();
+
+	// first index or vertex and vertex offset of each draw, relative to its batch's bindings
+	struct Placement
+	{
+		uint32_t batch;
+		uint32_t first;
+		int32_t vertexOffset;
+	};
+	auto placements = std::vector<Placement>(size());
 
-		const auto& mesh = this->mesh->get();
+	// batches with room left, by everything but the binding offsets
+	auto openBatches = std::unordered_map<size_t, std::vector<uint32_t>>();
+	auto drawCounts = std::vector<uint32_t>();
 
-		const auto meshDrawInfo = Mesh::DrawInfo{
-			.commandBuffer = info.commandBuffer,
-			.surfaceExtent = info.surfaceExtent,
-			.pipelineLayout = info.pipelineLayout,
+	for (auto index = uint32_t(0); index < size(); ++index)
+	{
+		const auto& vertexBindData = primitives[vertexBindings[index]].vertexBindData;
+		const auto& indexed = indexData[index];
+
+		const auto batchKey = [&] {
+			auto seed = size_t(0);
+			boost::hash_combine(seed, static_cast<VkPipeline>(pipelines[index]));
+			boost::hash_combine(seed, topologies[index]);
+			boost::hash_combine(seed, frontFaces[index]);
+			boost::hash_combine(seed, static_cast<VkBuffer>(indexed.buffer));
+
+			for (const auto buffer : vertexBindData.buffers)
+			{
+				boost::hash_combine(seed, static_cast<VkBuffer>(buffer));
+			}
+
+			return seed;
+		}();
+
+		auto& candidates = openBatches[batchKey];
+
+		const auto placement = [&] -> std::optional<Placement> {
+			for (const auto batchIndex : candidates)
+			{
+				const auto& batch = batches[batchIndex];
+
+				if (batch.pipeline != pipelines[index] || batch.topology != topologies[index] || batch.frontFace != frontFaces[index])
+				{
+					continue;
+				}
+
+				const auto vertexOffset = getVertexOffset(batch.vertexBindData, vertexBindData);
+
+				if (not vertexOffset)
+				{
+					continue;
+				}
+
+				if (not indexed.buffer && not batch.indexData.buffer)
+				{
+					// non-indexed draws start at their first vertex instead
+					return Placement{ .batch = batchIndex, .first = static_cast<uint32_t>(*vertexOffset), .vertexOffset = 0 };
+				}
+
+				const auto firstIndex = indexed.buffer && batch.indexData.buffer ?
+					getFirstIndex(batch.indexData, indexed) :
+					std::nullopt;
+
+				if (firstIndex)
+				{
+					return Placement{ .batch = batchIndex, .first = *firstIndex, .vertexOffset = *vertexOffset };
+				}
+			}
+
+			return std::nullopt;
+		}();
+
+		if (placement)
+		{
+			placements[index] = *placement;
+		}
+		else
+		{
+			auto batchVertexBindData = vertexBindData;
+			std::ranges::fill(batchVertexBindData.sizes, vk::WholeSize);
+
+			auto batchIndexData = indexed;
+			batchIndexData.size = vk::WholeSize;
+
+			const auto batchIndex = static_cast<uint32_t>(batches.size());
+
+			batches.push_back({
+				.pipeline = pipelines[index],
+				.topology = topologies[index],
+				.frontFace = frontFaces[index],
+				.vertexBindData = std::move(batchVertexBindData),
+				.indexData = batchIndexData,
+			});
+
+			drawCounts.push_back(0);
+			candidates.push_back(batchIndex);
+
+			placements[index] = { .batch = batchIndex, .first = 0, .vertexOffset = 0 };
+		}
+
+		const auto batchIndex = placements[index].batch;
+
+		if (++drawCounts[batchIndex] == MAX_BATCH_DRAW_COUNT)
+		{
+			std::erase(candidates, batchIndex);
+		}
+	}
+
+	for (auto index = size_t(0); index < size(); ++index)
+	{
+		const auto& placement = placements[index];
+
+		records.push_back({
+			.modelMatrix = modelMatrices[index],
+			.boundsMin = bounds[index].min,
+			.materialIndex = materialIndices[index],
+			.boundsMax = bounds[index].max,
+			.batch = firstBatch + placement.batch,
+			.count = counts[index],
+			.first = placement.first,
+			.vertexOffset = placement.vertexOffset,
+			.firstLod = primitives[vertexBindings[index]].firstLod,
+			.lodCount = primitives[vertexBindings[index]].lodCount,
+		});
+	}
+
+	// commands of a batch are contiguous, in the order of its draws
+	auto batchDraws = std::vector<std::vector<uint32_t>>(batches.size());
+
+	firstClusterRecord = static_cast<uint32_t>(clusterData.records.size());
+
+	for (auto index = uint32_t(0); index < size(); ++index)
+	{
+		batchDraws[placements[index].batch].push_back(index);
+	}
+
+	for (auto&& [batch, draws] : std::views::zip(batches, batchDraws))
+	{
+		const auto commandSize = batch.indexData.buffer ? sizeof(vk::DrawIndexedIndirectCommand) : sizeof(vk::DrawIndirectCommand);
+
+		batch.commandOffset = indirectCommands.size();
+		batch.drawCount = 0;
+		batch.recordCount = static_cast<uint32_t>(draws.size());
+
+		batchRecords.push_back({
+			.commandOffset = static_cast<uint32_t>(batch.commandOffset / sizeof(uint32_t)),
+			.indexed = batch.indexData.buffer ? 1u : 0u,
+		});
+
+		// a command per run of adjacent draws in the same instance group
+		for (auto position = size_t(0); position < draws.size();)
+		{
+			const auto index = draws[position];
+			const auto instanceCount = getInstanceCount(std::span(draws).subspan(position));
+			const auto& placement = placements[index];
+			const auto recordIndex = firstRecord + index;
+
+			if (batch.indexData.buffer)
+			{
+				appendBytes(indirectCommands, vk::DrawIndexedIndirectCommand{
+					.indexCount = counts[index],
+					.instanceCount = instanceCount,
+					.firstIndex = placement.first,
+					.vertexOffset = placement.vertexOffset,
+					.firstInstance = recordIndex,
+				});
+			}
+			else
+			{
+				appendBytes(indirectCommands, vk::DrawIndirectCommand{
+					.vertexCount = counts[index],
+					.instanceCount = instanceCount,
+					.firstVertex = placement.first,
+					.firstInstance = recordIndex,
+				});
+			}
+
+			position += instanceCount;
+			++batch.drawCount;
+		}
+
+		// the rest of the range is only written by the culling passes
+		indirectCommands.resize(batch.commandOffset + draws.size() * commandSize);
+
+		const auto hasMeshlets = [&](const uint32_t index) {
+			return primitives[vertexBindings[index]].meshletCount > 0;
 		};
 
-		mesh.Draw(meshDrawInfo);
+		// meshlets hold every triangle, so the compacted range of a draw never outgrows its index count
+		const auto batchIndexCount = std::ranges::fold_left(
+			draws | std::views::transform([&](const uint32_t index) { return uint64_t(counts[index]); }),
+			uint64_t(0),
+			std::plus());
+
+		batch.clustered = batch.indexData.buffer
+			&& std::ranges::all_of(draws, hasMeshlets)
+			&& clusterData.indexCount + batchIndexCount <= clusterData.maxIndexCount;
+
+		if (not batch.clustered)
+		{
+			continue;
+		}
+
+		clusterData.commands.resize(indirectCommands.size());
+
+		// a command per draw, not instanced since each instance sees other meshlets
+		for (const auto& [slot, index] : std::views::enumerate(draws))
+		{
+			const auto& primitive = primitives[vertexBindings[index]];
+			const auto recordIndex = firstRecord + index;
+			const auto commandOffset = batch.commandOffset + slot * sizeof(vk::DrawIndexedIndirectCommand);
+
+			const auto command = vk::DrawIndexedIndirectCommand{
+				.indexCount = 0,
+				.instanceCount = 1,
+				.firstIndex = static_cast<uint32_t>(clusterData.indexCount),
+				.vertexOffset = placements[index].vertexOffset,
+				.firstInstance = recordIndex,
+			};
+
+			std::memcpy(clusterData.commands.data() + commandOffset, &command, sizeof(command));
+
+			for (auto meshlet = primitive.firstMeshlet; meshlet < primitive.firstMeshlet + primitive.meshletCount; ++meshlet)
+			{
+				clusterData.records.push_back({
+					.drawRecord = recordIndex,
+					.meshlet = meshlet,
+					.command = static_cast<uint32_t>(commandOffset / sizeof(uint32_t)),
+				});
+			}
+
+			clusterData.indexCount += counts[index];
+		}
 	}
 
-	std::ranges::for_each(children, [&](const Node& child) { child.Draw(info); });
+	clusterRecordCount = static_cast<uint32_t>(clusterData.records.size()) - firstClusterRecord;
 }
 
-void Scene::Draw(const DrawInfo& info) const
+uint32_t DrawList::getInstanceCount(const std::span<const uint32_t> draws) const
 {
-	const auto nodeDrawInfo = Node::DrawInfo{
-		.viewProj = info.viewProj,
-		.commandBuffer = info.commandBuffer,
-		.surfaceExtent = info.surfaceExtent,
-		.pipelineLayout = info.pipelineLayout,
+	assert(not draws.empty());
+
+	const auto first = draws.front();
+	auto count = uint32_t(1);
+
+	while (count < draws.size() && draws[count] == first + count && instanceGroups[first + count] == instanceGroups[first])
+	{
+		++count;
+	}
+
+	return count;
+}
+
+// TODO: handle no POSITION case 
+void DrawList::record(const RecordInfo& info) const
+{
+	auto& draws = sortScratch.draws;
+	const auto direct = info.drawMode == DrawMode::eDirect || info.drawMode == DrawMode::eCpuCulled;
+
+	switch (info.drawMode)
+	{
+	case DrawMode::eDirect:
+		draws.resize(size());
+		std::iota(draws.begin(), draws.end(), 0u);
+		sortDraws(info, draws);
+		break;
+	case DrawMode::eCpuCulled:
+		draws.clear();
+		bvh.cullFrustum(getFrustumPlanes(info.viewProj), draws);
+
+		// back in draw order, so visible instances are adjacent again
+		std::ranges::sort(draws);
+
+		if (info.cpuCullStats)
+		{
+			*info.cpuCullStats = CullStats{
+				.draws = static_cast<uint32_t>(size()),
+				.visibleDraws = static_cast<uint32_t>(draws.size()),
+			};
+		}
+
+		sortDraws(info, draws);
+		break;
+	case DrawMode::eIndirect:
+	case DrawMode::eCulled:
+	case DrawMode::eOcclusionCulled:
+	case DrawMode::eClusterCulled:
+		break;
+	}
+
+	// recorded in order, each is a draw call or a multi-draw
+	const auto unitCount = direct ? sortScratch.runs.size() : batches.size();
+
+	const auto recordUnits = [&](CommandRecorder& recorder, const size_t first, const size_t last) {
+		bindState(info, recorder);
+
+		if (direct)
+		{
+			recordRuns(info, recorder, first, last);
+		}
+		else
+		{
+			recordBatches(info, recorder, first, last);
+		}
 	};
 
-	std::ranges::for_each(nodes, [&](const Node& node) { node.Draw(nodeDrawInfo); });
+	if (not info.parallel)
+	{
+		recordUnits(info.recorder, 0, unitCount);
+		return;
+	}
+
+	const auto& parallel = *info.parallel;
+
+	// contiguous chunks keep the sorted order, short lists aren't worth the handoff but still
+	// need a secondary buffer since the rendering scope takes no inline commands
+	const auto chunkCount = std::clamp<size_t>(unitCount / MIN_CHUNK_SIZE, 1, parallel.commandPools.getSlotCount());
+
+	auto commandBuffers = std::vector<vk::CommandBuffer>(chunkCount);
+	auto chunkStats = std::vector<CommandRecorder::Stats>(chunkCount);
+
+	const auto inheritanceInfo = vk::CommandBufferInheritanceInfo{ .pNext = &parallel.inheritanceRenderingInfo };
+
+	parallel.threadPool.parallelFor(chunkCount, [&](const size_t chunk) {
+		const auto& commandBuffer = parallel.commandPools.allocate(info.frameIndex, static_cast<uint32_t>(chunk));
+
+		commandBuffer.begin({
+			.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+			.pInheritanceInfo = &inheritanceInfo,
+		});
+
+		auto recorder = CommandRecorder(commandBuffer);
+		recordUnits(recorder, chunk * unitCount / chunkCount, (chunk + 1) * unitCount / chunkCount);
+
+		commandBuffer.end();
+
+		commandBuffers[chunk] = *commandBuffer;
+		chunkStats[chunk] = recorder.getStats();
+	});
+
+	const auto stats = std::ranges::fold_left(chunkStats, CommandRecorder::Stats{}, [](CommandRecorder::Stats sum, const CommandRecorder::Stats& stats) {
+		sum.issued += stats.issued;
+		sum.skipped += stats.skipped;
+		return sum;
+	});
+
+	info.recorder.executeCommands(commandBuffers, stats);
 }
 
-void Model::Draw(const DrawInfo& info) const
+void DrawList::bindState(const RecordInfo& info, CommandRecorder& recorder) const
 {
+	constexpr auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+
 	const auto bindDescriptorSetsInfo = vk::BindDescriptorSetsInfo{
-		.stageFlags = vk::ShaderStageFlagBits::eFragment,
-		.layout = data.pipelineLayout,
-	}.setDescriptorSets(data.descriptorSets);
+		.stageFlags = stages,
+		.layout = info.pipelineLayout,
+	}.setDescriptorSets(info.descriptorSets);
+
+	recorder.getCommandBuffer().bindDescriptorSets2(bindDescriptorSetsInfo);
+
+	recorder.pushConstants(
+		info.pipelineLayout,
+		stages,
+		offsetof(PushConstants, viewProj),
+		std::as_bytes(std::span(&info.viewProj, 1))
+	);
+
+	const auto& surfaceExtent = info.surfaceExtent;
+
+	// https://www.saschawillems.de/blog/2019/03/29/flipping-the-vulkan-viewport/
+	const auto viewport = vk::Viewport{
+		.y = float(surfaceExtent.height),
+		.width = float(surfaceExtent.width),
+		.height = -float(surfaceExtent.height),
+		.maxDepth = 1,
+	};
+
+	recorder.setViewport(viewport);
+	recorder.setScissor(vk::Rect2D{ .extent = surfaceExtent });
+}
+
+void DrawList::sortDraws(const RecordInfo& info, const std::span<const uint32_t> draws) const
+{
+	// all draws are opaque, sorted front to back within a state bucket for early depth rejection
+	auto& keys = sortScratch.keys;
+	auto& keysScratch = sortScratch.keysScratch;
+	auto& order = sortScratch.order;
+	auto& orderScratch = sortScratch.orderScratch;
+	auto& runs = sortScratch.runs;
+
+	keys.resize(draws.size());
+	keysScratch.resize(draws.size());
+	order.resize(draws.size());
+	orderScratch.resize(draws.size());
+
+	for (const auto& [position, index] : std::views::enumerate(draws))
+	{
+		// w in clip space is the view depth. Instances share the depth of the first, so the
+		// stable sort keeps them adjacent and in order
+		const auto depth = (info.viewProj * modelMatrices[instanceGroups[index]][3]).w;
+
+		keys[position] = sortKeys[index] | getDepthKey(depth);
+		order[position] = index;
+	}
+
+	radixSort(keys, order, keysScratch, orderScratch);
+
+	runs.clear();
+
+	for (auto position = size_t(0); position < order.size(); position += getInstanceCount(std::span(order).subspan(position)))
+	{
+		runs.push_back(static_cast<uint32_t>(position));
+	}
+}
+
+void DrawList::recordRuns(const RecordInfo& info, CommandRecorder& recorder, const size_t first, const size_t last) const
+{
+	const auto& order = sortScratch.order;
+	const auto& runs = sortScratch.runs;
+
+	for (auto run = first; run < last; ++run)
+	{
+		const auto position = runs[run];
+		const auto end = run + 1 < runs.size() ? runs[run + 1] : order.size();
+		const auto index = order[position];
+		const auto instanceCount = static_cast<uint32_t>(end - position);
+
+		// the vertex shader fetches the draw record through the instance index
+		const auto recordIndex = firstRecord + index;
+		const auto& primitive = info.primitives[vertexBindings[index]];
+
+		// instances share the level of the first, like its depth
+		const auto& lod = selectLod(
+			info.lods.subspan(primitive.firstLod, primitive.lodCount),
+			modelMatrices[index],
+			bounds[index],
+			info.lodSelection
+		);
+
+		recorder.bindPipeline(pipelines[index]);
+
+		// dynamic states
+		recorder.setPrimitiveTopology(topologies[index]);
+		recorder.setFrontFace(frontFaces[index]);
 
-	info.commandBuffer.bindDescriptorSets2(bindDescriptorSetsInfo);
+		const auto& vertexBindData = primitive.vertexBindData;
+
+		recorder.bindVertexBuffers(
+			vertexBindData.buffers,
+			vertexBindData.offsets,
+			vertexBindData.sizes,
+			vertexBindData.strides
+		);
+
+		if (const auto& indexed = indexData[index]; indexed.buffer)
+		{
+			recorder.bindIndexBuffer(
+				indexed.buffer,
+				indexed.offset,
+				indexed.size,
+				indexed.type
+			);
+
+			recorder.drawIndexed(lod.indexCount, instanceCount, lod.firstIndex, 0, recordIndex);
+		}
+		else
+		{
+			recorder.draw(lod.indexCount, instanceCount, lod.firstIndex, recordIndex);
+		}
+	}
+}
 
+void DrawList::recordBatches(const RecordInfo& info, CommandRecorder& recorder, const size_t first, const size_t last) const
+{
+	const auto culled = info.drawMode == DrawMode::eCulled || info.drawMode == DrawMode::eOcclusionCulled;
+
+	for (auto batchIndex = first; batchIndex < last; ++batchIndex)
+	{
+		const auto& batch = batches[batchIndex];
+
+		// culled batches keep their range, the pass writes how much of it is used
+		const auto countOffset = (firstBatch + static_cast<uint32_t>(batchIndex)) * sizeof(uint32_t);
+
+		recorder.bindPipeline(batch.pipeline);
+		recorder.setPrimitiveTopology(batch.topology);
+		recorder.setFrontFace(batch.frontFace);
+
+		recorder.bindVertexBuffers(
+			batch.vertexBindData.buffers,
+			batch.vertexBindData.offsets,
+			batch.vertexBindData.sizes,
+			batch.vertexBindData.strides
+		);
+
+		// the culling pass' compacted indices stand in for the batch's
+		if (info.drawMode == DrawMode::eClusterCulled && batch.clustered)
+		{
+			constexpr auto stride = uint32_t(sizeof(vk::DrawIndexedIndirectCommand));
+
+			recorder.bindIndexBuffer(info.clusterIndices, 0, vk::WholeSize, vk::IndexType::eUint32);
+			recorder.drawIndexedIndirect(info.clusterCommands, batch.commandOffset, batch.recordCount, stride);
+		}
+		else if (const auto& indexed = batch.indexData; indexed.buffer)
+		{
+			recorder.bindIndexBuffer(
+				indexed.buffer,
+				indexed.offset,
+				indexed.size,
+				indexed.type
+			);
+
+			constexpr auto stride = uint32_t(sizeof(vk::DrawIndexedIndirectCommand));
+
+			if (culled)
+			{
+				recorder.drawIndexedIndirectCount(info.indirectCommands, batch.commandOffset, info.drawCounts, countOffset, batch.recordCount, stride);
+			}
+			else
+			{
+				recorder.drawIndexedIndirect(info.indirectCommands, batch.commandOffset, batch.drawCount, stride);
+			}
+		}
+		else
+		{
+			constexpr auto stride = uint32_t(sizeof(vk::DrawIndirectCommand));
+
+			if (culled)
+			{
+				recorder.drawIndirectCount(info.indirectCommands, batch.commandOffset, info.drawCounts, countOffset, batch.recordCount, stride);
+			}
+			else
+			{
+				recorder.drawIndirect(info.indirectCommands, batch.commandOffset, batch.drawCount, stride);
+			}
+		}
+	}
+}
+
+size_t DrawList::size() const
+{
+	return modelMatrices.size();
+}
+
+uint32_t DrawList::getFirstRecord() const
+{
+	return firstRecord;
+}
+
+uint32_t DrawList::getFirstClusterRecord() const
+{
+	return firstClusterRecord;
+}
+
+uint32_t DrawList::getClusterRecordCount() const
+{
+	return clusterRecordCount;
+}
+
+void Model::Draw(const DrawInfo& info) const
+{
 	const auto sceneIndex = info.sceneIndex;
-	const auto& scenes = data.scenes;
+	const auto& drawLists = data.drawLists;
+
+	assert(drawLists.size() > sceneIndex);
+
+	const auto culled = info.drawMode == DrawMode::eCulled || info.drawMode == DrawMode::eOcclusionCulled;
+	const auto clustered = info.drawMode == DrawMode::eClusterCulled;
 
-	assert(scenes.size() > sceneIndex);
+	assert(not (culled || clustered) || data.cullingFrames.size() > info.frameIndex);
 
-	const auto& scene = scenes[sceneIndex];
-	
-	const auto sceneDrawInfo = Scene::DrawInfo{
+	const auto recordInfo = DrawList::RecordInfo{
 		.viewProj = info.viewProj,
-		.commandBuffer = info.commandBuffer,
+		.recorder = info.recorder,
 		.surfaceExtent = info.surfaceExtent,
 		.pipelineLayout = data.pipelineLayout,
+		.descriptorSets = data.descriptorSets,
+		.primitives = data.primitives,
+		.lods = data.lods,
+		.lodSelection = getLodSelection(info.viewProj, info.surfaceExtent.height, info.lodPixelError),
+		.drawMode = info.drawMode,
+		.frameIndex = info.frameIndex,
+		.indirectCommands = culled ? *data.cullingFrames[info.frameIndex].commands.vmaBuffer : *data.indirectCommands.vmaBuffer,
+		.drawCounts = culled ? *data.cullingFrames[info.frameIndex].drawCounts.vmaBuffer : vk::Buffer(),
+		.clusterCommands = clustered ? *data.cullingFrames[info.frameIndex].clusterCommands.vmaBuffer : vk::Buffer(),
+		.clusterIndices = clustered ? *data.cullingFrames[info.frameIndex].clusterIndices.vmaBuffer : vk::Buffer(),
+		.cpuCullStats = info.cpuCullStats,
+		.parallel = info.parallel,
 	};
 
-	scene.Draw(sceneDrawInfo);
+	drawLists[sceneIndex].record(recordInfo);
+}
+
+void Model::cull(const CullInfo& info) const
+{
+	assert(data.drawLists.size() > info.sceneIndex);
+	assert(data.cullingFrames.size() > info.frameIndex);
+	assert((info.pass == CullPass::eLate) == (info.depthPyramid != nullptr));
+
+	const auto& drawList = data.drawLists[info.sceneIndex];
+	const auto& frame = data.cullingFrames[info.frameIndex];
+	const auto& commandBuffer = info.commandBuffer;
+	const auto late = info.pass == CullPass::eLate;
+
+	// the early pass' draws and last frame's visibility writes are done with
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader,
+			.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+
+	// every batch starts empty, the stats add up over the passes of a frame
+	commandBuffer.fillBuffer(*frame.drawCounts.vmaBuffer, 0, vk::WholeSize, 0);
+
+	if (not late)
+	{
+		commandBuffer.fillBuffer(*frame.stats.vmaBuffer, 0, vk::WholeSize, 0);
+	}
+
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eClear,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+
+	const auto recordCount = static_cast<uint32_t>(drawList.size());
+	const auto lodSelection = getLodSelection(info.viewProj, info.viewportHeight, info.lodPixelError);
+
+	if (late)
+	{
+		const auto pushConstants = OcclusionCullPushConstants{
+			.viewProj = info.viewProj,
+			.firstRecord = drawList.getFirstRecord(),
+			.recordCount = recordCount,
+			.lod = lodSelection,
+		};
+
+		const auto descriptorSets = { frame.descriptorSet, info.depthPyramid->getDescriptorSet() };
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, data.occlusionCullPipeline);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, data.occlusionCullPipelineLayout, 0, descriptorSets, {});
+		commandBuffer.pushConstants<OcclusionCullPushConstants>(data.occlusionCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+	}
+	else
+	{
+		const auto planes = getFrustumPlanes(info.viewProj);
+
+		auto pushConstants = CullPushConstants{
+			.firstRecord = drawList.getFirstRecord(),
+			.recordCount = recordCount,
+			.pass = std::to_underlying(info.pass),
+			.lod = lodSelection,
+		};
+		std::ranges::copy(planes, pushConstants.frustumPlanes);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, data.cullPipeline);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, data.cullPipelineLayout, 0, frame.descriptorSet, {});
+		commandBuffer.pushConstants<CullPushConstants>(data.cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+	}
+
+	// at least one group, it writes the stats
+	const auto groupCount = std::max<uint32_t>((recordCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1);
+	commandBuffer.dispatch(groupCount, 1, 1);
+
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eHost,
+			.dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eHostRead,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+}
+
+void Model::cullClusters(const CullInfo& info) const
+{
+	assert(data.drawLists.size() > info.sceneIndex);
+	assert(data.cullingFrames.size() > info.frameIndex);
+
+	const auto& drawList = data.drawLists[info.sceneIndex];
+	const auto& frame = data.cullingFrames[info.frameIndex];
+	const auto& commandBuffer = info.commandBuffer;
+
+	// earlier draws from the commands and indices are done with
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eIndexInput,
+			.dstStageMask = vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+
+	// every meshlet draw starts without indices
+	{
+		const auto region = vk::BufferCopy{ .size = data.clusterCommandsSize };
+		commandBuffer.copyBuffer(*data.clusterCommands.vmaBuffer, *frame.clusterCommands.vmaBuffer, region);
+	}
+
+	commandBuffer.fillBuffer(*frame.clusterStats.vmaBuffer, 0, vk::WholeSize, 0);
+
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eClear,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+
+	const auto clusterRecordCount = drawList.getClusterRecordCount();
+	const auto planes = getFrustumPlanes(info.viewProj);
+
+	auto pushConstants = ClusterCullPushConstants{
+		.cameraPosition = getCameraPosition(info.viewProj),
+		.firstClusterRecord = drawList.getFirstClusterRecord(),
+		.clusterRecordCount = clusterRecordCount,
+	};
+	std::ranges::copy(planes, pushConstants.frustumPlanes);
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, data.clusterCullPipeline);
+	commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, data.clusterCullPipelineLayout, 0, frame.clusterDescriptorSet, {});
+	commandBuffer.pushConstants<ClusterCullPushConstants>(data.clusterCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+
+	// at least one group, it writes the stats
+	const auto groupCount = std::max<uint32_t>((clusterRecordCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1);
+	commandBuffer.dispatch(groupCount, 1, 1);
+
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eIndexInput | vk::PipelineStageFlagBits2::eHost,
+			.dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eIndexRead | vk::AccessFlagBits2::eHostRead,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memoryBarrier));
+	}
+}
+
+ClusterCullStats Model::getClusterCullStats(const uint32_t frameIndex) const
+{
+	assert(data.cullingFrames.size() > frameIndex);
+
+	auto stats = ClusterCullStats{};
+
+	const auto result = data.cullingFrames[frameIndex].clusterStats.vmaBuffer.CopyAllocationToMemory(&stats, sizeof(stats));
+	assert(result == vk::Result::eSuccess);
+
+	return stats;
+}
+
+CullStats Model::getCullStats(const uint32_t frameIndex) const
+{
+	assert(data.cullingFrames.size() > frameIndex);
+
+	auto stats = CullStats{};
+
+	const auto result = data.cullingFrames[frameIndex].stats.vmaBuffer.CopyAllocationToMemory(&stats, sizeof(stats));
+	assert(result == vk::Result::eSuccess);
+
+	return stats;
+}
+
+void Model::acquireOwnership(const vk::raii::CommandBuffer& commandBuffer)
+{
+	auto& barriers = data.acquireBarriers;
+
+	if (barriers.buffers.empty() && barriers.images.empty())
+	{
+		return;
+	}
+
+	const auto dependencyInfo = vk::DependencyInfo{}
+		.setBufferMemoryBarriers(barriers.buffers)
+		.setImageMemoryBarriers(barriers.images);
+
+	commandBuffer.pipelineBarrier2(dependencyInfo);
+
+	barriers = {};
 }
 
 Model::~Model()
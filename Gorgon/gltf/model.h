@@ -1,5 +1,12 @@
 #pragma once
 #include "vk/vma.h"
+#include "vk/upload_batch.h"
+#include "vk/command_recorder.h"
+#include "vk/depth_pyramid.h"
+#include "vk/secondary_command_pools.h"
+#include "util/bvh.h"
+#include "util/thread_pool.h"
+#include <shaders/shared.inl>
 
 namespace gltf
 {
@@ -49,23 +56,10 @@ public:
 	VmaBuffer vmaBuffer;
 };
 
+// Geometry and pipeline of a glTF primitive, shared by every node instancing its mesh
 class Primitive
 {
 public:
-	struct DrawInfo
-	{
-		const vk::raii::CommandBuffer& commandBuffer;
-		const vk::Extent2D& surfaceExtent;
-		vk::FrontFace frontFace;
-		vk::PipelineLayout pipelineLayout;
-	};
-
-	using DrawFunc = void (Primitive::*)(const DrawInfo&) const;
-
-	void Draw(const DrawInfo& info) const;
-	void DrawIndexed(const DrawInfo& info) const;
-	void DrawNonIndexed(const DrawInfo& info) const;
-
 	struct VertexBindData
 	{
 		void add(
@@ -95,89 +89,278 @@ public:
 	std::optional<IndexedData> indexedData;
 
 	uint32_t materialIndex;
-	DrawFunc drawFunc;
+
+	// into the model's meshlets, meshletCount is 0 unless an indexed triangle list
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+
+	// into the model's levels of detail, the full mesh first, their indices follow each other from indexedData
+	uint32_t firstLod;
+	uint32_t lodCount;
+
+	// object space
+	struct Bounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	} bounds;
 };
 
-class Mesh
+enum class DrawMode
 {
-public:
-	struct DrawInfo
-	{
-		const vk::raii::CommandBuffer& commandBuffer;
-		const vk::Extent2D& surfaceExtent;
-		vk::PipelineLayout pipelineLayout;
-	};
+	eDirect, // a draw call per primitive, sorted on the CPU every frame
+	eIndirect, // a multi-draw indirect call per batch, built at load
+	eCulled, // eIndirect with the draws outside the frustum removed by Model::cull
+	eCpuCulled, // eDirect with the draws outside the frustum skipped, for devices without GPU culling
+	eOcclusionCulled, // eCulled drawn twice, the second time with the draws the first pass' depth revealed
+	eClusterCulled, // eIndirect with the meshlets of indexed triangle lists culled by Model::cullClusters
+};
 
-	void Draw(const DrawInfo& drawInfo) const;
+// culling passes of Model::cull, see the CULL_PASS_ constants
+enum class CullPass : uint32_t
+{
+	eFrustum = CULL_PASS_FRUSTUM, // for DrawMode::eCulled
+	eEarly = CULL_PASS_EARLY, // for DrawMode::eOcclusionCulled, before the first pass
+	eLate = CULL_PASS_LATE, // for DrawMode::eOcclusionCulled, after the first pass and the depth pyramid build
+};
 
-	std::vector<Primitive> primitives;
+// Spreads recording over threads, each recording a chunk of the draws into a secondary command
+// buffer. The recorder's command buffer executes them, in a rendering scope begun with
+// VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT.
+struct ParallelRecordInfo
+{
+	ThreadPool& threadPool;
+	SecondaryCommandPools& commandPools; // a slot per chunk, at most getSlotCount chunks
+	const vk::CommandBufferInheritanceRenderingInfo& inheritanceRenderingInfo; // of the rendering scope
 };
 
-class Node
+// A scene flattened at load time, with one entry per drawn primitive. Stored as a
+// structure of arrays so recording a frame is a linear walk without pointer chasing.
+// Direct draws are recorded sorted by pipeline, material, vertex buffers and then front to back.
+// Draws of the same primitive are kept adjacent and drawn as instances of one call where
+// they stay adjacent, each instance reading its own draw record. Direct draws pick their level
+// of detail while recording, so parallel recording spreads the selection over the threads too.
+class DrawList
 {
 public:
-	struct DrawInfo
+	struct RecordInfo
 	{
 		const glm::mat4& viewProj;
-		const vk::raii::CommandBuffer& commandBuffer;
+		CommandRecorder& recorder;
 		const vk::Extent2D& surfaceExtent;
 		vk::PipelineLayout pipelineLayout;
+		std::span<const vk::DescriptorSet> descriptorSets;
+		std::span<const Primitive> primitives;
+		std::span<const Lod> lods; // of every primitive
+		LodSelection lodSelection; // for eDirect and eCpuCulled, the culling passes pick the others' levels
+		DrawMode drawMode;
+		uint32_t frameIndex;
+		vk::Buffer indirectCommands;
+		vk::Buffer drawCounts; // eCulled and eOcclusionCulled only, one per batch
+		vk::Buffer clusterCommands; // eClusterCulled only, for the batches of meshlet draws
+		vk::Buffer clusterIndices; // eClusterCulled only, 32 bit
+		CullStats* cpuCullStats; // optional, filled in by eCpuCulled
+		const ParallelRecordInfo* parallel; // optional, records on the calling thread if null
 	};
 
-	void Draw(const DrawInfo& drawInfo) const;
-	glm::mat4 modelMatix;
-	//glm::mat4 normalMatrix;
-	OptionalRef<Mesh> mesh;
-	vk::FrontFace frontFace;
-	
-	std::vector<Node> children;
-};
-
-class Scene
-{
-public:
-	struct DrawInfo
+	// What the cluster culling pass reads and starts from, of every scene. Each meshlet draw gets a
+	// DrawIndexedIndirectCommand into the compacted index buffer with room for all its indices,
+	// which the pass grows by the indices of each visible meshlet.
+	struct ClusterData
 	{
-		const glm::mat4& viewProj;
-		const vk::raii::CommandBuffer& commandBuffer;
-		const vk::Extent2D& surfaceExtent;
-		vk::PipelineLayout pipelineLayout;
+		std::vector<ClusterRecord> records;
+		std::vector<std::byte> commands; // laid out like the indirect commands, only batches of meshlet draws are filled
+		uint64_t indexCount = 0; // of the compacted index buffer
+		uint64_t maxIndexCount = 0; // batches that don't fit take the plain indirect path, 0 disables clustering
 	};
 
-	std::vector<Node> nodes;
+	void add(const glm::mat4& modelMatrix, const uint32_t primitiveIndex, const Primitive& primitive);
+
+	// Called once after the last add, reorders the draws. Appends a record per draw, then groups
+	// the draws into batches and appends their records and indirect commands, DrawIndexedIndirectCommand
+	// or DrawIndirectCommand. Each batch has room for a command per draw for the culling passes.
+	// Batches whose draws all have meshlets get their cluster records and commands.
+	void build(
+		const std::span<const Primitive> primitives,
+		std::vector<DrawRecord>& records,
+		std::vector<BatchRecord>& batchRecords,
+		std::vector<std::byte>& indirectCommands,
+		ClusterData& clusterData);
+
+	void record(const RecordInfo& info) const;
+
+	size_t size() const;
+	uint32_t getFirstRecord() const;
+	uint32_t getFirstClusterRecord() const;
+	uint32_t getClusterRecordCount() const;
+
 private:
-	void Draw(const DrawInfo& drawInfo) const;
+	// descriptor sets, push constants and viewport, everything a recorder starts each chunk with
+	void bindState(const RecordInfo& info, CommandRecorder& recorder) const;
+
+	// fills in the order and runs of the sort scratch
+	void sortDraws(const RecordInfo& info, const std::span<const uint32_t> draws) const;
+
+	// [first, last) of the sorted runs, or of the batches
+	void recordRuns(const RecordInfo& info, CommandRecorder& recorder, const size_t first, const size_t last) const;
+	void recordBatches(const RecordInfo& info, CommandRecorder& recorder, const size_t first, const size_t last) const;
+
+	// of the draws at the front that are consecutive instances of the same group
+	uint32_t getInstanceCount(const std::span<const uint32_t> draws) const;
+
+	std::vector<glm::mat4> modelMatrices;
+	std::vector<Primitive::Bounds> bounds;
+	std::vector<vk::FrontFace> frontFaces;
+	std::vector<vk::Pipeline> pipelines;
+	std::vector<vk::PrimitiveTopology> topologies;
+	std::vector<uint32_t> vertexBindings; // index of the primitive holding them
+	std::vector<Primitive::IndexedData> indexData; // null buffer for non-indexed draws
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> materialIndices;
+
+	// first draw of the run of draws sharing sort key, primitive and winding, instanced together
+	std::vector<uint32_t> instanceGroups;
+
+	// everything but the depth, which is filled in every frame
+	std::vector<uint64_t> sortKeys;
+	std::unordered_map<vk::Pipeline, uint32_t> pipelineIds;
+
+	// reused every frame
+	struct SortScratch
+	{
+		std::vector<uint64_t> keys;
+		std::vector<uint64_t> keysScratch;
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> orderScratch;
+		std::vector<uint32_t> draws; // to record
+		std::vector<uint32_t> runs; // first position in order of each instanced call
+	};
+	mutable SortScratch sortScratch;
+
+	// over the world space bounds of the draws
+	Bvh bvh;
+
+	// index of the first draw in the model's draw records, and of the first batch in its batch records
+	uint32_t firstRecord = 0;
+	uint32_t firstBatch = 0;
+	uint32_t firstClusterRecord = 0;
+	uint32_t clusterRecordCount = 0;
 
-	friend class Model;
+	// Draws sharing pipeline, dynamic state and bindings. The bindings are those of the
+	// first draw, the others are drawn at their vertex and index offsets relative to it.
+	struct IndirectBatch
+	{
+		vk::Pipeline pipeline;
+		vk::PrimitiveTopology topology;
+		vk::FrontFace frontFace;
+		Primitive::VertexBindData vertexBindData;
+		Primitive::IndexedData indexData; // null buffer for non-indexed draws
+		vk::DeviceSize commandOffset; // into the model's indirect commands
+		uint32_t drawCount; // instanced commands
+		uint32_t recordCount; // draws, the most commands a culling pass emits
+		bool clustered; // every draw has meshlets, drawn from the cluster commands by eClusterCulled
+	};
+	std::vector<IndirectBatch> batches;
 };
 
 class Model
 {
 public:
+	Model(Model&&) noexcept = default;
 	~Model();
 
 	struct DrawInfo
 	{
 		size_t sceneIndex;
 		const glm::mat4& viewProj;
-		const vk::raii::CommandBuffer& commandBuffer;
+		CommandRecorder& recorder;
 		vk::Extent2D surfaceExtent;
+		DrawMode drawMode = DrawMode::eIndirect;
+		uint32_t frameIndex = 0; // frame in flight, selects the culling output and secondary command pools
+		CullStats* cpuCullStats = nullptr; // filled in by DrawMode::eCpuCulled
+		const ParallelRecordInfo* parallel = nullptr; // records on the calling thread if null
+		float lodPixelError = 0.0f; // largest on screen error of a level of detail, 0 only allows levels without error
 	};
 
 	void Draw(const DrawInfo& drawInfo) const;
 
+	struct CullInfo
+	{
+		size_t sceneIndex;
+		const glm::mat4& viewProj;
+		const vk::raii::CommandBuffer& commandBuffer;
+		uint32_t frameIndex;
+		CullPass pass = CullPass::eFrustum;
+		const DepthPyramid* depthPyramid = nullptr; // eLate only, built from the first pass' depth
+		float lodPixelError = 0.0f; // see DrawInfo, for the draws cull emits
+		uint32_t viewportHeight = 0; // in pixels, for lodPixelError
+	};
+
+	// Records a culling pass for DrawMode::eCulled or eOcclusionCulled, outside of rendering.
+	// The draws it emits are recorded by the next Draw with the same frame index.
+	void cull(const CullInfo& info) const;
+
+	// of the last cull in the frame slot, valid once that frame has finished
+	CullStats getCullStats(const uint32_t frameIndex) const;
+
+	// Records the meshlet culling pass for DrawMode::eClusterCulled, outside of rendering. It
+	// writes the visible triangles of each meshlet draw into a compacted index buffer and
+	// the draw's command, for the next Draw with the same frame index. The pass is ignored.
+	void cullClusters(const CullInfo& info) const;
+
+	// of the last cullClusters in the frame slot, valid once that frame has finished
+	ClusterCullStats getClusterCullStats(const uint32_t frameIndex) const;
+
+	// Takes ownership of resources uploaded on another queue family. Records the
+	// acquire barriers the first time, outside of rendering and before any Draw.
+	void acquireOwnership(const vk::raii::CommandBuffer& commandBuffer);
+
 private:
 	struct Data
 	{
 		std::vector<Buffer> buffers;
-		std::vector<Mesh> meshes;
-		std::vector<Scene> scenes;
+		std::vector<Primitive> primitives;
+		std::vector<DrawList> drawLists; // one per scene
+		Buffer drawRecords; // of every scene
+		Buffer batchRecords; // of every scene
+		Buffer indirectCommands; // of every scene
+		std::vector<Lod> lods; // of every primitive
+		Buffer lodsSSBO;
+
+		// written by the culling pass, one per frame in flight
+		struct CullingFrame
+		{
+			Buffer commands; // laid out like indirectCommands, each batch compacted within its range
+			Buffer drawCounts; // one per batch
+			Buffer stats; // CullStats, host readable
+			vk::DescriptorSet descriptorSet;
+
+			Buffer clusterCommands; // starts as a copy of Data::clusterCommands
+			Buffer clusterIndices; // compacted, each meshlet draw has a range
+			Buffer clusterStats; // ClusterCullStats, host readable
+			vk::DescriptorSet clusterDescriptorSet;
+		};
+		std::vector<CullingFrame> cullingFrames;
+		Buffer visibility; // per draw record, carried between frames by the occlusion culling passes
+		vk::Pipeline cullPipeline;
+		vk::PipelineLayout cullPipelineLayout;
+		vk::Pipeline occlusionCullPipeline;
+		vk::PipelineLayout occlusionCullPipelineLayout;
+		Buffer meshlets; // of every primitive
+		Buffer meshletVertices;
+		Buffer meshletTriangles;
+		Buffer clusterRecords; // of every scene
+		Buffer clusterCommands; // of every scene, before any meshlet is visible
+		vk::DeviceSize clusterCommandsSize; // the allocation may be larger
+		vk::Pipeline clusterCullPipeline;
+		vk::PipelineLayout clusterCullPipelineLayout;
 		//std::vector<Material> materials;
 		Buffer materialsSSBO;
 		std::vector<ImageData> imageData;
 		vk::PipelineLayout pipelineLayout;
 		std::vector<vk::raii::DescriptorSet> descriptorSetsRAII;
 		std::vector<vk::DescriptorSet> descriptorSets;
+		UploadBatch::AcquireBarriers acquireBarriers;
 		//vk::DescriptorPool descriptorPool;
 		const vk::raii::Device& device;
 	};
@@ -0,0 +1,574 @@
+#include "model_cache.h"
+#include "util/hash.h"
+#include "util/mapped_file.h"
+
+namespace
+{
+
+constexpr auto MODEL_CACHE_MAGIC = 0x434D4F47u; // "GOMC"
+constexpr auto MODEL_CACHE_VERSION = 9u; // bump whenever Asset or the layout below changes
+constexpr auto MODEL_CACHE_ALIGNMENT = uint64_t(16);
+
+// bytes of the entry file
+struct Range
+{
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	Range sources; // SourceEntry[]
+	Range buffers; // Range[]
+	Range images; // ImageEntry[]
+	Range samplers; // Asset::Sampler[]
+	Range materials;
+	uint64_t materialCount;
+	Range primitives; // Asset::Primitive[]
+	Range meshes; // Asset::Mesh[]
+	Range nodes; // Asset::Node[]
+	Range instanceTransforms; // glm::mat4[]
+	Range scenes; // Asset::Scene[]
+	Range meshlets; // Meshlet[]
+	Range meshletVertices; // uint32_t[]
+	Range meshletTriangles; // uint32_t[]
+	Range lods; // Lod[]
+};
+
+struct SourceEntry
+{
+	Range path; // UTF-8, relative to the directory of the glTF/GLB file
+	uint64_t hash;
+};
+
+struct ImageEntry
+{
+	Range texels;
+	vk::Format format;
+	vk::Extent3D extent;
+};
+
+static_assert(std::is_trivially_copyable_v<gltf::Asset::Sampler>);
+static_assert(std::is_trivially_copyable_v<gltf::Asset::Primitive>);
+static_assert(std::is_trivially_copyable_v<gltf::Asset::Mesh>);
+static_assert(std::is_trivially_copyable_v<gltf::Asset::Node>);
+static_assert(std::is_trivially_copyable_v<gltf::Asset::Scene>);
+static_assert(std::is_trivially_copyable_v<Meshlet>);
+static_assert(std::is_trivially_copyable_v<Lod>);
+
+// nullopt if the file can't be read
+std::optional<uint64_t> hashFile(const std::filesystem::path& path)
+{
+	try
+	{
+		const auto file = MappedFile(path);
+		return hashBytes(file.data());
+	}
+	catch (const std::system_error&)
+	{
+		return std::nullopt;
+	}
+}
+
+// the range must lie within the entry and be aligned for T
+template<typename T>
+std::span<const T> getTable(const std::span<const std::byte> data, const Range range, bool& valid)
+{
+	const auto inBounds = range.offset <= data.size() && range.size <= data.size() - range.offset;
+	const auto aligned = range.offset % alignof(T) == 0 && range.size % sizeof(T) == 0;
+
+	if (not inBounds || not aligned)
+	{
+		valid = false;
+		return {};
+	}
+
+	return std::span(reinterpret_cast<const T*>(data.data() + range.offset), range.size / sizeof(T));
+}
+
+// true if index and range of the asset stay within the tables and buffers they point into,
+// an entry of the current version can still be truncated or written by a broken build
+bool isConsistent(const gltf::Asset& asset)
+{
+	const auto inRange = [](const uint64_t first, const uint64_t count, const uint64_t size) {
+		return first <= size && count <= size - first;
+	};
+
+	const auto isBufferRange = [&](const gltf::Asset::BufferRange& range) {
+		return range.buffer < asset.buffers.size() && inRange(range.offset, range.size, asset.buffers[range.buffer].size());
+	};
+
+	const auto getIndexSize = [](const vk::IndexType type) -> uint64_t {
+		switch (type)
+		{
+		case vk::IndexType::eUint8: return 1;
+		case vk::IndexType::eUint16: return 2;
+		case vk::IndexType::eUint32: return 4;
+		default: return 0;
+		}
+	};
+
+	// the formats GltfToVkFormat and getVec3Format produce lie in this range
+	const auto isVertexFormat = [](const vk::Format format) {
+		return format >= vk::Format::eR8G8Unorm && format <= vk::Format::eR32G32B32A32Sfloat;
+	};
+
+	const auto isOptionalVertexFormat = [&](const std::optional<vk::Format>& format) {
+		return not format || isVertexFormat(*format);
+	};
+
+	// every index of a range below vertexCount, indices are little endian like the GPU reads them
+	const auto indicesBelow = [&](const gltf::Asset::BufferRange& range, const uint64_t indexSize, const uint64_t vertexCount) {
+		const auto bytes = asset.buffers[range.buffer].subspan(range.offset, range.size);
+
+		for (auto offset = uint64_t(0); offset + indexSize <= bytes.size(); offset += indexSize)
+		{
+			auto index = uint32_t(0);
+			std::memcpy(&index, bytes.data() + offset, indexSize);
+
+			if (index >= vertexCount)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	if (asset.materialCount == 0 || asset.materials.size() % asset.materialCount != 0)
+	{
+		return false;
+	}
+
+	for (const auto& image : asset.images)
+	{
+		if (image.extent.width == 0 || image.extent.height == 0 || image.texels.size() != uint64_t(image.extent.width) * image.extent.height * 4)
+		{
+			return false;
+		}
+
+		if (image.format != vk::Format::eR8G8B8A8Unorm && image.format != vk::Format::eR8G8B8A8Srgb)
+		{
+			return false;
+		}
+	}
+
+	for (const auto& sampler : asset.samplers)
+	{
+		const auto isFilter = [](const vk::Filter filter) {
+			return filter == vk::Filter::eNearest || filter == vk::Filter::eLinear;
+		};
+
+		const auto isAddressMode = [](const vk::SamplerAddressMode mode) {
+			return mode == vk::SamplerAddressMode::eRepeat
+				|| mode == vk::SamplerAddressMode::eMirroredRepeat
+				|| mode == vk::SamplerAddressMode::eClampToEdge;
+		};
+
+		if (not isFilter(sampler.magFilter) || not isFilter(sampler.minFilter)
+			|| not isAddressMode(sampler.addressModeU) || not isAddressMode(sampler.addressModeV))
+		{
+			return false;
+		}
+	}
+
+	// meshlet triangles are three 8 bit indices into the meshlet's vertices
+	const auto trianglesInMeshlet = [&](const Meshlet& meshlet) {
+		return std::ranges::all_of(asset.meshletTriangles.subspan(meshlet.firstTriangle, meshlet.triangleCount), [&](const uint32_t packed) {
+			return std::ranges::all_of(std::array{ 0u, 8u, 16u }, [&](const uint32_t shift) {
+				return ((packed >> shift) & 0xFF) < meshlet.vertexCount;
+			});
+		});
+	};
+
+	for (const auto& primitive : asset.primitives)
+	{
+		if (primitive.vertexBufferCount == 0 || primitive.vertexBufferCount > VERTEX_INPUT_NUM)
+		{
+			return false;
+		}
+
+		const auto vertexBuffers = std::span(primitive.vertexBuffers).first(primitive.vertexBufferCount);
+
+		if (not std::ranges::all_of(vertexBuffers, isBufferRange) || primitive.materialIndex >= asset.materialCount)
+		{
+			return false;
+		}
+
+		const auto& pipelineInfo = primitive.pipelineInfo;
+
+		const auto validFormats = isVertexFormat(pipelineInfo.position)
+			&& isOptionalVertexFormat(pipelineInfo.normal)
+			&& isOptionalVertexFormat(pipelineInfo.tangent)
+			&& isOptionalVertexFormat(pipelineInfo.texcoord0)
+			&& isOptionalVertexFormat(pipelineInfo.texcoord1)
+			&& isOptionalVertexFormat(pipelineInfo.color0);
+
+		if (not validFormats || primitive.topology > vk::PrimitiveTopology::eTriangleFan)
+		{
+			return false;
+		}
+
+		// the bindings are repacked, each holds whole vertices
+		const auto vertexCount = std::ranges::min(vertexBuffers | std::views::transform([](const gltf::Asset::BufferRange& range) {
+			return range.stride == 0 ? uint64_t(0) : range.size / range.stride;
+		}));
+
+		// levels are drawn from the indices, or from the vertices without them
+		const auto elementCount = [&] -> std::optional<uint64_t> {
+			if (not primitive.indexed)
+			{
+				return primitive.count;
+			}
+
+			const auto indexSize = getIndexSize(primitive.indexType);
+
+			if (indexSize == 0 || not isBufferRange(primitive.indices))
+			{
+				return std::nullopt;
+			}
+
+			return primitive.indices.size / indexSize;
+		}();
+
+		if (not elementCount || primitive.count > *elementCount)
+		{
+			return false;
+		}
+
+		// covers every level, their indices are in the same range
+		const auto validIndices = primitive.indexed ?
+			indicesBelow(primitive.indices, getIndexSize(primitive.indexType), vertexCount) :
+			primitive.count <= vertexCount;
+
+		if (not validIndices)
+		{
+			return false;
+		}
+
+		if (primitive.lodCount == 0 || not inRange(primitive.firstLod, primitive.lodCount, asset.lods.size()))
+		{
+			return false;
+		}
+
+		for (const auto& lod : asset.lods.subspan(primitive.firstLod, primitive.lodCount))
+		{
+			if (not inRange(lod.firstIndex, lod.indexCount, *elementCount))
+			{
+				return false;
+			}
+		}
+
+		if (not inRange(primitive.firstMeshlet, primitive.meshletCount, asset.meshlets.size()))
+		{
+			return false;
+		}
+
+		for (const auto& meshlet : asset.meshlets.subspan(primitive.firstMeshlet, primitive.meshletCount))
+		{
+			// the loop over all meshlets below checks their triangles
+			if (not inRange(meshlet.firstVertex, meshlet.vertexCount, asset.meshletVertices.size()))
+			{
+				return false;
+			}
+
+			const auto vertices = asset.meshletVertices.subspan(meshlet.firstVertex, meshlet.vertexCount);
+
+			if (not std::ranges::all_of(vertices, [&](const uint32_t vertex) { return vertex < vertexCount; }))
+			{
+				return false;
+			}
+		}
+	}
+
+	for (const auto& meshlet : asset.meshlets)
+	{
+		if (not inRange(meshlet.firstVertex, meshlet.vertexCount, asset.meshletVertices.size())
+			|| not inRange(meshlet.firstTriangle, meshlet.triangleCount, asset.meshletTriangles.size())
+			|| not trianglesInMeshlet(meshlet))
+		{
+			return false;
+		}
+	}
+
+	for (const auto& mesh : asset.meshes)
+	{
+		if (not inRange(mesh.firstPrimitive, mesh.primitiveCount, asset.primitives.size()))
+		{
+			return false;
+		}
+	}
+
+	for (const auto& node : asset.nodes)
+	{
+		if ((node.mesh != -1 && (node.mesh < 0 || uint64_t(node.mesh) >= asset.meshes.size()))
+			|| not inRange(node.firstChild, node.childCount, asset.nodes.size())
+			|| not inRange(node.firstInstance, node.instanceCount, asset.instanceTransforms.size()))
+		{
+			return false;
+		}
+	}
+
+	for (const auto& scene : asset.scenes)
+	{
+		if (not inRange(scene.firstNode, scene.nodeCount, asset.nodes.size()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+namespace gltf
+{
+
+ModelCache::ModelCache(const std::filesystem::path& directory, const uint64_t salt)
+	: directory(directory)
+	, salt(salt)
+{}
+
+std::optional<Asset> ModelCache::load(const std::filesystem::path& source) const
+{
+	auto ec = std::error_code();
+
+	if (not std::filesystem::is_regular_file(source, ec))
+	{
+		return std::nullopt;
+	}
+
+	const auto sourceHash = hashFile(source);
+
+	if (not sourceHash)
+	{
+		return std::nullopt;
+	}
+
+	const auto key = getKey(*sourceHash);
+	const auto entryPath = getEntryPath(key);
+
+	if (not std::filesystem::is_regular_file(entryPath, ec))
+	{
+		return std::nullopt;
+	}
+
+	// an entry that can't be mapped is a miss, the next store replaces it
+	const auto entry = [&] -> std::shared_ptr<MappedFile> {
+		try
+		{
+			return std::make_shared<MappedFile>(entryPath);
+		}
+		catch (const std::system_error&)
+		{
+			return nullptr;
+		}
+	}();
+
+	if (not entry)
+	{
+		return std::nullopt;
+	}
+
+	const auto data = entry->data();
+
+	if (data.size() < sizeof(Header))
+	{
+		return std::nullopt;
+	}
+
+	auto header = Header{};
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	if (header.magic != MODEL_CACHE_MAGIC || header.version != MODEL_CACHE_VERSION || header.key != key)
+	{
+		return std::nullopt;
+	}
+
+	auto valid = true;
+	auto asset = Asset{};
+
+	const auto sources = getTable<SourceEntry>(data, header.sources, valid);
+
+	for (const auto& sourceEntry : sources)
+	{
+		const auto path = getTable<char8_t>(data, sourceEntry.path, valid);
+		asset.sources.push_back(source.parent_path() / std::u8string_view(path.data(), path.size()));
+		asset.sourceHashes.push_back(sourceEntry.hash);
+	}
+
+	if (not valid || asset.sources.empty())
+	{
+		return std::nullopt;
+	}
+
+	asset.sources.front() = source;
+
+	// the glTF/GLB file itself is covered by the key
+	for (const auto& [path, sourceEntry] : std::views::zip(asset.sources, sources) | std::views::drop(1))
+	{
+		if (not std::filesystem::is_regular_file(path, ec) || hashFile(path) != sourceEntry.hash)
+		{
+			return std::nullopt;
+		}
+	}
+
+	for (const auto& range : getTable<Range>(data, header.buffers, valid))
+	{
+		asset.buffers.push_back(getTable<std::byte>(data, range, valid));
+	}
+
+	for (const auto& image : getTable<ImageEntry>(data, header.images, valid))
+	{
+		asset.images.push_back(Asset::Image{
+			.texels = getTable<std::byte>(data, image.texels, valid),
+			.format = image.format,
+			.extent = image.extent,
+		});
+	}
+
+	asset.samplers = getTable<Asset::Sampler>(data, header.samplers, valid) | std::ranges::to<std::vector>();
+	asset.materials = getTable<std::byte>(data, header.materials, valid);
+	asset.materialCount = static_cast<uint32_t>(header.materialCount);
+	asset.primitives = getTable<Asset::Primitive>(data, header.primitives, valid);
+	asset.meshes = getTable<Asset::Mesh>(data, header.meshes, valid);
+	asset.nodes = getTable<Asset::Node>(data, header.nodes, valid);
+	asset.instanceTransforms = getTable<glm::mat4>(data, header.instanceTransforms, valid);
+	asset.scenes = getTable<Asset::Scene>(data, header.scenes, valid);
+	asset.meshlets = getTable<Meshlet>(data, header.meshlets, valid);
+	asset.meshletVertices = getTable<uint32_t>(data, header.meshletVertices, valid);
+	asset.meshletTriangles = getTable<uint32_t>(data, header.meshletTriangles, valid);
+	asset.lods = getTable<Lod>(data, header.lods, valid);
+
+	if (not valid || not isConsistent(asset))
+	{
+		return std::nullopt;
+	}
+
+	asset.storage = entry;
+
+	return asset;
+}
+
+void ModelCache::store(const Asset& asset) const
+{
+	assert(not asset.sources.empty() && asset.sourceHashes.size() == asset.sources.size());
+
+	const auto sourceDirectory = asset.sources.front().parent_path();
+
+	const auto key = getKey(asset.sourceHashes.front());
+	const auto entryPath = getEntryPath(key);
+
+	auto ec = std::error_code();
+	std::filesystem::create_directories(directory, ec);
+
+	// written aside and renamed, so concurrent readers never map a partial entry
+	auto tempPath = entryPath;
+	tempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	{
+		auto file = std::ofstream(tempPath, std::ios::binary | std::ios::trunc);
+
+		// the cache is best effort, failing to write an entry only costs the next load
+		if (not file)
+		{
+			return;
+		}
+
+		auto header = Header{
+			.magic = MODEL_CACHE_MAGIC,
+			.version = MODEL_CACHE_VERSION,
+			.key = key,
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		const auto write = [&](const auto data) {
+			constexpr auto padding = std::array<char, MODEL_CACHE_ALIGNMENT>{};
+
+			const auto position = static_cast<uint64_t>(file.tellp());
+			const auto offset = (position + MODEL_CACHE_ALIGNMENT - 1) / MODEL_CACHE_ALIGNMENT * MODEL_CACHE_ALIGNMENT;
+
+			file.write(padding.data(), offset - position);
+			file.write(reinterpret_cast<const char*>(data.data()), data.size_bytes());
+
+			return Range{ .offset = offset, .size = data.size_bytes() };
+		};
+
+		const auto sources = [&] {
+			auto result = std::vector<SourceEntry>();
+
+			for (const auto& [path, hash] : std::views::zip(asset.sources, asset.sourceHashes))
+			{
+				const auto relativePath = path.lexically_relative(sourceDirectory).generic_u8string();
+				result.push_back({ .path = write(std::span(relativePath)), .hash = hash });
+			}
+
+			return result;
+		}();
+
+		const auto buffers = asset.buffers
+			| std::views::transform(write)
+			| std::ranges::to<std::vector>();
+
+		const auto images = asset.images
+			| std::views::transform([&](const Asset::Image& image) {
+				return ImageEntry{
+					.texels = write(image.texels),
+					.format = image.format,
+					.extent = image.extent,
+				};
+			})
+			| std::ranges::to<std::vector>();
+
+		header.sources = write(std::span(sources));
+		header.buffers = write(std::span(buffers));
+		header.images = write(std::span(images));
+		header.samplers = write(std::span(asset.samplers));
+		header.materials = write(asset.materials);
+		header.materialCount = asset.materialCount;
+		header.primitives = write(asset.primitives);
+		header.meshes = write(asset.meshes);
+		header.nodes = write(asset.nodes);
+		header.instanceTransforms = write(asset.instanceTransforms);
+		header.scenes = write(asset.scenes);
+		header.meshlets = write(asset.meshlets);
+		header.meshletVertices = write(asset.meshletVertices);
+		header.meshletTriangles = write(asset.meshletTriangles);
+		header.lods = write(asset.lods);
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		if (not file.flush())
+		{
+			file.close();
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, entryPath, ec);
+
+	if (ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+	}
+}
+
+std::filesystem::path ModelCache::getEntryPath(const uint64_t key) const
+{
+	return directory / fmt::format("{:016x}.gmc", key);
+}
+
+uint64_t ModelCache::getKey(const uint64_t sourceHash) const
+{
+	const auto values = std::to_array<uint64_t>({ sourceHash, salt, MODEL_CACHE_VERSION });
+	return hashBytes(std::as_bytes(std::span(values)));
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "asset.h"
+
+namespace gltf
+{
+
+// On-disk cache of imported assets. Entries are keyed by the content hash of the
+// glTF/GLB file and checked against the hashes of every file it references.
+// A hit maps the entry, buffers and texels are uploaded straight from the mapping.
+class ModelCache
+{
+public:
+	// salt covers inputs other than the source files, e.g. the shader's material layout
+	ModelCache(const std::filesystem::path& directory, const uint64_t salt);
+
+	// nullopt on a miss or a stale entry
+	std::optional<Asset> load(const std::filesystem::path& source) const;
+	// keyed on asset.sourceHashes, the files aren't read again
+	void store(const Asset& asset) const;
+
+private:
+	std::filesystem::path getEntryPath(const uint64_t key) const;
+	uint64_t getKey(const uint64_t sourceHash) const;
+
+	std::filesystem::path directory;
+	uint64_t salt;
+};
+
+}
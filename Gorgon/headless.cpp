@@ -0,0 +1,647 @@
+#include "headless.h"
+#include "camera.h"
+
+namespace
+{
+
+constexpr auto FRAMES_IN_FLIGHT = 2u;
+
+// written every frame, the passes in between only take time with occlusion culling
+enum Timestamp : uint32_t
+{
+	eFrameBegin,
+	eEarlyPassEnd,
+	eDepthPyramidEnd,
+	eFrameEnd,
+	eCount,
+};
+
+constexpr auto QUERIES_PER_FRAME = uint32_t(Timestamp::eCount);
+
+vk::raii::Instance createInstance(const vk::raii::Context& context)
+{
+	VULKAN_HPP_DEFAULT_DISPATCHER.init();
+
+	// no surface extensions are needed
+	auto extensions = std::vector<const char*>();
+
+#if !defined(NDEBUG)
+	extensions.push_back(vk::EXTDebugUtilsExtensionName); // for debug object names
+#endif // !defined(NDEBUG)
+
+	const auto applicationInfo = vk::ApplicationInfo{
+		.apiVersion = VK_API_VERSION,
+	};
+
+	const auto createInfo = vk::InstanceCreateInfo{
+		.pApplicationInfo = &applicationInfo,
+	}.setPEnabledExtensionNames(extensions);
+
+	auto instance = context.createInstance(createInfo);
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(*instance);
+
+	return instance;
+}
+
+std::optional<uint32_t> findGraphicsQueueFamily(const vk::raii::PhysicalDevice& physicalDevice)
+{
+	for (const auto& [index, properties] : std::views::enumerate(physicalDevice.getQueueFamilyProperties()))
+	{
+		if (properties.queueFlags & vk::QueueFlagBits::eGraphics)
+		{
+			return static_cast<uint32_t>(index);
+		}
+	}
+
+	return std::nullopt;
+}
+
+vk::raii::PhysicalDevice selectPhysicalDevice(const vk::raii::Instance& instance)
+{
+	auto physicalDevices = instance.enumeratePhysicalDevices();
+
+	// present support isn't needed, any device with a graphics queue will do
+	std::erase_if(physicalDevices, [](const vk::raii::PhysicalDevice& physicalDevice) {
+		return not findGraphicsQueueFamily(physicalDevice);
+	});
+
+	if (physicalDevices.empty())
+	{
+		throw std::runtime_error("no Vulkan device with a graphics queue");
+	}
+
+	// prefer real hardware over software rasterizers such as lavapipe
+	const auto rank = [](const vk::raii::PhysicalDevice& physicalDevice) {
+		switch (physicalDevice.getProperties().deviceType) {
+		case vk::PhysicalDeviceType::eDiscreteGpu: return 3;
+		case vk::PhysicalDeviceType::eIntegratedGpu: return 2;
+		case vk::PhysicalDeviceType::eVirtualGpu: return 1;
+		default: return 0;
+		}
+	};
+
+	const auto it = std::ranges::max_element(physicalDevices, std::ranges::less{}, rank);
+
+	return std::move(*it);
+}
+
+vk::raii::Device createDevice(const vk::raii::PhysicalDevice& physicalDevice, const uint32_t queueFamilyIndex)
+{
+	constexpr auto queuePriority = 1.0f;
+
+	const auto queueCreateInfo = vk::DeviceQueueCreateInfo{
+		.queueFamilyIndex = queueFamilyIndex,
+		.queueCount = 1,
+		.pQueuePriorities = &queuePriority,
+	};
+
+	const auto features = vk::PhysicalDeviceFeatures{
+		.multiDrawIndirect = true,
+		.drawIndirectFirstInstance = true,
+		.fillModeNonSolid = true,
+	};
+
+	// same features as the windowed path, minus the swapchain related ones
+	const auto deviceCreateInfoChain = vk::StructureChain(
+		vk::DeviceCreateInfo{ .pEnabledFeatures = &features }
+			.setQueueCreateInfos(queueCreateInfo),
+		vk::PhysicalDeviceVulkan11Features{},
+		vk::PhysicalDeviceVulkan12Features{
+			.drawIndirectCount = true,
+			.descriptorBindingSampledImageUpdateAfterBind = true,
+			.descriptorBindingPartiallyBound = true,
+			.descriptorBindingVariableDescriptorCount = true,
+			.runtimeDescriptorArray = true,
+			.timelineSemaphore = true,
+		},
+		vk::PhysicalDeviceVulkan13Features{
+			.synchronization2 = true,
+			.dynamicRendering = true,
+		},
+		vk::PhysicalDeviceVulkan14Features{},
+		vk::PhysicalDeviceVertexAttributeRobustnessFeaturesEXT{
+			.vertexAttributeRobustness = true,
+		});
+
+	auto device = physicalDevice.createDevice(deviceCreateInfoChain.get<vk::DeviceCreateInfo>());
+	VULKAN_HPP_DEFAULT_DISPATCHER.init(*device);
+
+	return device;
+}
+
+vk::Format findSupportedFormat(
+	const vk::raii::PhysicalDevice& physicalDevice,
+	const std::initializer_list<vk::Format> candidates,
+	const vk::FormatFeatureFlags features)
+{
+	for (const auto format : candidates)
+	{
+		const auto props = physicalDevice.getFormatProperties2(format);
+
+		if ((props.formatProperties.optimalTilingFeatures & features) == features)
+		{
+			return format;
+		}
+	}
+
+	auto names = std::string();
+
+	for (const auto format : candidates)
+	{
+		names += (names.empty() ? "" : ", ") + vk::to_string(format);
+	}
+
+	throw std::runtime_error(fmt::format("none of the formats {} supports {}", names, vk::to_string(features)));
+}
+
+VmaImage createAttachmentImage(
+	const VulkanMemoryAllocator& vma,
+	const vk::Format format,
+	const vk::Extent2D extent,
+	const vk::ImageUsageFlags usage)
+{
+	const auto createInfo = vk::ImageCreateInfo{
+		.imageType = vk::ImageType::e2D,
+		.format = format,
+		.extent = vk::Extent3D{
+			.width = extent.width,
+			.height = extent.height,
+			.depth = 1,
+		},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = vk::SampleCountFlagBits::e1,
+		.tiling = vk::ImageTiling::eOptimal,
+		.usage = usage,
+		.sharingMode = vk::SharingMode::eExclusive,
+	};
+
+	return vma.createImage(createInfo, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+}
+
+vk::raii::ImageView createImageView(
+	const vk::raii::Device& device,
+	const VmaImage& image,
+	const vk::Format format,
+	const vk::ImageAspectFlags aspectMask)
+{
+	const auto createInfo = vk::ImageViewCreateInfo{
+		.image = *image,
+		.viewType = vk::ImageViewType::e2D,
+		.format = format,
+		.subresourceRange = {
+			.aspectMask = aspectMask,
+			.levelCount = 1,
+			.layerCount = 1,
+		},
+	};
+
+	return device.createImageView(createInfo);
+}
+
+std::vector<vk::raii::Fence> createFences(const vk::raii::Device& device)
+{
+	auto result = std::vector<vk::raii::Fence>();
+	result.reserve(FRAMES_IN_FLIGHT);
+
+	std::generate_n(std::back_inserter(result), FRAMES_IN_FLIGHT, [&] {
+		return device.createFence({ .flags = vk::FenceCreateFlagBits::eSignaled });
+	});
+
+	return result;
+}
+
+uint32_t getTimestampValidBits(const vk::raii::PhysicalDevice& physicalDevice, const uint32_t queueFamilyIndex)
+{
+	return physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+}
+
+std::optional<vk::raii::QueryPool> createTimestampQueryPool(const vk::raii::Device& device, const uint32_t timestampValidBits)
+{
+	if (not timestampValidBits)
+	{
+		return std::nullopt;
+	}
+
+	const auto createInfo = vk::QueryPoolCreateInfo{
+		.queryType = vk::QueryType::eTimestamp,
+		.queryCount = FRAMES_IN_FLIGHT * QUERIES_PER_FRAME,
+	};
+
+	return device.createQueryPool(createInfo);
+}
+
+}
+
+HeadlessRenderer::HeadlessRenderer(const CreateInfo& info)
+	: instance(createInstance(context))
+	, physicalDevice(selectPhysicalDevice(instance))
+	, queueFamilyIndex(findGraphicsQueueFamily(physicalDevice).value())
+	, device(createDevice(physicalDevice, queueFamilyIndex))
+	, vma(VulkanMemoryAllocator::CreateInfo{ .instance = instance, .physicalDevice = physicalDevice, .device = device })
+	, queue(device.getQueue(queueFamilyIndex, 0))
+	, extent(info.extent)
+	, drawMode(info.drawMode)
+	, parallelRecording(info.parallelRecording)
+	, lodPixelError(info.lodPixelError)
+	, colorFormat(findSupportedFormat(
+		physicalDevice,
+		{ vk::Format::eB8G8R8A8Srgb, vk::Format::eR8G8B8A8Srgb },
+		vk::FormatFeatureFlagBits::eColorAttachment))
+	, depthFormat(findSupportedFormat(
+		physicalDevice,
+		{ vk::Format::eD16Unorm, vk::Format::eD32Sfloat },
+		vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage))
+	, colorImage(createAttachmentImage(vma, colorFormat, extent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc))
+	, colorImageView(createImageView(device, colorImage, colorFormat, vk::ImageAspectFlagBits::eColor))
+	, depthImage(createAttachmentImage(vma, depthFormat, extent, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled))
+	, depthImageView(createImageView(device, depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth))
+	, commandPool(device.createCommandPool({
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient,
+		.queueFamilyIndex = queueFamilyIndex,
+	}))
+	, commandBuffers(device.allocateCommandBuffers({
+		.commandPool = *commandPool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = FRAMES_IN_FLIGHT,
+	}))
+	, transferCommandBuffer(std::move(device.allocateCommandBuffers({
+		.commandPool = *commandPool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = 1,
+	}).front()))
+	, fences(createFences(device))
+	, queryPool(createTimestampQueryPool(device, getTimestampValidBits(physicalDevice, queueFamilyIndex)))
+	, timestampMask([&] {
+		const auto validBits = getTimestampValidBits(physicalDevice, queueFamilyIndex);
+		return validBits < 64 ? (uint64_t(1) << validBits) - 1 : UINT64_MAX_VALUE;
+	}())
+	, timestampPeriod(physicalDevice.getProperties().limits.timestampPeriod)
+	, secondaryCommandPools(SecondaryCommandPools::CreateInfo{
+		.device = device,
+		.queueFamilyIndex = queueFamilyIndex,
+		.framesInFlight = FRAMES_IN_FLIGHT,
+		.slotCount = threadPool.size(),
+	})
+	, loader(gltf::Loader::CreateInfo{
+		.physicalDevice = physicalDevice,
+		.device = device,
+		.vma = vma,
+		.transferCommandBuffer = transferCommandBuffer,
+		.transferQueue = queue,
+		.transferQueueMutex = queueMutex,
+		.transferQueueFamilyIndex = queueFamilyIndex,
+		.graphicsQueueFamilyIndex = queueFamilyIndex,
+		.threadPool = threadPool,
+		.surfaceFormat = colorFormat,
+		.depthFormat = depthFormat,
+		.modelCacheDirectory = info.cacheDirectory.transform([](const auto& directory) { return directory / "models"; }),
+		.pipelineCachePath = info.cacheDirectory.transform([](const auto& directory) { return directory / "pipelines.bin"; }),
+		.framesInFlight = FRAMES_IN_FLIGHT,
+		.clusterCulling = info.drawMode == gltf::DrawMode::eClusterCulled,
+	})
+{
+	if (drawMode == gltf::DrawMode::eOcclusionCulled)
+	{
+		depthPyramid.emplace(DepthPyramid::CreateInfo{
+			.device = device,
+			.vma = vma,
+			.depthImage = *depthImage,
+			.depthImageView = *depthImageView,
+			.depthExtent = extent,
+		});
+	}
+}
+
+HeadlessRenderer::~HeadlessRenderer()
+{
+	device.waitIdle();
+}
+
+gltf::Loader& HeadlessRenderer::getLoader()
+{
+	return loader;
+}
+
+std::string HeadlessRenderer::getDeviceName() const
+{
+	return physicalDevice.getProperties().deviceName;
+}
+
+HeadlessRenderer::FrameTimings HeadlessRenderer::render(const gltf::Model& model, const uint32_t frameCount)
+{
+	using clock = std::chrono::steady_clock;
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	auto timings = FrameTimings{};
+	timings.cpu.reserve(frameCount);
+
+	if (queryPool)
+	{
+		timings.gpu.reserve(frameCount);
+	}
+
+	// GPU culling stats are read back once the frame has finished
+	const auto culled = drawMode == gltf::DrawMode::eCulled || drawMode == gltf::DrawMode::eOcclusionCulled;
+	const auto clusterCulled = drawMode == gltf::DrawMode::eClusterCulled;
+
+	// fixed time step, so every run renders exactly the same frames
+	constexpr auto deltaTime = 1.0f / 60.0f;
+	auto camera = OrbitCamera();
+
+	const auto readTimestamps = [&](const uint64_t frameNumber) {
+		const auto firstQuery = static_cast<uint32_t>((frameNumber % FRAMES_IN_FLIGHT) * QUERIES_PER_FRAME);
+
+		const auto [result, ticks] = queryPool->getResults<uint64_t>(
+			firstQuery,
+			QUERIES_PER_FRAME,
+			QUERIES_PER_FRAME * sizeof(uint64_t),
+			sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait
+		);
+		assert(result == vk::Result::eSuccess);
+
+		const auto getMilliseconds = [&](const Timestamp begin, const Timestamp end) {
+			const auto nanoseconds = static_cast<double>((ticks[end] - ticks[begin]) & timestampMask) * timestampPeriod;
+			return nanoseconds * 1e-6;
+		};
+
+		timings.gpu.push_back(getMilliseconds(eFrameBegin, eFrameEnd));
+
+		if (depthPyramid)
+		{
+			timings.passes.push_back({
+				.early = getMilliseconds(eFrameBegin, eEarlyPassEnd),
+				.depthPyramid = getMilliseconds(eEarlyPassEnd, eDepthPyramidEnd),
+				.late = getMilliseconds(eDepthPyramidEnd, eFrameEnd),
+			});
+		}
+	};
+
+	for (auto frameNumber = uint64_t(0); frameNumber < frameCount; ++frameNumber)
+	{
+		const auto frameIndex = frameNumber % FRAMES_IN_FLIGHT;
+		const auto& fence = fences[frameIndex];
+
+		{
+			const auto result = device.waitForFences(*fence, true, UINT64_MAX_VALUE);
+			assert(result == vk::Result::eSuccess);
+			device.resetFences(*fence);
+		}
+
+		// the frame which used this slot before has finished
+		if (queryPool && frameNumber >= FRAMES_IN_FLIGHT)
+		{
+			readTimestamps(frameNumber - FRAMES_IN_FLIGHT);
+		}
+
+		if (culled && frameNumber >= FRAMES_IN_FLIGHT)
+		{
+			timings.culling.push_back(model.getCullStats(static_cast<uint32_t>(frameIndex)));
+		}
+
+		if (clusterCulled && frameNumber >= FRAMES_IN_FLIGHT)
+		{
+			timings.clusterCulling.push_back(model.getClusterCullStats(static_cast<uint32_t>(frameIndex)));
+		}
+
+		const auto cpuStart = clock::now();
+
+		secondaryCommandPools.reset(static_cast<uint32_t>(frameIndex));
+
+		const auto& commandBuffer = commandBuffers[frameIndex];
+		commandBuffer.reset();
+		commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+		const auto firstQuery = static_cast<uint32_t>(frameIndex * QUERIES_PER_FRAME);
+
+		const auto writeTimestamp = [&](const vk::PipelineStageFlags2 stage, const Timestamp timestamp) {
+			if (queryPool)
+			{
+				commandBuffer.writeTimestamp2(stage, **queryPool, firstQuery + timestamp);
+			}
+		};
+
+		if (queryPool)
+		{
+			commandBuffer.resetQueryPool(**queryPool, firstQuery, QUERIES_PER_FRAME);
+		}
+
+		writeTimestamp(vk::PipelineStageFlagBits2::eTopOfPipe, eFrameBegin);
+
+		const auto viewProj = camera.getViewProj(extent);
+
+		const auto cull = [&](const gltf::CullPass pass) {
+			model.cull({
+				.sceneIndex = 0, // TODO
+				.viewProj = viewProj,
+				.commandBuffer = commandBuffer,
+				.frameIndex = static_cast<uint32_t>(frameIndex),
+				.pass = pass,
+				.depthPyramid = pass == gltf::CullPass::eLate ? &*depthPyramid : nullptr,
+				.lodPixelError = lodPixelError,
+				.viewportHeight = extent.height,
+			});
+		};
+
+		// compute work has to be recorded outside of rendering
+		if (drawMode == gltf::DrawMode::eCulled)
+		{
+			cull(gltf::CullPass::eFrustum);
+		}
+		else if (depthPyramid)
+		{
+			cull(gltf::CullPass::eEarly);
+		}
+		else if (clusterCulled)
+		{
+			model.cullClusters({
+				.sceneIndex = 0, // TODO
+				.viewProj = viewProj,
+				.commandBuffer = commandBuffer,
+				.frameIndex = static_cast<uint32_t>(frameIndex),
+			});
+		}
+
+		{
+			const auto imageMemoryBarriers = {
+				// to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, previous content is discarded
+				vk::ImageMemoryBarrier2{
+					.srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+					.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+					.dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+					.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite,
+					.newLayout = vk::ImageLayout::eColorAttachmentOptimal,
+					.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+					.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+					.image = *colorImage,
+					.subresourceRange = COLOR_SUBRESOURCE_RANGE,
+				},
+				// to VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
+				vk::ImageMemoryBarrier2{
+					.srcStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+					.srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+					.dstStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+					.dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+					.newLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+					.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+					.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+					.image = *depthImage,
+					.subresourceRange = {
+						.aspectMask = vk::ImageAspectFlagBits::eDepth,
+						.levelCount = 1,
+						.layerCount = 1,
+					},
+				},
+			};
+
+			const auto dependencyInfo = vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarriers);
+			commandBuffer.pipelineBarrier2(dependencyInfo);
+		}
+
+		auto cpuCullStats = CullStats{};
+		auto commandStats = CommandRecorder::Stats{};
+
+		const auto inheritanceRenderingInfo = vk::CommandBufferInheritanceRenderingInfo{
+			.depthAttachmentFormat = depthFormat,
+			.rasterizationSamples = vk::SampleCountFlagBits::e1,
+		}.setColorAttachmentFormats(colorFormat);
+
+		const auto parallelRecordInfo = gltf::ParallelRecordInfo{
+			.threadPool = threadPool,
+			.commandPools = secondaryCommandPools,
+			.inheritanceRenderingInfo = inheritanceRenderingInfo,
+		};
+
+		// the second pass of occlusion culling draws over the first
+		const auto renderPass = [&](const vk::AttachmentLoadOp loadOp) {
+			const auto colorAttachment = vk::RenderingAttachmentInfo{
+				.imageView = *colorImageView,
+				.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+				.loadOp = loadOp,
+				.storeOp = vk::AttachmentStoreOp::eStore,
+				.clearValue = { .color = std::to_array({ 0.1f, 0.1f, 0.1f, 1.0f }) },
+			};
+
+			const auto depthAttachment = vk::RenderingAttachmentInfo{
+				.imageView = *depthImageView,
+				.imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+				.loadOp = loadOp,
+				.storeOp = depthPyramid ? vk::AttachmentStoreOp::eStore : vk::AttachmentStoreOp::eDontCare,
+				.clearValue = { .depthStencil = { .depth = 1.0f } },
+			};
+
+			const auto renderingInfo = vk::RenderingInfo{
+				.flags = parallelRecording ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags(),
+				.renderArea = vk::Rect2D{ .extent = extent },
+				.layerCount = 1,
+				.pDepthAttachment = &depthAttachment,
+			}.setColorAttachments(colorAttachment);
+
+			commandBuffer.beginRendering(renderingInfo);
+
+			auto recorder = CommandRecorder(commandBuffer);
+
+			const auto drawInfo = gltf::Model::DrawInfo{
+				.sceneIndex = 0, // TODO
+				.viewProj = viewProj,
+				.recorder = recorder,
+				.surfaceExtent = extent,
+				.drawMode = drawMode,
+				.frameIndex = static_cast<uint32_t>(frameIndex),
+				.cpuCullStats = &cpuCullStats,
+				.parallel = parallelRecording ? &parallelRecordInfo : nullptr,
+				.lodPixelError = lodPixelError,
+			};
+
+			model.Draw(drawInfo);
+
+			commandStats.issued += recorder.getStats().issued;
+			commandStats.skipped += recorder.getStats().skipped;
+
+			commandBuffer.endRendering();
+		};
+
+		renderPass(vk::AttachmentLoadOp::eClear);
+
+		if (depthPyramid)
+		{
+			writeTimestamp(vk::PipelineStageFlagBits2::eAllCommands, eEarlyPassEnd);
+			depthPyramid->build(commandBuffer);
+			writeTimestamp(vk::PipelineStageFlagBits2::eAllCommands, eDepthPyramidEnd);
+
+			cull(gltf::CullPass::eLate);
+			renderPass(vk::AttachmentLoadOp::eLoad);
+		}
+		else
+		{
+			writeTimestamp(vk::PipelineStageFlagBits2::eAllCommands, eEarlyPassEnd);
+			writeTimestamp(vk::PipelineStageFlagBits2::eAllCommands, eDepthPyramidEnd);
+		}
+
+		writeTimestamp(vk::PipelineStageFlagBits2::eAllCommands, eFrameEnd);
+
+		if (drawMode == gltf::DrawMode::eCpuCulled)
+		{
+			timings.culling.push_back(cpuCullStats);
+		}
+
+		timings.commands = commandStats;
+
+		commandBuffer.end();
+
+		const auto commandBufferInfo = vk::CommandBufferSubmitInfo{ .commandBuffer = *commandBuffer };
+		const auto submitInfo = vk::SubmitInfo2{}.setCommandBufferInfos(commandBufferInfo);
+
+		{
+			const auto lock = std::scoped_lock(queueMutex);
+			queue.submit2(submitInfo, *fence);
+		}
+
+		timings.cpu.push_back(milliseconds(clock::now() - cpuStart).count());
+
+		camera.update(deltaTime);
+	}
+
+	// wait for the frames still in flight
+	{
+		const auto waitFences = fences
+			| std::views::transform([](const vk::raii::Fence& fence) { return *fence; })
+			| std::ranges::to<vku::small::vector<vk::Fence, FRAMES_IN_FLIGHT>>();
+
+		const auto result = device.waitForFences(waitFences, true, UINT64_MAX_VALUE);
+		assert(result == vk::Result::eSuccess);
+	}
+
+	if (culled)
+	{
+		const auto firstPending = frameCount > FRAMES_IN_FLIGHT ? frameCount - FRAMES_IN_FLIGHT : 0u;
+
+		for (auto frameNumber = uint64_t(firstPending); frameNumber < frameCount; ++frameNumber)
+		{
+			timings.culling.push_back(model.getCullStats(static_cast<uint32_t>(frameNumber % FRAMES_IN_FLIGHT)));
+		}
+	}
+
+	if (clusterCulled)
+	{
+		const auto firstPending = frameCount > FRAMES_IN_FLIGHT ? frameCount - FRAMES_IN_FLIGHT : 0u;
+
+		for (auto frameNumber = uint64_t(firstPending); frameNumber < frameCount; ++frameNumber)
+		{
+			timings.clusterCulling.push_back(model.getClusterCullStats(static_cast<uint32_t>(frameNumber % FRAMES_IN_FLIGHT)));
+		}
+	}
+
+	if (queryPool)
+	{
+		const auto firstPending = frameCount > FRAMES_IN_FLIGHT ? frameCount - FRAMES_IN_FLIGHT : 0u;
+
+		for (auto frameNumber = uint64_t(firstPending); frameNumber < frameCount; ++frameNumber)
+		{
+			readTimestamps(frameNumber);
+		}
+	}
+
+	return timings;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "gltf/loader.h"
+#include "vk/vma.h"
+#include "vk/depth_pyramid.h"
+
+// names accepted by the --draw-mode options
+inline const auto DRAW_MODES = std::map<std::string, gltf::DrawMode>{
+	{ "direct", gltf::DrawMode::eDirect },
+	{ "indirect", gltf::DrawMode::eIndirect },
+	{ "culled", gltf::DrawMode::eCulled },
+	{ "cpu-culled", gltf::DrawMode::eCpuCulled },
+	{ "occlusion-culled", gltf::DrawMode::eOcclusionCulled },
+	{ "cluster-culled", gltf::DrawMode::eClusterCulled },
+};
+
+// Renders into offscreen color/depth images without a window, surface or swapchain.
+// Used for benchmarking on machines without a display (e.g. lavapipe only CI boxes).
+class HeadlessRenderer
+{
+public:
+	struct CreateInfo
+	{
+		vk::Extent2D extent;
+		std::optional<std::filesystem::path> cacheDirectory; // model and pipeline caches, nullopt disables both
+		gltf::DrawMode drawMode = gltf::DrawMode::eIndirect;
+		bool parallelRecording = false; // draws recorded on every thread into secondary command buffers
+		float lodPixelError = 0.0f; // see gltf::Model::DrawInfo
+	};
+
+	// GPU time of the occlusion culling steps, in milliseconds
+	struct PassTimings
+	{
+		double early; // early culling pass and the draws it emitted
+		double depthPyramid;
+		double late; // late culling pass and the draws it emitted
+	};
+
+	struct FrameTimings
+	{
+		std::vector<double> cpu; // milliseconds
+		std::vector<double> gpu; // milliseconds, empty if the queue doesn't support timestamps
+		CommandRecorder::Stats commands; // of the last frame
+		std::vector<CullStats> culling; // per frame, empty unless the draw mode culls
+		std::vector<ClusterCullStats> clusterCulling; // per frame, DrawMode::eClusterCulled only
+		std::vector<PassTimings> passes; // per frame, DrawMode::eOcclusionCulled with timestamps only
+	};
+
+	HeadlessRenderer(const CreateInfo& info);
+	HeadlessRenderer(const HeadlessRenderer&) = delete;
+	~HeadlessRenderer();
+
+	gltf::Loader& getLoader();
+	std::string getDeviceName() const;
+
+	FrameTimings render(const gltf::Model& model, const uint32_t frameCount);
+
+private:
+	vk::raii::Context context;
+	vk::raii::Instance instance;
+	vk::raii::PhysicalDevice physicalDevice;
+	uint32_t queueFamilyIndex;
+	vk::raii::Device device;
+	VulkanMemoryAllocator vma;
+	vk::raii::Queue queue;
+	std::mutex queueMutex;
+
+	vk::Extent2D extent;
+	gltf::DrawMode drawMode;
+	bool parallelRecording;
+	float lodPixelError;
+	vk::Format colorFormat;
+	vk::Format depthFormat;
+	VmaImage colorImage;
+	vk::raii::ImageView colorImageView;
+	VmaImage depthImage;
+	vk::raii::ImageView depthImageView;
+	std::optional<DepthPyramid> depthPyramid; // DrawMode::eOcclusionCulled only
+
+	vk::raii::CommandPool commandPool;
+	std::vector<vk::raii::CommandBuffer> commandBuffers;
+	vk::raii::CommandBuffer transferCommandBuffer;
+	std::vector<vk::raii::Fence> fences;
+
+	// nullopt if the queue family has no valid timestamp bits
+	std::optional<vk::raii::QueryPool> queryPool;
+	uint64_t timestampMask;
+	double timestampPeriod; // nanoseconds per tick
+
+	ThreadPool threadPool;
+	SecondaryCommandPools secondaryCommandPools; // a slot per thread
+	gltf::Loader loader;
+};
@@ -6,14 +6,28 @@
 #include <filesystem>
 #include <atomic>
 #include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
 #include <ranges>
 #include <span>
+#include <numeric>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <charconv>
+#include <cstring>
+#include <bit>
+#include <fstream>
+#include <bitset>
+#include <map>
 
 // third party
 #include <slang/slang.h>
 #include <CLI/CLI.hpp>
 #include <fmt/ostream.h>
 #include <tiny_gltf.h>
+#include <stb_image.h>
 #include <vulkan/vulkan_raii.hpp>
 #include <vulkan/vulkan_hash.hpp>
 #include <vulkan/utility/vk_small_containers.hpp>
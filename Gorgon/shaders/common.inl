@@ -1,7 +1,11 @@
+#pragma once
 #ifdef SLANG_SOURCE_FILE
 
 #else
 using float4x4 = glm::mat4;
+using float4 = glm::vec4;
 using float3 = glm::vec3;
+using float2 = glm::vec2;
+using uint2 = glm::uvec2;
 using uint = uint32_t;
 #endif
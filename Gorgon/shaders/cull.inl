@@ -0,0 +1,94 @@
+#pragma once
+#include "shared.inl"
+
+// Bindings and output shared by the culling passes
+
+[[vk::binding(0, 0)]]
+StructuredBuffer<DrawRecord> drawRecords;
+
+[[vk::binding(1, 0)]]
+StructuredBuffer<BatchRecord> batchRecords;
+
+// compacted per batch, each batch keeps the range of its uncompacted commands
+[[vk::binding(2, 0)]]
+RWStructuredBuffer<uint> commands;
+
+[[vk::binding(3, 0)]]
+RWStructuredBuffer<uint> drawCounts;
+
+[[vk::binding(4, 0)]]
+RWStructuredBuffer<CullStats> stats;
+
+// per draw record, carried over between frames by the occlusion culling passes
+[[vk::binding(5, 0)]]
+RWStructuredBuffer<uint> visibility;
+
+// of every primitive, see DrawRecord::firstLod
+[[vk::binding(6, 0)]]
+StructuredBuffer<Lod> lods;
+
+static const uint VISIBLE = 1; // passed the last late pass
+static const uint DRAWN_EARLY = 2; // by this frame's early pass
+
+static const uint INDEXED_COMMAND_WORDS = 5;
+static const uint COMMAND_WORDS = 4;
+
+// the coarsest level whose error, scaled like the draw, stays within the selection's bound
+// at the distance of the draw's bounding sphere. Levels get coarser and their errors larger.
+Lod selectLod(const DrawRecord record, const LodSelection selection)
+{
+    let scale = max(
+        max(length(mul(record.modelMatrix, float4(1, 0, 0, 0)).xyz), length(mul(record.modelMatrix, float4(0, 1, 0, 0)).xyz)),
+        length(mul(record.modelMatrix, float4(0, 0, 1, 0)).xyz));
+
+    let center = mul(record.modelMatrix, float4((record.boundsMin + record.boundsMax) * 0.5, 1)).xyz;
+    let radius = length(record.boundsMax - record.boundsMin) * 0.5 * scale;
+    let distance = max(length(center - selection.cameraPosition) - radius, 0);
+
+    var lod = lods[record.firstLod];
+
+    for (uint index = 1; index < record.lodCount; ++index)
+    {
+        let next = lods[record.firstLod + index];
+
+        if (next.error * scale > distance * selection.maxErrorPerDistance)
+        {
+            break;
+        }
+
+        lod = next;
+    }
+
+    return lod;
+}
+
+// appends the draw's command to its batch, at the level of detail the selection picks
+void emitDraw(const uint recordIndex, const DrawRecord record, const LodSelection selection)
+{
+    let batch = batchRecords[record.batch];
+    let lod = selectLod(record, selection);
+
+    uint slot;
+    InterlockedAdd(drawCounts[record.batch], 1, slot);
+    InterlockedAdd(stats[0].visibleDraws, 1);
+
+    if (batch.indexed != 0)
+    {
+        let offset = batch.commandOffset + slot * INDEXED_COMMAND_WORDS;
+
+        commands[offset + 0] = lod.indexCount;
+        commands[offset + 1] = 1;
+        commands[offset + 2] = record.first + lod.firstIndex;
+        commands[offset + 3] = asuint(record.vertexOffset);
+        commands[offset + 4] = recordIndex;
+    }
+    else
+    {
+        let offset = batch.commandOffset + slot * COMMAND_WORDS;
+
+        commands[offset + 0] = lod.indexCount;
+        commands[offset + 1] = 1;
+        commands[offset + 2] = record.first + lod.firstIndex;
+        commands[offset + 3] = recordIndex;
+    }
+}
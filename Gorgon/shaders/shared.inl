@@ -1,11 +1,133 @@
+#pragma once
 #include "common.inl"
 
 struct PushConstants
 {
-    float4x4 mvp;
-    //float4x4 modelMatrix;
+    float4x4 viewProj;
     //float4x4 normalMatrix;
+};
+
+// Per-draw data, indexed by the instance index of the draw
+struct DrawRecord
+{
+    float4x4 modelMatrix;
+    float3 boundsMin; // object space
     uint materialIndex;
+    float3 boundsMax;
+    uint batch; // index into the model's batch records
+    uint count; // indices or vertices
+    uint first; // first index or vertex
+    int vertexOffset;
+    uint firstLod; // into the model's levels of detail
+    uint lodCount;
+    uint padding[3]; // keeps the C++ size equal to the array stride
+};
+
+static const uint LOD_MAX_COUNT = 5;
+
+// A level of detail of a primitive, its indices or vertices follow those of the levels before
+struct Lod
+{
+    uint firstIndex; // relative to the primitive's first index or vertex
+    uint indexCount;
+    float error; // object space distance to the full mesh, 0 for the full mesh
+};
+
+// What the culling passes pick each draw's level of detail with, the coarsest level whose
+// error stays under maxErrorPerDistance times the distance of the draw's bounds
+struct LodSelection
+{
+    float3 cameraPosition; // world space
+    float maxErrorPerDistance; // 0 keeps the levels without error
+};
+
+// Indirect draw call shared by the draws of a batch
+struct BatchRecord
+{
+    uint commandOffset; // in 4 byte words
+    uint indexed; // DrawIndexedIndirectCommand or DrawIndirectCommand
+};
+
+static const uint CULL_WORKGROUP_SIZE = 64;
+
+// which draws a culling pass emits
+static const uint CULL_PASS_FRUSTUM = 0; // those in the frustum
+static const uint CULL_PASS_EARLY = 1; // those in the frustum which were visible last frame
+static const uint CULL_PASS_LATE = 2; // those passing the depth pyramid test, unless the early pass drew them
+
+struct CullPushConstants
+{
+    float4 frustumPlanes[6]; // world space, pointing inwards
+    uint firstRecord;
+    uint recordCount;
+    uint pass; // CULL_PASS_FRUSTUM or CULL_PASS_EARLY
+    uint padding;
+    LodSelection lod;
+};
+
+struct OcclusionCullPushConstants
+{
+    float4x4 viewProj;
+    uint firstRecord;
+    uint recordCount;
+    uint2 padding;
+    LodSelection lod;
+};
+
+struct CullStats
+{
+    uint draws;
+    uint visibleDraws;
+    uint occludedDraws; // in the frustum but behind the depth pyramid, late pass only
+    uint lateDraws; // drawn by the late pass, visible this frame but not the last
+};
+
+static const uint MESHLET_MAX_VERTICES = 64;
+static const uint MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of up to MESHLET_MAX_TRIANGLES triangles of a primitive over at most MESHLET_MAX_VERTICES vertices
+struct Meshlet
+{
+    float3 center; // bounding sphere, object space
+    float radius;
+    float3 coneAxis; // average facing of the triangles, object space
+    float coneCutoff; // sine of the cone's half angle, 1 if the triangles face too many ways to ever all face away
+    uint firstVertex; // into the meshlet vertices, which hold vertex indices of the primitive
+    uint vertexCount;
+    uint firstTriangle; // into the meshlet triangles, three 8 bit indices into the meshlet's vertices each
+    uint triangleCount;
+};
+
+// a meshlet of a draw, what a thread of the cluster culling pass tests
+struct ClusterRecord
+{
+    uint drawRecord;
+    uint meshlet;
+    uint command; // word offset of the draw's DrawIndexedIndirectCommand
+};
+
+struct ClusterCullPushConstants
+{
+    float4 frustumPlanes[6]; // world space, pointing inwards
+    float3 cameraPosition; // world space
+    uint firstClusterRecord;
+    uint clusterRecordCount;
+};
+
+struct ClusterCullStats
+{
+    uint meshlets;
+    uint visibleMeshlets;
+    uint triangles;
+    uint visibleTriangles;
+};
+
+static const uint DEPTH_PYRAMID_WORKGROUP_SIZE = 8;
+
+struct DepthPyramidPushConstants
+{
+    uint2 sourceSize;
+    uint2 size;
 };
 
 typedef uint PrimitiveFlagsInt;
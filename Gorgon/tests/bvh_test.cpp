@@ -0,0 +1,80 @@
+#include "util/bvh.h"
+#include "util/frustum.h"
+#include <random>
+
+// GorgonCore's objects reference the dispatcher, like every executable linking it
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace
+{
+
+// A box is culled when it lies entirely behind one of the planes. The sums are grouped the
+// way Bvh::cullFrustum groups them, so both round the same and agree on boxes touching a plane.
+std::vector<uint32_t> cullBruteForce(const std::span<const Bvh::Box> boxes, const std::array<glm::vec4, 6>& planes)
+{
+	const auto isVisible = [&](const Bvh::Box& box) {
+		return std::ranges::none_of(planes, [&](const glm::vec4& plane) {
+			const auto x = std::max(plane.x * box.min.x, plane.x * box.max.x);
+			const auto y = std::max(plane.y * box.min.y, plane.y * box.max.y);
+			const auto z = std::max(plane.z * box.min.z, plane.z * box.max.z);
+
+			return (x + y) + (z + plane.w) < 0.0f;
+		});
+	};
+
+	return std::views::iota(uint32_t(0), static_cast<uint32_t>(boxes.size()))
+		| std::views::filter([&](const uint32_t index) { return isVisible(boxes[index]); })
+		| std::ranges::to<std::vector>();
+}
+
+}
+
+int main()
+{
+	auto generator = std::mt19937(42);
+
+	const auto uniform = [&](const float min, const float max) {
+		return std::uniform_real_distribution<float>(min, max)(generator);
+	};
+
+	const auto randomVec3 = [&](const float min, const float max) {
+		return glm::vec3(uniform(min, max), uniform(min, max), uniform(min, max));
+	};
+
+	const auto sizes = std::to_array<size_t>({ 0, 1, 3, 4, 5, 17, 1000, 20000 });
+
+	auto failures = 0u;
+
+	for (const auto size : sizes)
+	{
+		const auto boxes = std::views::iota(size_t(0), size)
+			| std::views::transform([&](size_t) {
+				const auto center = randomVec3(-100.0f, 100.0f);
+				const auto extent = randomVec3(0.0f, 5.0f);
+				return Bvh::Box{ .min = center - extent, .max = center + extent };
+			})
+			| std::ranges::to<std::vector>();
+
+		const auto bvh = Bvh(boxes);
+
+		for (auto view = 0u; view < 50; ++view)
+		{
+			const auto eye = randomVec3(-150.0f, 150.0f);
+			const auto target = randomVec3(-50.0f, 50.0f);
+			const auto proj = glm::perspective(uniform(glm::radians(20.0f), glm::radians(120.0f)), uniform(0.5f, 2.0f), 0.1f, uniform(10.0f, 400.0f));
+			const auto planes = getFrustumPlanes(proj * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+			auto visible = std::vector<uint32_t>();
+			bvh.cullFrustum(planes, visible);
+			std::ranges::sort(visible);
+
+			if (visible != cullBruteForce(boxes, planes))
+			{
+				fmt::println(std::cerr, "Bvh::cullFrustum differs from the brute-force test for {} boxes, view {}", size, view);
+				++failures;
+			}
+		}
+	}
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
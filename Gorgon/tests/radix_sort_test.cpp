@@ -0,0 +1,69 @@
+#include "util/radix_sort.h"
+#include <random>
+
+// GorgonCore's objects reference the dispatcher, like every executable linking it
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+namespace
+{
+
+// radixSort against std::stable_sort of the same (key, value) pairs, values start as the indices
+bool matchesStableSort(std::vector<uint64_t> keys)
+{
+	const auto count = keys.size();
+
+	auto values = std::views::iota(uint32_t(0), static_cast<uint32_t>(count)) | std::ranges::to<std::vector>();
+
+	auto expected = std::views::zip(keys, values)
+		| std::views::transform([](const auto& pair) { return std::make_pair(std::get<0>(pair), std::get<1>(pair)); })
+		| std::ranges::to<std::vector>();
+
+	std::ranges::stable_sort(expected, {}, &std::pair<uint64_t, uint32_t>::first);
+
+	auto keysScratch = std::vector<uint64_t>(count);
+	auto valuesScratch = std::vector<uint32_t>(count);
+	radixSort(keys, values, keysScratch, valuesScratch);
+
+	return std::ranges::equal(std::views::zip(keys, values), expected, [](const auto& pair, const auto& expectedPair) {
+		return std::get<0>(pair) == expectedPair.first && std::get<1>(pair) == expectedPair.second;
+	});
+}
+
+}
+
+int main()
+{
+	auto generator = std::mt19937_64(42);
+
+	// keys that differ in a few bytes only skip the other passes, narrow ranges produce duplicates
+	const auto masks = std::to_array<uint64_t>({
+		UINT64_MAX_VALUE,
+		0xFFull,
+		0xFF00'0000'0000ull,
+		0xF000'0000'0000'000Full,
+		0x3ull,
+		0,
+	});
+
+	const auto sizes = std::to_array<size_t>({ 0, 1, 2, 255, 256, 1000, 65537 });
+
+	auto failures = 0u;
+
+	for (const auto mask : masks)
+	{
+		for (const auto size : sizes)
+		{
+			const auto keys = std::views::iota(size_t(0), size)
+				| std::views::transform([&](size_t) { return generator() & mask; })
+				| std::ranges::to<std::vector>();
+
+			if (not matchesStableSort(keys))
+			{
+				fmt::println(std::cerr, "radixSort differs from std::stable_sort for {} keys masked with {:#018x}", size, mask);
+				++failures;
+			}
+		}
+	}
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
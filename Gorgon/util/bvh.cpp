@@ -0,0 +1,220 @@
+#include "bvh.h"
+#include <immintrin.h>
+
+namespace
+{
+
+Bvh::Box getBounds(const std::span<const Bvh::Box> boxes, const std::span<const uint32_t> range)
+{
+	auto result = Bvh::Box{
+		.min = glm::vec3(std::numeric_limits<float>::max()),
+		.max = glm::vec3(std::numeric_limits<float>::lowest()),
+	};
+
+	for (const auto index : range)
+	{
+		result.min = glm::min(result.min, boxes[index].min);
+		result.max = glm::max(result.max, boxes[index].max);
+	}
+
+	return result;
+}
+
+// at the median of the box centers, along the axis they spread the most
+std::array<std::span<uint32_t>, 2> splitMedian(const std::span<const Bvh::Box> boxes, const std::span<uint32_t> range)
+{
+	auto centerMin = glm::vec3(std::numeric_limits<float>::max());
+	auto centerMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+	for (const auto index : range)
+	{
+		const auto center = (boxes[index].min + boxes[index].max) * 0.5f;
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	const auto spread = centerMax - centerMin;
+	const auto axis = spread.x > spread.y ?
+		(spread.x > spread.z ? 0 : 2) :
+		(spread.y > spread.z ? 1 : 2);
+
+	const auto half = range.size() / 2;
+
+	std::ranges::nth_element(range, range.begin() + half, {}, [&](const uint32_t index) {
+		return boxes[index].min[axis] + boxes[index].max[axis];
+	});
+
+	return { range.first(half), range.subspan(half) };
+}
+
+}
+
+Bvh::Bvh(const std::span<const Box> boxes)
+{
+	if (boxes.empty())
+	{
+		return;
+	}
+
+	auto range = std::views::iota(uint32_t(0), static_cast<uint32_t>(boxes.size())) | std::ranges::to<std::vector>();
+	build(boxes, range);
+}
+
+uint32_t Bvh::build(const std::span<const Box> boxes, const std::span<uint32_t> range)
+{
+	// two median splits give up to four children, few enough boxes become leaves directly
+	auto parts = std::array<std::span<uint32_t>, WIDTH>();
+	auto partCount = size_t(0);
+
+	if (range.size() <= WIDTH)
+	{
+		for (auto index = size_t(0); index < range.size(); ++index)
+		{
+			parts[partCount++] = range.subspan(index, 1);
+		}
+	}
+	else
+	{
+		for (const auto half : splitMedian(boxes, range))
+		{
+			if (half.size() > 1)
+			{
+				for (const auto quarter : splitMedian(boxes, half))
+				{
+					parts[partCount++] = quarter;
+				}
+			}
+			else
+			{
+				parts[partCount++] = half;
+			}
+		}
+	}
+
+	const auto nodeIndex = static_cast<uint32_t>(nodes.size());
+	nodes.emplace_back();
+
+	auto node = Node{};
+
+	for (auto child = size_t(0); child < partCount; ++child)
+	{
+		const auto part = parts[child];
+		const auto bounds = getBounds(boxes, part);
+
+		node.minX[child] = bounds.min.x;
+		node.minY[child] = bounds.min.y;
+		node.minZ[child] = bounds.min.z;
+		node.maxX[child] = bounds.max.x;
+		node.maxY[child] = bounds.max.y;
+		node.maxZ[child] = bounds.max.z;
+		node.childMask |= 1u << child;
+
+		if (part.size() == 1)
+		{
+			node.children[child] = part.front();
+			node.leafMask |= 1u << child;
+		}
+		else
+		{
+			node.children[child] = build(boxes, part);
+		}
+	}
+
+	// the recursion may have reallocated the nodes
+	nodes[nodeIndex] = node;
+
+	return nodeIndex;
+}
+
+void Bvh::cullFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visible) const
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	const auto zero = _mm_setzero_ps();
+
+	auto stack = vku::small::vector<uint32_t, 64>{ 0u };
+
+	while (not stack.empty())
+	{
+		const auto& node = nodes[stack.back()];
+		stack.pop_back();
+
+		const auto minX = _mm_load_ps(node.minX.data());
+		const auto minY = _mm_load_ps(node.minY.data());
+		const auto minZ = _mm_load_ps(node.minZ.data());
+		const auto maxX = _mm_load_ps(node.maxX.data());
+		const auto maxY = _mm_load_ps(node.maxY.data());
+		const auto maxZ = _mm_load_ps(node.maxZ.data());
+
+		auto outside = zero;
+		auto intersecting = zero;
+
+		for (const auto& plane : planes)
+		{
+			const auto x = _mm_set1_ps(plane.x);
+			const auto y = _mm_set1_ps(plane.y);
+			const auto z = _mm_set1_ps(plane.z);
+			const auto w = _mm_set1_ps(plane.w);
+
+			const auto productX = std::array{ _mm_mul_ps(x, minX), _mm_mul_ps(x, maxX) };
+			const auto productY = std::array{ _mm_mul_ps(y, minY), _mm_mul_ps(y, maxY) };
+			const auto productZ = std::array{ _mm_mul_ps(z, minZ), _mm_mul_ps(z, maxZ) };
+
+			// signed distances of the corners farthest along the normal and against it
+			const auto farDistance = _mm_add_ps(
+				_mm_add_ps(_mm_max_ps(productX[0], productX[1]), _mm_max_ps(productY[0], productY[1])),
+				_mm_add_ps(_mm_max_ps(productZ[0], productZ[1]), w));
+
+			const auto nearDistance = _mm_add_ps(
+				_mm_add_ps(_mm_min_ps(productX[0], productX[1]), _mm_min_ps(productY[0], productY[1])),
+				_mm_add_ps(_mm_min_ps(productZ[0], productZ[1]), w));
+
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, zero));
+			intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(nearDistance, zero));
+		}
+
+		const auto outsideMask = static_cast<uint32_t>(_mm_movemask_ps(outside));
+		const auto intersectingMask = static_cast<uint32_t>(_mm_movemask_ps(intersecting));
+
+		for (auto mask = node.childMask & ~outsideMask; mask != 0; mask &= mask - 1)
+		{
+			const auto child = std::countr_zero(mask);
+			const auto bit = 1u << child;
+
+			if (node.leafMask & bit)
+			{
+				visible.push_back(node.children[child]);
+			}
+			else if (intersectingMask & bit)
+			{
+				stack.push_back(node.children[child]);
+			}
+			else
+			{
+				appendSubtree(node.children[child], visible);
+			}
+		}
+	}
+}
+
+void Bvh::appendSubtree(const uint32_t nodeIndex, std::vector<uint32_t>& visible) const
+{
+	const auto& node = nodes[nodeIndex];
+
+	for (auto mask = node.childMask; mask != 0; mask &= mask - 1)
+	{
+		const auto child = std::countr_zero(mask);
+
+		if (node.leafMask & (1u << child))
+		{
+			visible.push_back(node.children[child]);
+		}
+		else
+		{
+			appendSubtree(node.children[child], visible);
+		}
+	}
+}
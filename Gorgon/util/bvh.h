@@ -0,0 +1,48 @@
+#pragma once
+
+// Four-wide bounding volume hierarchy over axis aligned boxes, built once. Frustum
+// queries test the four children of a node at a time with SSE, and skip the plane
+// tests below nodes that are entirely inside.
+class Bvh
+{
+public:
+	struct Box
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	Bvh() = default;
+	explicit Bvh(const std::span<const Box> boxes);
+
+	// Appends the indices of the boxes intersecting the frustum, in no particular order.
+	// The planes point inwards, see getFrustumPlanes.
+	void cullFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& visible) const;
+
+private:
+	static constexpr auto WIDTH = 4u;
+
+	struct Node
+	{
+		// bounds of the children, one plane is tested against all of them at once
+		alignas(16) std::array<float, WIDTH> minX;
+		alignas(16) std::array<float, WIDTH> minY;
+		alignas(16) std::array<float, WIDTH> minZ;
+		alignas(16) std::array<float, WIDTH> maxX;
+		alignas(16) std::array<float, WIDTH> maxY;
+		alignas(16) std::array<float, WIDTH> maxZ;
+
+		// node index of inner children, box index of leaves
+		std::array<uint32_t, WIDTH> children;
+		uint32_t childMask; // bit per used child
+		uint32_t leafMask;
+	};
+
+	// range holds box indices, reordered while splitting
+	uint32_t build(const std::span<const Box> boxes, const std::span<uint32_t> range);
+
+	// for nodes entirely inside the frustum
+	void appendSubtree(const uint32_t nodeIndex, std::vector<uint32_t>& visible) const;
+
+	std::vector<Node> nodes;
+};
@@ -0,0 +1,39 @@
+#include "frustum.h"
+
+std::array<glm::vec4, 6> getFrustumPlanes(const glm::mat4& viewProj)
+{
+	const auto row = [&](const glm::length_t index) {
+		return glm::vec4(viewProj[0][index], viewProj[1][index], viewProj[2][index], viewProj[3][index]);
+	};
+
+	// Gribb/Hartmann, a point is inside when -w <= x, y <= w and 0 <= z <= w
+	auto planes = std::to_array({
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		row(2),
+		row(3) - row(2),
+	});
+
+	for (auto& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return planes;
+}
+
+glm::vec3 getCameraPosition(const glm::mat4& viewProj)
+{
+	// the only point projected to x = y = w = 0
+	const auto eye = glm::inverse(viewProj) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+
+	return glm::vec3(eye) / eye.w;
+}
+
+float getProjectionScale(const glm::mat4& viewProj)
+{
+	// the y row of the projection times the view's rotation, which keeps its length
+	return glm::length(glm::vec3(viewProj[0][1], viewProj[1][1], viewProj[2][1]));
+}
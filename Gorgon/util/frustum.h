@@ -0,0 +1,13 @@
+#pragma once
+
+// Planes of the view frustum in the space viewProj transforms from, normalized and
+// pointing inwards, in the order left, right, bottom, top, near, far. Expects clip
+// space depth from 0 to 1.
+std::array<glm::vec4, 6> getFrustumPlanes(const glm::mat4& viewProj);
+
+// Eye position of a perspective viewProj, in the space it transforms from
+glm::vec3 getCameraPosition(const glm::mat4& viewProj);
+
+// Clip space y per unit of view space y at distance 1 of a perspective viewProj, the cotangent
+// of half the vertical field of view. Assumes a view without scale.
+float getProjectionScale(const glm::mat4& viewProj);
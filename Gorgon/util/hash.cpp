@@ -0,0 +1,96 @@
+#include "hash.h"
+
+namespace
+{
+
+constexpr auto PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr auto PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr auto PRIME3 = 0x165667B19E3779F9ull;
+constexpr auto PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr auto PRIME5 = 0x27D4EB2F165667C5ull;
+
+template<typename T>
+T read(const std::byte* data)
+{
+	auto result = T{};
+	std::memcpy(&result, data, sizeof(T));
+	return result;
+}
+
+uint64_t accumulate(uint64_t accumulator, const uint64_t input)
+{
+	accumulator += input * PRIME2;
+	accumulator = std::rotl(accumulator, 31);
+	return accumulator * PRIME1;
+}
+
+uint64_t mergeRound(uint64_t accumulator, const uint64_t value)
+{
+	accumulator ^= accumulate(0, value);
+	return accumulator * PRIME1 + PRIME4;
+}
+
+}
+
+uint64_t hashBytes(const std::span<const std::byte> data, const uint64_t seed)
+{
+	auto* ptr = data.data();
+	const auto* const end = ptr + data.size();
+
+	auto result = uint64_t{};
+
+	if (data.size() >= 32)
+	{
+		auto v1 = seed + PRIME1 + PRIME2;
+		auto v2 = seed + PRIME2;
+		auto v3 = seed;
+		auto v4 = seed - PRIME1;
+
+		for (; ptr + 32 <= end; ptr += 32)
+		{
+			v1 = accumulate(v1, read<uint64_t>(ptr));
+			v2 = accumulate(v2, read<uint64_t>(ptr + 8));
+			v3 = accumulate(v3, read<uint64_t>(ptr + 16));
+			v4 = accumulate(v4, read<uint64_t>(ptr + 24));
+		}
+
+		result = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+		result = mergeRound(result, v1);
+		result = mergeRound(result, v2);
+		result = mergeRound(result, v3);
+		result = mergeRound(result, v4);
+	}
+	else
+	{
+		result = seed + PRIME5;
+	}
+
+	result += data.size();
+
+	for (; ptr + 8 <= end; ptr += 8)
+	{
+		result ^= accumulate(0, read<uint64_t>(ptr));
+		result = std::rotl(result, 27) * PRIME1 + PRIME4;
+	}
+
+	if (ptr + 4 <= end)
+	{
+		result ^= read<uint32_t>(ptr) * PRIME1;
+		result = std::rotl(result, 23) * PRIME2 + PRIME3;
+		ptr += 4;
+	}
+
+	for (; ptr < end; ++ptr)
+	{
+		result ^= std::to_integer<uint64_t>(*ptr) * PRIME5;
+		result = std::rotl(result, 11) * PRIME1;
+	}
+
+	result ^= result >> 33;
+	result *= PRIME2;
+	result ^= result >> 29;
+	result *= PRIME3;
+	result ^= result >> 32;
+
+	return result;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// 64-bit XXH64 of a byte range. Fast enough to key caches on whole file contents.
+uint64_t hashBytes(const std::span<const std::byte> data, const uint64_t seed = 0);
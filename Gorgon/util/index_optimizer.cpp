@@ -0,0 +1,359 @@
+#include "index_optimizer.h"
+
+namespace
+{
+
+constexpr auto NO_VERTEX = std::numeric_limits<uint32_t>::max();
+
+// A FIFO cache of VERTEX_CACHE_SIZE, a vertex is in it while fewer than that many others entered after it
+class VertexCache
+{
+public:
+	VertexCache(const uint32_t vertexCount) : timestamps(vertexCount) {}
+
+	bool contains(const uint32_t vertex) const { return time - timestamps[vertex] <= VERTEX_CACHE_SIZE; }
+
+	// how long the vertex has been in the cache
+	uint32_t getAge(const uint32_t vertex) const { return time - timestamps[vertex]; }
+
+	// true on a miss
+	bool access(const uint32_t vertex)
+	{
+		if (contains(vertex))
+		{
+			return false;
+		}
+
+		timestamps[vertex] = time++;
+		return true;
+	}
+
+	void flush() { time += VERTEX_CACHE_SIZE + 1; }
+
+private:
+	std::vector<uint32_t> timestamps;
+	uint32_t time = VERTEX_CACHE_SIZE + 1;
+};
+
+}
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other)
+{
+	triangleCount += other.triangleCount;
+	vertexCount += other.vertexCount;
+	missCount += other.missCount;
+
+	return *this;
+}
+
+double VertexCacheStats::getAcmr() const
+{
+	return triangleCount ? double(missCount) / double(triangleCount) : 0.0;
+}
+
+double VertexCacheStats::getAtvr() const
+{
+	return vertexCount ? double(missCount) / double(vertexCount) : 0.0;
+}
+
+VertexCacheStats getVertexCacheStats(const std::span<const uint32_t> indices, const uint32_t vertexCount)
+{
+	auto cache = VertexCache(vertexCount);
+	auto used = std::vector<bool>(vertexCount);
+
+	auto result = VertexCacheStats{ .triangleCount = indices.size() / 3 };
+
+	for (const auto vertex : indices)
+	{
+		result.missCount += cache.access(vertex);
+
+		if (not used[vertex])
+		{
+			used[vertex] = true;
+			++result.vertexCount;
+		}
+	}
+
+	return result;
+}
+
+void optimizeVertexCache(const std::span<uint32_t> indices, const uint32_t vertexCount, std::vector<uint32_t>& clusterStarts)
+{
+	assert(indices.size() % 3 == 0);
+
+	const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// triangles of each vertex, those of vertex v are at [offsets[v], offsets[v + 1])
+	auto offsets = std::vector<uint32_t>(vertexCount + 1);
+
+	for (const auto vertex : indices)
+	{
+		++offsets[vertex + 1];
+	}
+
+	std::inclusive_scan(offsets.begin(), offsets.end(), offsets.begin());
+
+	auto adjacency = std::vector<uint32_t>(indices.size());
+	{
+		auto next = offsets;
+
+		for (auto index = size_t(0); index < indices.size(); ++index)
+		{
+			adjacency[next[indices[index]]++] = static_cast<uint32_t>(index / 3);
+		}
+	}
+
+	// triangles of each vertex not emitted yet
+	auto liveCounts = std::views::iota(0u, vertexCount)
+		| std::views::transform([&](const uint32_t vertex) { return offsets[vertex + 1] - offsets[vertex]; })
+		| std::ranges::to<std::vector>();
+
+	auto emitted = std::vector<bool>(triangleCount);
+	auto deadEnds = std::vector<uint32_t>(); // vertices of emitted triangles, latest last
+	auto candidates = std::vector<uint32_t>();
+	auto cursor = 0u;
+	auto cache = VertexCache(vertexCount);
+
+	auto result = std::vector<uint32_t>();
+	result.reserve(indices.size());
+
+	const auto skipDeadEnd = [&] {
+		while (not deadEnds.empty())
+		{
+			const auto vertex = deadEnds.back();
+			deadEnds.pop_back();
+
+			if (liveCounts[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+
+		for (; cursor < vertexCount; ++cursor)
+		{
+			if (liveCounts[cursor] > 0)
+			{
+				return cursor;
+			}
+		}
+
+		return NO_VERTEX;
+	};
+
+	clusterStarts.clear();
+
+	auto fan = skipDeadEnd();
+
+	if (fan != NO_VERTEX)
+	{
+		clusterStarts.push_back(0);
+	}
+
+	while (fan != NO_VERTEX)
+	{
+		candidates.clear();
+
+		for (const auto triangle : std::span(adjacency).subspan(offsets[fan], offsets[fan + 1] - offsets[fan]))
+		{
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (const auto vertex : indices.subspan(triangle * 3, 3))
+			{
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				--liveCounts[vertex];
+				cache.access(vertex);
+			}
+
+			emitted[triangle] = true;
+		}
+
+		// the oldest candidate that is still cached once its remaining triangles went through
+		auto next = NO_VERTEX;
+		auto bestPriority = -1;
+
+		for (const auto vertex : candidates)
+		{
+			if (liveCounts[vertex] == 0)
+			{
+				continue;
+			}
+
+			const auto age = cache.getAge(vertex);
+			const auto priority = age + 2 * liveCounts[vertex] <= VERTEX_CACHE_SIZE ? static_cast<int>(age) : 0;
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == NO_VERTEX)
+		{
+			next = skipDeadEnd();
+
+			if (next != NO_VERTEX)
+			{
+				clusterStarts.push_back(static_cast<uint32_t>(result.size() / 3));
+			}
+		}
+
+		fan = next;
+	}
+
+	std::ranges::copy(result, indices.begin());
+}
+
+void optimizeOverdraw(
+	const std::span<uint32_t> indices,
+	const std::span<const uint32_t> clusterStarts,
+	const std::span<const glm::vec3> positions,
+	const float threshold)
+{
+	assert(indices.size() % 3 == 0);
+
+	const auto vertexCount = static_cast<uint32_t>(positions.size());
+	const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	const auto targetAcmr = getVertexCacheStats(indices, vertexCount).getAcmr() * threshold;
+
+	// soft boundaries inside the hard ones, the cache starts cold in each cluster
+	auto starts = std::vector<uint32_t>();
+	{
+		auto cache = VertexCache(vertexCount);
+
+		for (const auto& [index, begin] : std::views::enumerate(clusterStarts))
+		{
+			const auto end = index + 1 < std::ssize(clusterStarts) ? clusterStarts[index + 1] : triangleCount;
+
+			cache.flush();
+			starts.push_back(begin);
+
+			auto missCount = 0u;
+
+			for (auto triangle = begin; triangle < end; ++triangle)
+			{
+				for (const auto vertex : indices.subspan(triangle * 3, 3))
+				{
+					missCount += cache.access(vertex);
+				}
+
+				if (triangle + 1 < end && missCount <= targetAcmr * (triangle + 1 - starts.back()))
+				{
+					cache.flush();
+					starts.push_back(triangle + 1);
+					missCount = 0;
+				}
+			}
+		}
+	}
+
+	const auto getTriangle = [&](const uint32_t triangle) {
+		return std::array{
+			positions[indices[triangle * 3]],
+			positions[indices[triangle * 3 + 1]],
+			positions[indices[triangle * 3 + 2]],
+		};
+	};
+
+	// area weighted centroid of the mesh
+	const auto center = [&] {
+		auto sum = glm::dvec3(0.0);
+		auto areaSum = 0.0;
+
+		for (auto triangle = 0u; triangle < triangleCount; ++triangle)
+		{
+			const auto [a, b, c] = getTriangle(triangle);
+			const auto area = double(glm::length(glm::cross(b - a, c - a)));
+
+			sum += glm::dvec3(a + b + c) / 3.0 * area;
+			areaSum += area;
+		}
+
+		return areaSum > 0.0 ? glm::vec3(sum / areaSum) : glm::vec3(0.0f);
+	}();
+
+	// how far a cluster faces away from the center
+	const auto getSortKey = [&](const uint32_t begin, const uint32_t end) {
+		auto centroid = glm::dvec3(0.0);
+		auto normal = glm::dvec3(0.0);
+		auto areaSum = 0.0;
+
+		for (auto triangle = begin; triangle < end; ++triangle)
+		{
+			const auto [a, b, c] = getTriangle(triangle);
+			const auto cross = glm::dvec3(glm::cross(b - a, c - a));
+			const auto area = glm::length(cross);
+
+			centroid += glm::dvec3(a + b + c) / 3.0 * area;
+			normal += cross;
+			areaSum += area;
+		}
+
+		const auto normalLength = glm::length(normal);
+
+		if (areaSum == 0.0 || normalLength == 0.0)
+		{
+			return 0.0;
+		}
+
+		return glm::dot(centroid / areaSum - glm::dvec3(center), normal / normalLength);
+	};
+
+	struct Cluster
+	{
+		double sortKey;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	auto clusters = std::views::iota(size_t(0), starts.size())
+		| std::views::transform([&](const size_t index) {
+			const auto begin = starts[index];
+			const auto end = index + 1 < starts.size() ? starts[index + 1] : triangleCount;
+
+			return Cluster{ .sortKey = getSortKey(begin, end), .begin = begin, .end = end };
+		})
+		| std::ranges::to<std::vector>();
+
+	std::ranges::stable_sort(clusters, std::ranges::greater(), &Cluster::sortKey);
+
+	auto result = std::vector<uint32_t>();
+	result.reserve(indices.size());
+
+	for (const auto& cluster : clusters)
+	{
+		result.append_range(indices.subspan(cluster.begin * 3, (cluster.end - cluster.begin) * 3));
+	}
+
+	std::ranges::copy(result, indices.begin());
+}
+
+std::vector<uint32_t> optimizeVertexFetch(const std::span<uint32_t> indices, const uint32_t vertexCount)
+{
+	auto remap = std::vector<uint32_t>(vertexCount, NO_VERTEX);
+	auto result = std::vector<uint32_t>();
+
+	for (auto& vertex : indices)
+	{
+		if (remap[vertex] == NO_VERTEX)
+		{
+			remap[vertex] = static_cast<uint32_t>(result.size());
+			result.push_back(vertex);
+		}
+
+		vertex = remap[vertex];
+	}
+
+	return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// entries of the FIFO post-transform vertex cache the optimization and the statistics assume
+constexpr auto VERTEX_CACHE_SIZE = uint32_t(16);
+
+// How often the vertices of indexed triangle lists miss a VERTEX_CACHE_SIZE FIFO cache
+struct VertexCacheStats
+{
+	uint64_t triangleCount;
+	uint64_t vertexCount; // referenced by the indices
+	uint64_t missCount;
+
+	VertexCacheStats& operator+=(const VertexCacheStats& other);
+
+	double getAcmr() const; // misses per triangle, 0.5 at best for large meshes
+	double getAtvr() const; // misses per vertex, 1 at best
+};
+
+VertexCacheStats getVertexCacheStats(const std::span<const uint32_t> indices, const uint32_t vertexCount);
+
+// Reorders the triangles with Tipsify: fans around a vertex still in the cache, and restarts from
+// the latest dead end once no neighbour would stay there. clusterStarts gets the first triangle
+// of each restart, where the cache is cold anyway and the order can change without cost.
+void optimizeVertexCache(const std::span<uint32_t> indices, const uint32_t vertexCount, std::vector<uint32_t>& clusterStarts);
+
+// Splits the clusters of optimizeVertexCache further wherever the cache misses so far stay within
+// threshold times the ACMR of the whole, then draws the clusters facing away from the center of
+// the mesh first, since they are the likeliest to hide the rest.
+void optimizeOverdraw(
+	const std::span<uint32_t> indices,
+	const std::span<const uint32_t> clusterStarts,
+	const std::span<const glm::vec3> positions,
+	const float threshold);
+
+// Renumbers the vertices in the order the indices first use them and drops the unused ones.
+// Returns the old vertex of each new one, to lay the vertex data out the same way.
+std::vector<uint32_t> optimizeVertexFetch(const std::span<uint32_t> indices, const uint32_t vertexCount);
@@ -0,0 +1,157 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+[[noreturn]] void throwError(const std::string_view what, const std::filesystem::path& path)
+{
+#ifdef _WIN32
+	const auto error = std::error_code(static_cast<int>(GetLastError()), std::system_category());
+#else
+	const auto error = std::error_code(errno, std::generic_category());
+#endif
+
+	throw std::system_error(error, fmt::format("{} {}", what, path.generic_string()));
+}
+
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+	const auto file = CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		nullptr
+	);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throwError("cannot open", path);
+	}
+
+	const auto fileGuard = boost::scope::scope_exit([&] { CloseHandle(file); });
+
+	LARGE_INTEGER fileSize;
+	if (not GetFileSizeEx(file, &fileSize))
+	{
+		throwError("cannot get the size of", path);
+	}
+
+	size = static_cast<size_t>(fileSize.QuadPart);
+
+	if (not size)
+	{
+		return;
+	}
+
+	const auto fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (not fileMapping)
+	{
+		throwError("cannot map", path);
+	}
+
+	// the view keeps the mapping object alive
+	const auto fileMappingGuard = boost::scope::scope_exit([&] { CloseHandle(fileMapping); });
+
+	const auto view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (not view)
+	{
+		throwError("cannot map", path);
+	}
+
+	mapping = static_cast<const std::byte*>(view);
+#else
+	const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd == -1)
+	{
+		throwError("cannot open", path);
+	}
+
+	const auto fdGuard = boost::scope::scope_exit([&] { close(fd); });
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		throwError("cannot get the size of", path);
+	}
+
+	size = static_cast<size_t>(fileStat.st_size);
+
+	if (not size)
+	{
+		return;
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	const auto result = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (result == MAP_FAILED)
+	{
+		throwError("cannot map", path);
+	}
+
+	mapping = static_cast<const std::byte*>(result);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+	: mapping(std::exchange(rhs.mapping, nullptr))
+	, size(std::exchange(rhs.size, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		unmap();
+		mapping = std::exchange(rhs.mapping, nullptr);
+		size = std::exchange(rhs.size, 0);
+	}
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+std::span<const std::byte> MappedFile::data() const
+{
+	return std::span(mapping, mapping ? size : 0);
+}
+
+void MappedFile::unmap()
+{
+	if (not mapping)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+#else
+	munmap(const_cast<std::byte*>(mapping), size);
+#endif
+
+	mapping = nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	// throws std::system_error if the file can't be opened or mapped
+	MappedFile(const std::filesystem::path& path);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+
+	~MappedFile();
+
+	std::span<const std::byte> data() const;
+
+private:
+	void unmap();
+
+	const std::byte* mapping = nullptr;
+	size_t size = 0;
+};
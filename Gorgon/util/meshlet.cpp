@@ -0,0 +1,148 @@
+#include "meshlet.h"
+
+namespace
+{
+
+constexpr auto UNUSED_LOCAL_INDEX = uint8_t(0xFF);
+
+static_assert(MESHLET_MAX_VERTICES < UNUSED_LOCAL_INDEX);
+
+// bounding sphere and normal cone of the meshlet's triangles
+void computeBounds(Meshlet& meshlet, const MeshletData& data, const std::span<const glm::vec3> positions)
+{
+	const auto vertices = std::span(data.vertices).subspan(meshlet.firstVertex, meshlet.vertexCount);
+	const auto triangles = std::span(data.triangles).subspan(meshlet.firstTriangle, meshlet.triangleCount);
+
+	auto min = glm::vec3(std::numeric_limits<float>::max());
+	auto max = glm::vec3(std::numeric_limits<float>::lowest());
+
+	for (const auto vertex : vertices)
+	{
+		min = glm::min(min, positions[vertex]);
+		max = glm::max(max, positions[vertex]);
+	}
+
+	meshlet.center = (min + max) * 0.5f;
+	meshlet.radius = 0.0f;
+
+	for (const auto vertex : vertices)
+	{
+		meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.center, positions[vertex]));
+	}
+
+	// zero for degenerate triangles, which face nowhere
+	const auto getNormal = [&](const uint32_t triangle) {
+		const auto corner = [&](const uint32_t index) {
+			return positions[vertices[(triangle >> (index * 8)) & 0xFF]];
+		};
+
+		const auto normal = glm::cross(corner(1) - corner(0), corner(2) - corner(0));
+		const auto length = glm::length(normal);
+
+		return length > 0.0f ? normal / length : glm::vec3(0.0f);
+	};
+
+	auto normalSum = glm::vec3(0.0f);
+
+	for (const auto triangle : triangles)
+	{
+		normalSum += getNormal(triangle);
+	}
+
+	const auto sumLength = glm::length(normalSum);
+
+	if (sumLength == 0.0f)
+	{
+		meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+		meshlet.coneCutoff = 1.0f;
+		return;
+	}
+
+	meshlet.coneAxis = normalSum / sumLength;
+
+	auto minDot = 1.0f;
+
+	for (const auto triangle : triangles)
+	{
+		if (const auto normal = getNormal(triangle); normal != glm::vec3(0.0f))
+		{
+			minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normal));
+		}
+	}
+
+	// a cone wider than a hemisphere never faces away as a whole
+	meshlet.coneCutoff = minDot > 0.0f ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+}
+
+}
+
+uint32_t buildMeshlets(const std::span<const uint32_t> indices, const std::span<const glm::vec3> positions, MeshletData& data)
+{
+	assert(indices.size() % 3 == 0);
+
+	const auto firstMeshlet = data.meshlets.size();
+
+	// of the vertices in the open meshlet, UNUSED_LOCAL_INDEX for the rest
+	auto localIndices = std::vector<uint8_t>(positions.size(), UNUSED_LOCAL_INDEX);
+
+	const auto openMeshlet = [&] {
+		return Meshlet{
+			.firstVertex = static_cast<uint32_t>(data.vertices.size()),
+			.firstTriangle = static_cast<uint32_t>(data.triangles.size()),
+		};
+	};
+
+	auto meshlet = openMeshlet();
+
+	const auto closeMeshlet = [&] {
+		if (meshlet.triangleCount == 0)
+		{
+			return;
+		}
+
+		for (const auto vertex : std::span(data.vertices).subspan(meshlet.firstVertex))
+		{
+			localIndices[vertex] = UNUSED_LOCAL_INDEX;
+		}
+
+		computeBounds(meshlet, data, positions);
+		data.meshlets.push_back(meshlet);
+
+		meshlet = openMeshlet();
+	};
+
+	for (auto first = size_t(0); first < indices.size(); first += 3)
+	{
+		const auto triangle = indices.subspan(first, 3);
+
+		// counts a repeated vertex of a degenerate triangle twice, which only closes early
+		const auto newVertexCount = static_cast<uint32_t>(std::ranges::count(triangle, UNUSED_LOCAL_INDEX, [&](const uint32_t vertex) {
+			return localIndices[vertex];
+		}));
+
+		if (meshlet.vertexCount + newVertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount == MESHLET_MAX_TRIANGLES)
+		{
+			closeMeshlet();
+		}
+
+		auto packed = uint32_t(0);
+
+		for (const auto& [corner, vertex] : std::views::enumerate(triangle))
+		{
+			if (localIndices[vertex] == UNUSED_LOCAL_INDEX)
+			{
+				localIndices[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+				data.vertices.push_back(vertex);
+			}
+
+			packed |= uint32_t(localIndices[vertex]) << (corner * 8);
+		}
+
+		data.triangles.push_back(packed);
+		++meshlet.triangleCount;
+	}
+
+	closeMeshlet();
+
+	return static_cast<uint32_t>(data.meshlets.size() - firstMeshlet);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <shaders/shared.inl>
+
+// Meshlets of the primitives of an asset, laid out the way the cluster culling pass reads them
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices; // vertex indices of the primitive
+	std::vector<uint32_t> triangles; // three 8 bit indices into the meshlet's vertices
+};
+
+// Appends the meshlets of an indexed triangle list and returns how many. Triangles are
+// taken in index order and a meshlet is closed once the next one doesn't fit, so the
+// meshlets are as compact as the index order is.
+uint32_t buildMeshlets(const std::span<const uint32_t> indices, const std::span<const glm::vec3> positions, MeshletData& data);
@@ -0,0 +1,80 @@
+#include "radix_sort.h"
+
+namespace
+{
+
+constexpr auto RADIX_BITS = 8u;
+constexpr auto RADIX_SIZE = size_t(1) << RADIX_BITS;
+constexpr auto PASS_COUNT = sizeof(uint64_t) * 8 / RADIX_BITS;
+
+size_t getDigit(const uint64_t key, const size_t pass)
+{
+	return (key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+}
+
+}
+
+void radixSort(
+	const std::span<uint64_t> keys,
+	const std::span<uint32_t> values,
+	const std::span<uint64_t> keysScratch,
+	const std::span<uint32_t> valuesScratch)
+{
+	const auto count = keys.size();
+
+	assert(values.size() == count);
+	assert(keysScratch.size() >= count && valuesScratch.size() >= count);
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	// every histogram in a single read of the keys
+	auto histograms = std::array<std::array<size_t, RADIX_SIZE>, PASS_COUNT>{};
+
+	for (const auto key : keys)
+	{
+		for (auto pass = size_t(0); pass < PASS_COUNT; ++pass)
+		{
+			++histograms[pass][getDigit(key, pass)];
+		}
+	}
+
+	auto srcKeys = keys;
+	auto srcValues = values;
+	auto dstKeys = keysScratch.first(count);
+	auto dstValues = valuesScratch.first(count);
+
+	for (auto pass = size_t(0); pass < PASS_COUNT; ++pass)
+	{
+		auto& histogram = histograms[pass];
+
+		// all keys share this digit
+		if (histogram[getDigit(keys.front(), pass)] == count)
+		{
+			continue;
+		}
+
+		// histogram to bucket offsets
+		std::exclusive_scan(histogram.begin(), histogram.end(), histogram.begin(), size_t(0));
+
+		for (auto index = size_t(0); index < count; ++index)
+		{
+			const auto key = srcKeys[index];
+			const auto target = histogram[getDigit(key, pass)]++;
+
+			dstKeys[target] = key;
+			dstValues[target] = srcValues[index];
+		}
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+	}
+
+	if (srcKeys.data() != keys.data())
+	{
+		std::ranges::copy(srcKeys, keys.begin());
+		std::ranges::copy(srcValues, values.begin());
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Sorts keys ascending and permutes values alongside them. LSD radix sort on bytes,
+// stable, passes over bytes that every key shares are skipped.
+// The scratch spans must be at least as large as the input.
+void radixSort(
+	const std::span<uint64_t> keys,
+	const std::span<uint32_t> values,
+	const std::span<uint64_t> keysScratch,
+	const std::span<uint32_t> valuesScratch);
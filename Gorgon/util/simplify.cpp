@@ -0,0 +1,389 @@
+#include "simplify.h"
+#include "index_optimizer.h"
+
+namespace
+{
+
+// fewest triangles a simplified level is built with
+constexpr auto MIN_LOD_TRIANGLES = size_t(32);
+
+// a level that keeps more of the one before is not worth its indices
+constexpr auto MAX_LOD_RATIO = 0.75;
+
+// Sum of squared distances to a set of planes, a symmetric 4x4 matrix stored as its upper triangle
+struct Quadric
+{
+	std::array<double, 10> values{};
+
+	static Quadric fromPlane(const glm::dvec3& normal, const double distance)
+	{
+		const auto [a, b, c] = std::array{ normal.x, normal.y, normal.z };
+		const auto d = distance;
+
+		return Quadric{ .values = {
+			a * a, a * b, a * c, a * d,
+			b * b, b * c, b * d,
+			c * c, c * d,
+			d * d,
+		} };
+	}
+
+	Quadric& operator+=(const Quadric& other)
+	{
+		for (auto&& [value, otherValue] : std::views::zip(values, other.values))
+		{
+			value += otherValue;
+		}
+
+		return *this;
+	}
+
+	double evaluate(const glm::vec3& position) const
+	{
+		const auto [x, y, z] = std::array<double, 3>{ position.x, position.y, position.z };
+		const auto& q = values;
+
+		const auto result = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+			+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+			+ q[7] * z * z + 2 * q[8] * z
+			+ q[9];
+
+		return std::max(result, 0.0);
+	}
+};
+
+// merging from into to
+struct Collapse
+{
+	double cost;
+	uint32_t from;
+	uint32_t to;
+	uint32_t toVersion; // the collapse is stale once to's quadric changed
+};
+
+}
+
+float simplify(
+	const std::span<const uint32_t> indices,
+	const std::span<const glm::vec3> positions,
+	const size_t targetIndexCount,
+	std::vector<uint32_t>& result)
+{
+	assert(indices.size() % 3 == 0);
+
+	const auto vertexCount = static_cast<uint32_t>(positions.size());
+
+	// vertices sharing a position get the first of them, seams are where there are several
+	auto canonical = std::vector<uint32_t>(vertexCount);
+	auto locked = std::vector<bool>(vertexCount);
+	{
+		auto order = std::views::iota(0u, vertexCount) | std::ranges::to<std::vector>();
+
+		const auto getKey = [&](const uint32_t vertex) {
+			const auto& position = positions[vertex];
+			return std::tuple(position.x, position.y, position.z);
+		};
+
+		std::ranges::sort(order, {}, getKey);
+
+		for (auto first = size_t(0); first < order.size();)
+		{
+			auto last = first + 1;
+
+			while (last < order.size() && getKey(order[last]) == getKey(order[first]))
+			{
+				++last;
+			}
+
+			for (const auto vertex : std::span(order).subspan(first, last - first))
+			{
+				canonical[vertex] = order[first];
+				locked[vertex] = last - first > 1;
+			}
+
+			first = last;
+		}
+	}
+
+	// degenerate triangles cover nothing and are dropped
+	auto triangles = std::vector<std::array<uint32_t, 3>>();
+	triangles.reserve(indices.size() / 3);
+
+	for (auto first = size_t(0); first < indices.size(); first += 3)
+	{
+		const auto triangle = std::array{ indices[first], indices[first + 1], indices[first + 2] };
+		const auto [a, b, c] = std::array{ canonical[triangle[0]], canonical[triangle[1]], canonical[triangle[2]] };
+
+		if (a != b && b != c && c != a)
+		{
+			triangles.push_back(triangle);
+		}
+	}
+
+	auto alive = std::vector<bool>(triangles.size(), true);
+	auto aliveCount = triangles.size();
+
+	auto adjacency = std::vector<std::vector<uint32_t>>(vertexCount); // triangles of each vertex
+	auto quadrics = std::vector<Quadric>(vertexCount);
+
+	// twice the area long, zero for degenerate triangles
+	const auto getNormal = [&](const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		return glm::cross(glm::dvec3(b - a), glm::dvec3(c - a));
+	};
+
+	// the edges of a closed surface are each shared by two triangles, any other edge is a border
+	{
+		auto edgeCounts = std::unordered_map<uint64_t, uint32_t>();
+
+		for (const auto& [index, triangle] : std::views::enumerate(triangles))
+		{
+			const auto normal = getNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+			const auto length = glm::length(normal);
+
+			// unweighted by area, so the error stays a distance
+			const auto quadric = length > 0.0 ?
+				Quadric::fromPlane(normal / length, -glm::dot(normal / length, glm::dvec3(positions[triangle[0]]))) :
+				Quadric();
+
+			for (auto corner = 0; corner < 3; ++corner)
+			{
+				const auto vertex = triangle[corner];
+				const auto a = canonical[vertex];
+				const auto b = canonical[triangle[(corner + 1) % 3]];
+
+				adjacency[vertex].push_back(static_cast<uint32_t>(index));
+				quadrics[vertex] += quadric;
+				++edgeCounts[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)];
+			}
+		}
+
+		for (const auto& [vertex, triangleIndices] : std::views::enumerate(adjacency))
+		{
+			for (const auto triangleIndex : triangleIndices)
+			{
+				const auto& triangle = triangles[triangleIndex];
+
+				for (const auto other : triangle)
+				{
+					const auto a = canonical[vertex];
+					const auto b = canonical[other];
+
+					if (a != b && edgeCounts[(uint64_t(std::min(a, b)) << 32) | std::max(a, b)] != 2)
+					{
+						locked[vertex] = true;
+					}
+				}
+			}
+		}
+	}
+
+	auto collapsed = std::vector<bool>(vertexCount);
+	auto versions = std::vector<uint32_t>(vertexCount);
+	auto heap = std::vector<Collapse>(); // cheapest first
+
+	const auto push = [&](const uint32_t from, const uint32_t to) {
+		if (locked[from] || collapsed[from] || collapsed[to])
+		{
+			return;
+		}
+
+		auto quadric = quadrics[from];
+		quadric += quadrics[to];
+
+		heap.push_back({ .cost = quadric.evaluate(positions[to]), .from = from, .to = to, .toVersion = versions[to] });
+		std::ranges::push_heap(heap, std::ranges::greater(), &Collapse::cost);
+	};
+
+	for (const auto& triangle : triangles)
+	{
+		for (auto corner = 0; corner < 3; ++corner)
+		{
+			push(triangle[corner], triangle[(corner + 1) % 3]);
+			push(triangle[(corner + 1) % 3], triangle[corner]);
+		}
+	}
+
+	const auto contains = [&](const std::array<uint32_t, 3>& triangle, const uint32_t vertex) {
+		return std::ranges::any_of(triangle, [&](const uint32_t other) { return canonical[other] == canonical[vertex]; });
+	};
+
+	// neighbours around a vertex, by position
+	const auto getRing = [&](const uint32_t vertex) {
+		auto ring = std::vector<uint32_t>();
+
+		for (const auto triangleIndex : adjacency[vertex])
+		{
+			if (alive[triangleIndex])
+			{
+				for (const auto other : triangles[triangleIndex])
+				{
+					if (canonical[other] != canonical[vertex])
+					{
+						ring.push_back(canonical[other]);
+					}
+				}
+			}
+		}
+
+		std::ranges::sort(ring);
+		ring.erase(std::ranges::unique(ring).begin(), ring.end());
+
+		return ring;
+	};
+
+	// keeps the surface a manifold without flipped or degenerate triangles
+	const auto isValid = [&](const uint32_t from, const uint32_t to) {
+		auto sharedTriangles = 0u;
+
+		for (const auto triangleIndex : adjacency[from])
+		{
+			if (not alive[triangleIndex])
+			{
+				continue;
+			}
+
+			const auto& triangle = triangles[triangleIndex];
+
+			if (contains(triangle, to))
+			{
+				++sharedTriangles;
+				continue;
+			}
+
+			const auto moved = triangle
+				| std::views::transform([&](const uint32_t vertex) { return vertex == from ? positions[to] : positions[vertex]; })
+				| std::ranges::to<std::vector>();
+
+			const auto before = getNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+			const auto after = getNormal(moved[0], moved[1], moved[2]);
+
+			if (glm::dot(before, after) <= 0.0)
+			{
+				return false;
+			}
+		}
+
+		// neighbours of both other than the opposite corners of the edge would pinch the surface
+		const auto fromRing = getRing(from);
+		const auto toRing = getRing(to);
+
+		auto common = std::vector<uint32_t>();
+		std::ranges::set_intersection(fromRing, toRing, std::back_inserter(common));
+
+		return common.size() <= sharedTriangles;
+	};
+
+	auto maxCost = 0.0;
+
+	while (aliveCount * 3 > targetIndexCount && not heap.empty())
+	{
+		std::ranges::pop_heap(heap, std::ranges::greater(), &Collapse::cost);
+		const auto collapse = heap.back();
+		heap.pop_back();
+
+		const auto [cost, from, to, toVersion] = collapse;
+
+		if (collapsed[from] || collapsed[to] || versions[to] != toVersion || not isValid(from, to))
+		{
+			continue;
+		}
+
+		for (const auto triangleIndex : adjacency[from])
+		{
+			if (not alive[triangleIndex])
+			{
+				continue;
+			}
+
+			auto& triangle = triangles[triangleIndex];
+
+			if (contains(triangle, to))
+			{
+				alive[triangleIndex] = false;
+				--aliveCount;
+			}
+			else
+			{
+				std::ranges::replace(triangle, from, to);
+				adjacency[to].push_back(triangleIndex);
+			}
+		}
+
+		adjacency[from].clear();
+		collapsed[from] = true;
+		quadrics[to] += quadrics[from];
+		++versions[to];
+		maxCost = std::max(maxCost, cost);
+
+		std::erase_if(adjacency[to], [&](const uint32_t triangleIndex) { return not alive[triangleIndex]; });
+
+		// the collapses into and out of to changed cost
+		for (const auto triangleIndex : adjacency[to])
+		{
+			for (const auto other : triangles[triangleIndex])
+			{
+				if (other != to)
+				{
+					push(other, to);
+					push(to, other);
+				}
+			}
+		}
+	}
+
+	result.clear();
+	result.reserve(aliveCount * 3);
+
+	for (const auto& [triangle, isAlive] : std::views::zip(triangles, alive))
+	{
+		if (isAlive)
+		{
+			result.append_range(triangle);
+		}
+	}
+
+	return static_cast<float>(std::sqrt(maxCost));
+}
+
+LodChain buildLodChain(const std::span<const uint32_t> indices, const std::span<const glm::vec3> positions)
+{
+	auto chain = LodChain{
+		.lods = { Lod{ .firstIndex = 0, .indexCount = static_cast<uint32_t>(indices.size()), .error = 0.0f } },
+		.indices = indices | std::ranges::to<std::vector>(),
+	};
+
+	auto level = chain.indices;
+	auto next = std::vector<uint32_t>();
+	auto clusterStarts = std::vector<uint32_t>();
+	auto error = 0.0f;
+
+	while (chain.lods.size() < LOD_MAX_COUNT)
+	{
+		const auto targetTriangleCount = level.size() / 3 / 2;
+
+		if (targetTriangleCount < MIN_LOD_TRIANGLES)
+		{
+			break;
+		}
+
+		error += simplify(level, positions, targetTriangleCount * 3, next);
+
+		if (double(next.size()) > double(level.size()) * MAX_LOD_RATIO)
+		{
+			break;
+		}
+
+		optimizeVertexCache(next, static_cast<uint32_t>(positions.size()), clusterStarts);
+
+		chain.lods.push_back(Lod{
+			.firstIndex = static_cast<uint32_t>(chain.indices.size()),
+			.indexCount = static_cast<uint32_t>(next.size()),
+			.error = error,
+		});
+
+		chain.indices.append_range(next);
+		std::swap(level, next);
+	}
+
+	return chain;
+}
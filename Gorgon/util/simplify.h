@@ -0,0 +1,26 @@
+#pragma once
+#include <shaders/shared.inl>
+
+// Levels of detail of an indexed triangle list, laid out the way the draws read them
+struct LodChain
+{
+	std::vector<Lod> lods; // the full mesh first
+	std::vector<uint32_t> indices; // of every level, back to back
+};
+
+// Collapses edges of an indexed triangle list in order of least quadric error, until at most
+// targetIndexCount indices are left or no collapse keeps the surface intact. Vertices on open
+// borders and on attribute seams, where vertices share a position, never move, so a level keeps
+// the outline and the UV and normal splits of the mesh. A collapse merges a vertex into a
+// neighbour, the result indexes the same vertices. Returns the error, a distance in the space
+// of the positions.
+float simplify(
+	const std::span<const uint32_t> indices,
+	const std::span<const glm::vec3> positions,
+	const size_t targetIndexCount,
+	std::vector<uint32_t>& result);
+
+// Each level has about half the triangles of the one before, until LOD_MAX_COUNT levels or
+// until the locked vertices keep a level from getting much smaller. A level's error adds up
+// the errors of the levels before it. The simplified levels are ordered for the vertex cache.
+LodChain buildLodChain(const std::span<const uint32_t> indices, const std::span<const glm::vec3> positions);
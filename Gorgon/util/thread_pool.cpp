@@ -0,0 +1,48 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(const uint32_t threadCount)
+{
+	threads.reserve(threadCount);
+
+	for (auto i = 0u; i < threadCount; ++i)
+	{
+		threads.emplace_back([this](const std::stop_token& stopToken) { workerLoop(stopToken); });
+	}
+}
+
+uint32_t ThreadPool::size() const
+{
+	return static_cast<uint32_t>(threads.size());
+}
+
+void ThreadPool::enqueue(std::move_only_function<void()>&& task)
+{
+	{
+		const auto lock = std::scoped_lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+
+	condition.notify_one();
+}
+
+void ThreadPool::workerLoop(const std::stop_token& stopToken)
+{
+	while (true)
+	{
+		auto task = std::move_only_function<void()>();
+
+		{
+			auto lock = std::unique_lock(mutex);
+
+			if (not condition.wait(lock, stopToken, [&] { return not tasks.empty(); }))
+			{
+				return; // stop requested
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
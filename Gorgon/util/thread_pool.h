@@ -0,0 +1,104 @@
+#pragma once
+
+class ThreadPool
+{
+public:
+	ThreadPool(const uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u));
+	ThreadPool(const ThreadPool&) = delete;
+
+	uint32_t size() const;
+
+	template<typename Func>
+	auto submit(Func&& func) -> std::future<std::invoke_result_t<Func&>>;
+
+	// Calls func(index) for every index in [0, count) and waits for completion.
+	// The calling thread takes part, so it's safe to call from inside a pool task.
+	template<typename Func>
+	void parallelFor(const size_t count, Func&& func);
+
+private:
+	void enqueue(std::move_only_function<void()>&& task);
+	void workerLoop(const std::stop_token& stopToken);
+
+	std::mutex mutex;
+	std::condition_variable_any condition;
+	std::deque<std::move_only_function<void()>> tasks;
+
+	// destroyed first: requests stop and joins before the queue goes away
+	std::vector<std::jthread> threads;
+};
+
+template<typename Func>
+auto ThreadPool::submit(Func&& func) -> std::future<std::invoke_result_t<Func&>>
+{
+	auto task = std::packaged_task<std::invoke_result_t<Func&>()>(std::forward<Func>(func));
+	auto future = task.get_future();
+
+	enqueue([task = std::move(task)]() mutable { task(); });
+
+	return future;
+}
+
+template<typename Func>
+void ThreadPool::parallelFor(const size_t count, Func&& func)
+{
+	if (not count)
+	{
+		return;
+	}
+
+	// shared with helper tasks which may start after the loop below has already finished
+	struct State
+	{
+		std::atomic<size_t> next = 0;
+		std::atomic<size_t> done = 0;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::exception_ptr exception;
+	};
+
+	const auto state = std::make_shared<State>();
+
+	const auto work = [state, count, &func] {
+		for (auto index = state->next++; index < count; index = state->next++)
+		{
+			try
+			{
+				func(index);
+			}
+			catch (...)
+			{
+				const auto lock = std::scoped_lock(state->mutex);
+				if (not state->exception)
+				{
+					state->exception = std::current_exception();
+				}
+			}
+
+			if (++state->done == count)
+			{
+				const auto lock = std::scoped_lock(state->mutex);
+				state->condition.notify_all();
+			}
+		}
+	};
+
+	const auto helperCount = std::min<size_t>(count, size()) - 1;
+
+	for (auto i = size_t(0); i < helperCount; ++i)
+	{
+		enqueue(work);
+	}
+
+	work();
+
+	{
+		auto lock = std::unique_lock(state->mutex);
+		state->condition.wait(lock, [&] { return state->done == count; });
+
+		if (state->exception)
+		{
+			std::rethrow_exception(state->exception);
+		}
+	}
+}
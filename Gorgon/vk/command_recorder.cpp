@@ -0,0 +1,222 @@
+#include "command_recorder.h"
+
+CommandRecorder::CommandRecorder(const vk::raii::CommandBuffer& commandBuffer)
+	: commandBuffer(commandBuffer)
+{}
+
+void CommandRecorder::bindPipeline(const vk::Pipeline value)
+{
+	if (update(pipeline, value))
+	{
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, value);
+	}
+}
+
+void CommandRecorder::pushConstants(
+	const vk::PipelineLayout layout,
+	const vk::ShaderStageFlags stageFlags,
+	const uint32_t offset,
+	const std::span<const std::byte> values)
+{
+	assert(offset + values.size() <= MAX_PUSH_CONSTANTS_SIZE);
+
+	// push constants stay valid across compatible layouts, only one layout is tracked
+	if (layout != pushConstantsLayout)
+	{
+		pushConstantsLayout = layout;
+		pushConstantsWritten.reset();
+	}
+
+	const auto unchanged = [&] {
+		for (auto index = size_t(0); index < values.size(); ++index)
+		{
+			if (not pushConstantsWritten[offset + index] || pushConstantsData[offset + index] != values[index])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}();
+
+	if (unchanged)
+	{
+		++stats.skipped;
+		return;
+	}
+
+	++stats.issued;
+
+	std::ranges::copy(values, pushConstantsData.begin() + offset);
+
+	for (auto index = size_t(0); index < values.size(); ++index)
+	{
+		pushConstantsWritten.set(offset + index);
+	}
+
+	const auto pushConstantsInfo = vk::PushConstantsInfo{
+		.layout = layout,
+		.stageFlags = stageFlags,
+		.offset = offset,
+		.size = static_cast<uint32_t>(values.size()),
+		.pValues = values.data(),
+	};
+
+	commandBuffer.pushConstants2(pushConstantsInfo);
+}
+
+void CommandRecorder::setPrimitiveTopology(const vk::PrimitiveTopology value)
+{
+	if (update(topology, value))
+	{
+		commandBuffer.setPrimitiveTopology(value);
+	}
+}
+
+void CommandRecorder::setFrontFace(const vk::FrontFace value)
+{
+	if (update(frontFace, value))
+	{
+		commandBuffer.setFrontFace(value);
+	}
+}
+
+void CommandRecorder::setViewport(const vk::Viewport& value)
+{
+	if (update(viewport, value))
+	{
+		commandBuffer.setViewport(0, value);
+	}
+}
+
+void CommandRecorder::setScissor(const vk::Rect2D& value)
+{
+	if (update(scissor, value))
+	{
+		commandBuffer.setScissor(0, value);
+	}
+}
+
+void CommandRecorder::bindVertexBuffers(
+	const std::span<const vk::Buffer> buffers,
+	const std::span<const vk::DeviceSize> offsets,
+	const std::span<const vk::DeviceSize> sizes,
+	const std::span<const vk::DeviceSize> strides)
+{
+	const auto unchanged = vertexBuffers
+		&& std::ranges::equal(vertexBuffers->buffers, buffers)
+		&& std::ranges::equal(vertexBuffers->offsets, offsets)
+		&& std::ranges::equal(vertexBuffers->sizes, sizes)
+		&& std::ranges::equal(vertexBuffers->strides, strides);
+
+	if (unchanged)
+	{
+		++stats.skipped;
+		return;
+	}
+
+	++stats.issued;
+
+	using Sizes = decltype(VertexBuffers::sizes);
+
+	vertexBuffers = VertexBuffers{
+		.buffers = buffers | std::ranges::to<decltype(VertexBuffers::buffers)>(),
+		.offsets = offsets | std::ranges::to<Sizes>(),
+		.sizes = sizes | std::ranges::to<Sizes>(),
+		.strides = strides | std::ranges::to<Sizes>(),
+	};
+
+	commandBuffer.bindVertexBuffers2(0, buffers, offsets, sizes, strides);
+}
+
+void CommandRecorder::bindIndexBuffer(
+	const vk::Buffer buffer,
+	const vk::DeviceSize offset,
+	const vk::DeviceSize size,
+	const vk::IndexType type)
+{
+	const auto value = IndexBuffer{
+		.buffer = buffer,
+		.offset = offset,
+		.size = size,
+		.type = type,
+	};
+
+	if (update(indexBuffer, value))
+	{
+		commandBuffer.bindIndexBuffer2(buffer, offset, size, type);
+	}
+}
+
+void CommandRecorder::draw(const uint32_t vertexCount, const uint32_t instanceCount, const uint32_t firstVertex, const uint32_t firstInstance) const
+{
+	commandBuffer.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void CommandRecorder::drawIndexed(const uint32_t indexCount, const uint32_t instanceCount, const uint32_t firstIndex, const int32_t vertexOffset, const uint32_t firstInstance) const
+{
+	commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void CommandRecorder::drawIndirect(const vk::Buffer buffer, const vk::DeviceSize offset, const uint32_t drawCount, const uint32_t stride) const
+{
+	commandBuffer.drawIndirect(buffer, offset, drawCount, stride);
+}
+
+void CommandRecorder::drawIndexedIndirect(const vk::Buffer buffer, const vk::DeviceSize offset, const uint32_t drawCount, const uint32_t stride) const
+{
+	commandBuffer.drawIndexedIndirect(buffer, offset, drawCount, stride);
+}
+
+void CommandRecorder::drawIndirectCount(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::Buffer countBuffer, const vk::DeviceSize countBufferOffset, const uint32_t maxDrawCount, const uint32_t stride) const
+{
+	commandBuffer.drawIndirectCount(buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
+void CommandRecorder::drawIndexedIndirectCount(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::Buffer countBuffer, const vk::DeviceSize countBufferOffset, const uint32_t maxDrawCount, const uint32_t stride) const
+{
+	commandBuffer.drawIndexedIndirectCount(buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
+void CommandRecorder::executeCommands(const std::span<const vk::CommandBuffer> commandBuffers, const Stats& secondaryStats)
+{
+	commandBuffer.executeCommands(commandBuffers);
+
+	pipeline.reset();
+	topology.reset();
+	frontFace.reset();
+	viewport.reset();
+	scissor.reset();
+	vertexBuffers.reset();
+	indexBuffer.reset();
+	pushConstantsLayout = nullptr;
+	pushConstantsWritten.reset();
+
+	stats.issued += secondaryStats.issued;
+	stats.skipped += secondaryStats.skipped;
+}
+
+const vk::raii::CommandBuffer& CommandRecorder::getCommandBuffer() const
+{
+	return commandBuffer;
+}
+
+const CommandRecorder::Stats& CommandRecorder::getStats() const
+{
+	return stats;
+}
+
+template<typename T>
+bool CommandRecorder::update(std::optional<T>& current, const T& value)
+{
+	if (current == value)
+	{
+		++stats.skipped;
+		return false;
+	}
+
+	current = value;
+	++stats.issued;
+
+	return true;
+}
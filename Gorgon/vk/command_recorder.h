@@ -0,0 +1,100 @@
+#pragma once
+
+// Records into a command buffer, dropping binds and dynamic state equal to what is
+// already set. Tracking starts from nothing, use one recorder per rendering pass.
+class CommandRecorder
+{
+public:
+	// state commands passed on to the command buffer and those dropped as redundant
+	struct Stats
+	{
+		uint32_t issued = 0;
+		uint32_t skipped = 0;
+	};
+
+	CommandRecorder(const vk::raii::CommandBuffer& commandBuffer);
+	CommandRecorder(const CommandRecorder&) = delete;
+
+	void bindPipeline(const vk::Pipeline pipeline);
+
+	// skipped if every byte matches what was last pushed with the same layout
+	void pushConstants(
+		const vk::PipelineLayout layout,
+		const vk::ShaderStageFlags stageFlags,
+		const uint32_t offset,
+		const std::span<const std::byte> values);
+
+	void setPrimitiveTopology(const vk::PrimitiveTopology topology);
+	void setFrontFace(const vk::FrontFace frontFace);
+	void setViewport(const vk::Viewport& viewport);
+	void setScissor(const vk::Rect2D& scissor);
+
+	void bindVertexBuffers(
+		const std::span<const vk::Buffer> buffers,
+		const std::span<const vk::DeviceSize> offsets,
+		const std::span<const vk::DeviceSize> sizes,
+		const std::span<const vk::DeviceSize> strides);
+
+	void bindIndexBuffer(
+		const vk::Buffer buffer,
+		const vk::DeviceSize offset,
+		const vk::DeviceSize size,
+		const vk::IndexType type);
+
+	void draw(const uint32_t vertexCount, const uint32_t instanceCount, const uint32_t firstVertex, const uint32_t firstInstance) const;
+	void drawIndexed(const uint32_t indexCount, const uint32_t instanceCount, const uint32_t firstIndex, const int32_t vertexOffset, const uint32_t firstInstance) const;
+	void drawIndirect(const vk::Buffer buffer, const vk::DeviceSize offset, const uint32_t drawCount, const uint32_t stride) const;
+	void drawIndexedIndirect(const vk::Buffer buffer, const vk::DeviceSize offset, const uint32_t drawCount, const uint32_t stride) const;
+	void drawIndirectCount(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::Buffer countBuffer, const vk::DeviceSize countBufferOffset, const uint32_t maxDrawCount, const uint32_t stride) const;
+	void drawIndexedIndirectCount(const vk::Buffer buffer, const vk::DeviceSize offset, const vk::Buffer countBuffer, const vk::DeviceSize countBufferOffset, const uint32_t maxDrawCount, const uint32_t stride) const;
+
+	// The state secondary command buffers leave behind is undefined, so tracking starts from
+	// nothing again. secondaryStats are of their recorders and added to this one's.
+	void executeCommands(const std::span<const vk::CommandBuffer> commandBuffers, const Stats& secondaryStats);
+
+	// for commands which aren't tracked
+	const vk::raii::CommandBuffer& getCommandBuffer() const;
+	const Stats& getStats() const;
+
+private:
+	// true if value differs from current, which is then updated
+	template<typename T>
+	bool update(std::optional<T>& current, const T& value);
+
+	const vk::raii::CommandBuffer& commandBuffer;
+
+	std::optional<vk::Pipeline> pipeline;
+	std::optional<vk::PrimitiveTopology> topology;
+	std::optional<vk::FrontFace> frontFace;
+	std::optional<vk::Viewport> viewport;
+	std::optional<vk::Rect2D> scissor;
+
+	struct VertexBuffers
+	{
+		vku::small::vector<vk::Buffer, VERTEX_INPUT_NUM> buffers;
+		vku::small::vector<vk::DeviceSize, VERTEX_INPUT_NUM> offsets;
+		vku::small::vector<vk::DeviceSize, VERTEX_INPUT_NUM> sizes;
+		vku::small::vector<vk::DeviceSize, VERTEX_INPUT_NUM> strides;
+	};
+	std::optional<VertexBuffers> vertexBuffers;
+
+	struct IndexBuffer
+	{
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		vk::IndexType type;
+
+		bool operator==(const IndexBuffer&) const = default;
+	};
+	std::optional<IndexBuffer> indexBuffer;
+
+	// minimum maxPushConstantsSize guaranteed by the spec
+	static constexpr auto MAX_PUSH_CONSTANTS_SIZE = 128u;
+
+	vk::PipelineLayout pushConstantsLayout;
+	std::array<std::byte, MAX_PUSH_CONSTANTS_SIZE> pushConstantsData;
+	std::bitset<MAX_PUSH_CONSTANTS_SIZE> pushConstantsWritten;
+
+	Stats stats;
+};
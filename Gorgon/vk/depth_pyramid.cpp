@@ -0,0 +1,318 @@
+#include "depth_pyramid.h"
+#include <shaders/shared.inl>
+
+namespace
+{
+
+constexpr auto DEPTH_PYRAMID_FORMAT = vk::Format::eR32Sfloat;
+
+const auto DEPTH_SUBRESOURCE_RANGE = vk::ImageSubresourceRange{
+	.aspectMask = vk::ImageAspectFlagBits::eDepth,
+	.levelCount = 1,
+	.layerCount = 1,
+};
+
+vk::Extent2D getLevelExtent(const vk::Extent2D extent, const uint32_t level)
+{
+	return vk::Extent2D{
+		.width = std::max(extent.width >> level, 1u),
+		.height = std::max(extent.height >> level, 1u),
+	};
+}
+
+vk::raii::ImageView createLevelView(
+	const vk::raii::Device& device,
+	const VmaImage& image,
+	const uint32_t baseLevel,
+	const uint32_t levelCount)
+{
+	const auto createInfo = vk::ImageViewCreateInfo{
+		.image = *image,
+		.viewType = vk::ImageViewType::e2D,
+		.format = DEPTH_PYRAMID_FORMAT,
+		.subresourceRange = {
+			.aspectMask = vk::ImageAspectFlagBits::eColor,
+			.baseMipLevel = baseLevel,
+			.levelCount = levelCount,
+			.layerCount = 1,
+		},
+	};
+
+	return device.createImageView(createInfo);
+}
+
+}
+
+DepthPyramid::DepthPyramid(const CreateInfo& info)
+	: depthImage(info.depthImage)
+	, depthExtent(info.depthExtent)
+	, extent{
+		.width = std::bit_floor(info.depthExtent.width),
+		.height = std::bit_floor(info.depthExtent.height),
+	}
+	, levelCount(static_cast<uint32_t>(std::bit_width(std::max(extent.width, extent.height))))
+	, image([&] {
+		const auto createInfo = vk::ImageCreateInfo{
+			.imageType = vk::ImageType::e2D,
+			.format = DEPTH_PYRAMID_FORMAT,
+			.extent = vk::Extent3D{
+				.width = extent.width,
+				.height = extent.height,
+				.depth = 1,
+			},
+			.mipLevels = levelCount,
+			.arrayLayers = 1,
+			.samples = vk::SampleCountFlagBits::e1,
+			.tiling = vk::ImageTiling::eOptimal,
+			.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+			.sharingMode = vk::SharingMode::eExclusive,
+		};
+
+		return info.vma.createImage(createInfo, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+	}())
+	, imageView(createLevelView(info.device, image, 0, levelCount))
+	, levelViews(std::views::iota(0u, levelCount)
+		| std::views::transform([&](const uint32_t level) { return createLevelView(info.device, image, level, 1); })
+		| std::ranges::to<std::vector>())
+	, shader(info.device, "shaders/depth_pyramid.spv")
+	, reduceDescriptorSetLayout([&] {
+		const auto bindings = {
+			vk::DescriptorSetLayoutBinding{
+				.binding = 0,
+				.descriptorType = vk::DescriptorType::eSampledImage,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			},
+			vk::DescriptorSetLayoutBinding{
+				.binding = 1,
+				.descriptorType = vk::DescriptorType::eStorageImage,
+				.descriptorCount = 1,
+				.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			},
+		};
+
+		return info.device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{}.setBindings(bindings));
+	}())
+	, pipelineLayout([&] {
+		constexpr auto pushConstantRange = vk::PushConstantRange{
+			.stageFlags = vk::ShaderStageFlagBits::eCompute,
+			.size = sizeof(DepthPyramidPushConstants),
+		};
+
+		const auto createInfo = vk::PipelineLayoutCreateInfo{}
+			.setSetLayouts(*reduceDescriptorSetLayout)
+			.setPushConstantRanges(pushConstantRange);
+
+		return info.device.createPipelineLayout(createInfo);
+	}())
+	, pipeline([&] {
+		const auto createInfo = vk::ComputePipelineCreateInfo{
+			.stage = {
+				.stage = vk::ShaderStageFlagBits::eCompute,
+				.module = *shader.getModule(),
+				.pName = "main",
+			},
+			.layout = *pipelineLayout,
+		};
+
+		return info.device.createComputePipeline(nullptr, createInfo);
+	}())
+	, descriptorSetLayout(createDescriptorSetLayout(info.device))
+	, descriptorPool([&] {
+		const auto poolSizes = {
+			vk::DescriptorPoolSize{
+				.type = vk::DescriptorType::eSampledImage,
+				.descriptorCount = levelCount + 1,
+			},
+			vk::DescriptorPoolSize{
+				.type = vk::DescriptorType::eStorageImage,
+				.descriptorCount = levelCount,
+			},
+		};
+
+		const auto createInfo = vk::DescriptorPoolCreateInfo{
+			.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+			.maxSets = levelCount + 1,
+		}.setPoolSizes(poolSizes);
+
+		return info.device.createDescriptorPool(createInfo);
+	}())
+	, reduceDescriptorSets([&] {
+		const auto setLayouts = std::vector(levelCount, *reduceDescriptorSetLayout);
+
+		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
+			.descriptorPool = *descriptorPool,
+		}.setSetLayouts(setLayouts);
+
+		return info.device.allocateDescriptorSets(allocateInfo);
+	}())
+	, descriptorSet([&] {
+		const auto allocateInfo = vk::DescriptorSetAllocateInfo{
+			.descriptorPool = *descriptorPool,
+		}.setSetLayouts(*descriptorSetLayout);
+
+		return std::move(info.device.allocateDescriptorSets(allocateInfo).front());
+	}())
+{
+	// level 0 reduces the depth image, every other level the one above it
+	const auto sourceInfos = std::views::iota(0u, levelCount)
+		| std::views::transform([&](const uint32_t level) {
+			return level == 0 ?
+				vk::DescriptorImageInfo{ .imageView = info.depthImageView, .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal } :
+				vk::DescriptorImageInfo{ .imageView = *levelViews[level - 1], .imageLayout = vk::ImageLayout::eGeneral };
+		})
+		| std::ranges::to<std::vector>();
+
+	const auto destinationInfos = levelViews
+		| std::views::transform([](const vk::raii::ImageView& view) {
+			return vk::DescriptorImageInfo{ .imageView = *view, .imageLayout = vk::ImageLayout::eGeneral };
+		})
+		| std::ranges::to<std::vector>();
+
+	const auto pyramidInfo = vk::DescriptorImageInfo{ .imageView = *imageView, .imageLayout = vk::ImageLayout::eGeneral };
+
+	auto descriptorWrites = std::vector<vk::WriteDescriptorSet>();
+
+	for (const auto& [descriptorSet, sourceInfo, destinationInfo] : std::views::zip(reduceDescriptorSets, sourceInfos, destinationInfos))
+	{
+		descriptorWrites.push_back(vk::WriteDescriptorSet{
+			.dstSet = *descriptorSet,
+			.dstBinding = 0,
+			.descriptorType = vk::DescriptorType::eSampledImage,
+		}.setImageInfo(sourceInfo));
+
+		descriptorWrites.push_back(vk::WriteDescriptorSet{
+			.dstSet = *descriptorSet,
+			.dstBinding = 1,
+			.descriptorType = vk::DescriptorType::eStorageImage,
+		}.setImageInfo(destinationInfo));
+	}
+
+	descriptorWrites.push_back(vk::WriteDescriptorSet{
+		.dstSet = *descriptorSet,
+		.dstBinding = 0,
+		.descriptorType = vk::DescriptorType::eSampledImage,
+	}.setImageInfo(pyramidInfo));
+
+	info.device.updateDescriptorSets(descriptorWrites, {});
+}
+
+vk::raii::DescriptorSetLayout DepthPyramid::createDescriptorSetLayout(const vk::raii::Device& device)
+{
+	const auto binding = vk::DescriptorSetLayoutBinding{
+		.binding = 0,
+		.descriptorType = vk::DescriptorType::eSampledImage,
+		.descriptorCount = 1,
+		.stageFlags = vk::ShaderStageFlagBits::eCompute,
+	};
+
+	return device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{}.setBindings(binding));
+}
+
+void DepthPyramid::build(const vk::raii::CommandBuffer& commandBuffer) const
+{
+	{
+		const auto imageMemoryBarriers = {
+			// the depth writes of the pass before become visible to the first reduction
+			vk::ImageMemoryBarrier2{
+				.srcStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+				.srcAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+				.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+				.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
+				.oldLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+				.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+				.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+				.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+				.image = depthImage,
+				.subresourceRange = DEPTH_SUBRESOURCE_RANGE,
+			},
+			// last frame's pyramid is discarded once its readers are done
+			vk::ImageMemoryBarrier2{
+				.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+				.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+				.dstAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+				.oldLayout = vk::ImageLayout::eUndefined,
+				.newLayout = vk::ImageLayout::eGeneral,
+				.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+				.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+				.image = *image,
+				.subresourceRange = {
+					.aspectMask = vk::ImageAspectFlagBits::eColor,
+					.levelCount = levelCount,
+					.layerCount = 1,
+				},
+			},
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarriers));
+	}
+
+	commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
+
+	auto sourceExtent = depthExtent;
+
+	for (auto level = 0u; level < levelCount; ++level)
+	{
+		const auto levelExtent = getLevelExtent(extent, level);
+
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *pipelineLayout, 0, *reduceDescriptorSets[level], {});
+
+		const auto pushConstants = DepthPyramidPushConstants{
+			.sourceSize = uint2(sourceExtent.width, sourceExtent.height),
+			.size = uint2(levelExtent.width, levelExtent.height),
+		};
+
+		commandBuffer.pushConstants<DepthPyramidPushConstants>(*pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushConstants);
+
+		commandBuffer.dispatch(
+			(levelExtent.width + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+			(levelExtent.height + DEPTH_PYRAMID_WORKGROUP_SIZE - 1) / DEPTH_PYRAMID_WORKGROUP_SIZE,
+			1
+		);
+
+		// the next level reads this one, the culling pass all of them
+		const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
+			.oldLayout = vk::ImageLayout::eGeneral,
+			.newLayout = vk::ImageLayout::eGeneral,
+			.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.image = *image,
+			.subresourceRange = {
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.baseMipLevel = level,
+				.levelCount = 1,
+				.layerCount = 1,
+			},
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarrier));
+
+		sourceExtent = levelExtent;
+	}
+
+	// back for the pass after, which loads the depth
+	{
+		const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+			.dstStageMask = vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+			.dstAccessMask = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+			.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+			.newLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+			.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.image = depthImage,
+			.subresourceRange = DEPTH_SUBRESOURCE_RANGE,
+		};
+
+		commandBuffer.pipelineBarrier2(vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarrier));
+	}
+}
+
+vk::DescriptorSet DepthPyramid::getDescriptorSet() const
+{
+	return *descriptorSet;
+}
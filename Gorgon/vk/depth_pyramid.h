@@ -0,0 +1,52 @@
+#pragma once
+#include "vma.h"
+#include "shader.h"
+
+// Mip chain of a depth image where each texel holds the farthest depth under it, for
+// occlusion culling. Level 0 is the depth extent rounded down to powers of two, so the
+// levels below halve exactly. Rebuilt in compute from the depth image every frame.
+class DepthPyramid
+{
+public:
+	struct CreateInfo
+	{
+		const vk::raii::Device& device;
+		const VulkanMemoryAllocator& vma;
+		vk::Image depthImage; // needs VK_IMAGE_USAGE_SAMPLED_BIT
+		vk::ImageView depthImageView;
+		vk::Extent2D depthExtent;
+	};
+
+	DepthPyramid(const CreateInfo& info);
+	DepthPyramid(const DepthPyramid&) = delete;
+
+	// Layout of the set readers bind the pyramid with, binding 0 is a sampled image of
+	// every level. Sets of other pipelines created from it are compatible with getDescriptorSet.
+	static vk::raii::DescriptorSetLayout createDescriptorSetLayout(const vk::raii::Device& device);
+
+	// Outside of rendering, the depth image is in VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
+	// before and after. Compute reads of the pyramid are synchronized with the build.
+	void build(const vk::raii::CommandBuffer& commandBuffer) const;
+
+	vk::DescriptorSet getDescriptorSet() const;
+
+private:
+	vk::Image depthImage;
+	vk::Extent2D depthExtent;
+	vk::Extent2D extent; // of level 0
+	uint32_t levelCount;
+
+	VmaImage image;
+	vk::raii::ImageView imageView; // every level
+	std::vector<vk::raii::ImageView> levelViews;
+
+	Shader shader;
+	vk::raii::DescriptorSetLayout reduceDescriptorSetLayout;
+	vk::raii::PipelineLayout pipelineLayout;
+	vk::raii::Pipeline pipeline;
+
+	vk::raii::DescriptorSetLayout descriptorSetLayout;
+	vk::raii::DescriptorPool descriptorPool;
+	std::vector<vk::raii::DescriptorSet> reduceDescriptorSets; // one per level
+	vk::raii::DescriptorSet descriptorSet;
+};
@@ -0,0 +1,150 @@
+#include "pipeline_cache.h"
+#include "util/hash.h"
+
+namespace
+{
+
+constexpr auto PIPELINE_CACHE_MAGIC = 0x43504F47u; // "GOPC"
+constexpr auto PIPELINE_CACHE_VERSION = 1u;
+
+PipelineCache::Header getDeviceHeader(const vk::raii::PhysicalDevice& physicalDevice)
+{
+	const auto chain = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+	const auto& properties = chain.get<vk::PhysicalDeviceProperties2>().properties;
+	const auto& idProperties = chain.get<vk::PhysicalDeviceIDProperties>();
+
+	return PipelineCache::Header{
+		.magic = PIPELINE_CACHE_MAGIC,
+		.version = PIPELINE_CACHE_VERSION,
+		.vendorID = properties.vendorID,
+		.deviceID = properties.deviceID,
+		.driverVersion = properties.driverVersion,
+		.deviceUUID = idProperties.deviceUUID,
+		.driverUUID = idProperties.driverUUID,
+		.pipelineCacheUUID = properties.pipelineCacheUUID,
+	};
+}
+
+// empty if the file is missing, damaged or written by another device or driver
+std::vector<std::byte> loadData(const std::filesystem::path& path, const PipelineCache::Header& deviceHeader)
+{
+	auto file = std::ifstream(path, std::ios::binary);
+
+	if (!file)
+	{
+		return {};
+	}
+
+	auto header = PipelineCache::Header{};
+
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || not header.isCompatible(deviceHeader))
+	{
+		return {};
+	}
+
+	// a damaged dataSize mustn't size the allocation
+	auto ec = std::error_code();
+	const auto fileSize = std::filesystem::file_size(path, ec);
+
+	if (ec || fileSize < sizeof(header) || header.dataSize != fileSize - sizeof(header))
+	{
+		return {};
+	}
+
+	auto data = std::vector<std::byte>(header.dataSize);
+
+	if (!file.read(reinterpret_cast<char*>(data.data()), data.size()) || hashBytes(data) != header.dataHash)
+	{
+		return {};
+	}
+
+	return data;
+}
+
+}
+
+PipelineCache::PipelineCache(
+	const vk::raii::PhysicalDevice& physicalDevice,
+	const vk::raii::Device& device,
+	const std::optional<std::filesystem::path>& path)
+	: header(getDeviceHeader(physicalDevice))
+	, path(path)
+	, cache([&] {
+		const auto data = path ? loadData(*path, header) : std::vector<std::byte>();
+
+		const auto createInfo = vk::PipelineCacheCreateInfo{
+			.initialDataSize = data.size(),
+			.pInitialData = data.data(),
+		};
+
+		return device.createPipelineCache(createInfo);
+	}())
+{}
+
+PipelineCache::~PipelineCache()
+{
+	// getData and the file system can throw, which a destructor mustn't let escape
+	try
+	{
+		save();
+	}
+	catch (const std::exception& e)
+	{
+		fmt::println(std::clog, "failed to save the pipeline cache: {}", e.what());
+	}
+}
+
+const vk::raii::PipelineCache& PipelineCache::get() const
+{
+	return cache;
+}
+
+void PipelineCache::save() const
+{
+	if (not path)
+	{
+		return;
+	}
+
+	const auto data = cache.getData();
+
+	auto fileHeader = header;
+	fileHeader.dataSize = data.size();
+	fileHeader.dataHash = hashBytes(std::as_bytes(std::span(data)));
+
+	// the cache is best effort, write errors are ignored
+	auto ec = std::error_code();
+	std::filesystem::create_directories(path->parent_path(), ec);
+
+	// written aside and renamed, so a crash never leaves a partial file behind
+	auto tempPath = *path;
+	tempPath += ".tmp";
+
+	{
+		auto file = std::ofstream(tempPath, std::ios::binary | std::ios::trunc);
+
+		file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+		if (not file.flush())
+		{
+			file.close();
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, *path, ec);
+}
+
+bool PipelineCache::Header::isCompatible(const Header& rh) const
+{
+	return magic == rh.magic
+		&& version == rh.version
+		&& vendorID == rh.vendorID
+		&& deviceID == rh.deviceID
+		&& driverVersion == rh.driverVersion
+		&& deviceUUID == rh.deviceUUID
+		&& driverUUID == rh.driverUUID
+		&& pipelineCacheUUID == rh.pipelineCacheUUID;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// vk::PipelineCache persisted to a file. The file starts with a header naming the
+// device and driver it was written by, anything else is discarded on load.
+class PipelineCache
+{
+public:
+	// nullopt path: in-memory only
+	PipelineCache(
+		const vk::raii::PhysicalDevice& physicalDevice,
+		const vk::raii::Device& device,
+		const std::optional<std::filesystem::path>& path
+	);
+	PipelineCache(const PipelineCache&) = delete;
+
+	// saves
+	~PipelineCache();
+
+	const vk::raii::PipelineCache& get() const;
+	void save() const;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		std::array<uint8_t, VK_UUID_SIZE> deviceUUID;
+		std::array<uint8_t, VK_UUID_SIZE> driverUUID;
+		std::array<uint8_t, VK_UUID_SIZE> pipelineCacheUUID;
+		uint64_t dataSize;
+		uint64_t dataHash;
+
+		bool isCompatible(const Header& rh) const;
+	};
+
+private:
+	Header header; // of this device, dataSize and dataHash unset
+	std::optional<std::filesystem::path> path;
+	vk::raii::PipelineCache cache;
+};
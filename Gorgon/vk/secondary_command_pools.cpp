@@ -0,0 +1,55 @@
+#include "secondary_command_pools.h"
+
+SecondaryCommandPools::SecondaryCommandPools(const CreateInfo& info)
+	: device(info.device)
+	, slotCount(info.slotCount)
+{
+	assert(slotCount > 0);
+
+	for (auto index = uint32_t(0); index < info.framesInFlight * slotCount; ++index)
+	{
+		pools.push_back(Pool{
+			.commandPool = device.createCommandPool({
+				.flags = vk::CommandPoolCreateFlagBits::eTransient,
+				.queueFamilyIndex = info.queueFamilyIndex,
+			}),
+		});
+	}
+}
+
+void SecondaryCommandPools::reset(const uint32_t frameIndex)
+{
+	assert((frameIndex + 1) * slotCount <= pools.size());
+
+	for (auto& pool : std::span(pools).subspan(frameIndex * slotCount, slotCount))
+	{
+		pool.commandPool.reset();
+		pool.usedCount = 0;
+	}
+}
+
+const vk::raii::CommandBuffer& SecondaryCommandPools::allocate(const uint32_t frameIndex, const uint32_t slot)
+{
+	assert(slot < slotCount);
+	assert((frameIndex + 1) * slotCount <= pools.size());
+
+	auto& pool = pools[frameIndex * slotCount + slot];
+
+	if (pool.usedCount == pool.commandBuffers.size())
+	{
+		auto commandBuffers = device.allocateCommandBuffers({
+			.commandPool = *pool.commandPool,
+			.level = vk::CommandBufferLevel::eSecondary,
+			.commandBufferCount = 1,
+		});
+
+		pool.commandBuffers.push_back(std::move(commandBuffers.front()));
+	}
+
+	return pool.commandBuffers[pool.usedCount++];
+}
+
+uint32_t SecondaryCommandPools::getSlotCount() const
+{
+	return slotCount;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Command pools for recording secondary command buffers on several threads. Every frame
+// in flight has a pool per slot, and a slot is recorded into by one thread at a time, so
+// pools are never shared between threads and are reset whole once their frame is done.
+class SecondaryCommandPools
+{
+public:
+	struct CreateInfo
+	{
+		const vk::raii::Device& device;
+		uint32_t queueFamilyIndex;
+		uint32_t framesInFlight;
+		uint32_t slotCount; // the most buffers recorded at the same time, e.g. the thread count
+	};
+
+	SecondaryCommandPools(const CreateInfo& info);
+	SecondaryCommandPools(const SecondaryCommandPools&) = delete;
+
+	// Recycles every buffer of the frame slot, once its previous submission has finished
+	void reset(const uint32_t frameIndex);
+
+	// A buffer of the frame and slot not handed out since the last reset. The reference is
+	// valid until the next allocate from the same frame and slot, the handle until the reset.
+	const vk::raii::CommandBuffer& allocate(const uint32_t frameIndex, const uint32_t slot);
+
+	uint32_t getSlotCount() const;
+
+private:
+	struct Pool
+	{
+		vk::raii::CommandPool commandPool;
+		std::vector<vk::raii::CommandBuffer> commandBuffers;
+		size_t usedCount = 0;
+	};
+
+	const vk::raii::Device& device;
+	uint32_t slotCount;
+	std::vector<Pool> pools; // slotCount per frame in flight
+};
@@ -0,0 +1,95 @@
+#include "staging_ring.h"
+
+StagingRing::StagingRing(const VulkanMemoryAllocator& vma, const vk::DeviceSize size)
+	: buffer(vma.createBuffer(
+		size,
+		vk::BufferUsageFlagBits::eTransferSrc,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
+	))
+	, mapped(buffer.MapMemory())
+	, capacity(size)
+{
+	if (not mapped)
+	{
+		throw std::runtime_error("cannot map the staging ring");
+	}
+}
+
+StagingRing::~StagingRing()
+{
+	buffer.UnmapMemory();
+}
+
+std::optional<StagingRing::Allocation> StagingRing::allocate(const vk::DeviceSize size, const vk::DeviceSize alignment)
+{
+	assert(size <= capacity);
+	assert(std::has_single_bit(alignment) && capacity % alignment == 0);
+
+	auto begin = (head + alignment - 1) & ~(alignment - 1);
+
+	// never straddle the end, skip to the start of the next lap instead
+	if (begin % capacity + size > capacity)
+	{
+		begin = (begin / capacity + 1) * capacity;
+	}
+
+	if (begin + size - tail > capacity)
+	{
+		return std::nullopt;
+	}
+
+	head = begin + size;
+
+	const auto offset = begin % capacity;
+
+	return Allocation{
+		.buffer = *buffer,
+		.offset = offset,
+		.data = std::span(mapped + offset, size),
+	};
+}
+
+void StagingRing::retire(const uint64_t value)
+{
+	if (head == retired)
+	{
+		return;
+	}
+
+	// one range, or two when the allocations wrapped around
+	const auto begin = retired % capacity;
+	const auto end = head % capacity;
+
+	if (head - retired >= capacity || end <= begin)
+	{
+		const auto result = buffer.FlushAllocation(0, vk::WholeSize);
+		assert(result == vk::Result::eSuccess);
+	}
+	else
+	{
+		const auto result = buffer.FlushAllocation(begin, end - begin);
+		assert(result == vk::Result::eSuccess);
+	}
+
+	inFlight.push_back({ .end = head, .value = value });
+	retired = head;
+}
+
+void StagingRing::reclaim(const uint64_t completedValue)
+{
+	while (not inFlight.empty() && inFlight.front().value <= completedValue)
+	{
+		tail = inFlight.front().end;
+		inFlight.pop_front();
+	}
+}
+
+bool StagingRing::hasOutstanding() const
+{
+	return head != retired;
+}
+
+vk::DeviceSize StagingRing::size() const
+{
+	return capacity;
+}
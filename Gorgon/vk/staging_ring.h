@@ -0,0 +1,49 @@
+#pragma once
+#include "vma.h"
+
+// Fixed-size, persistently mapped staging buffer handed out front to back.
+// Regions are retired with the timeline value of the submission that reads them
+// and reused once the timeline reaches it, so staging memory never exceeds the ring.
+class StagingRing
+{
+public:
+	struct Allocation
+	{
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		std::span<std::byte> data;
+	};
+
+	StagingRing(const VulkanMemoryAllocator& vma, const vk::DeviceSize size);
+	StagingRing(const StagingRing&) = delete;
+	~StagingRing();
+
+	// nullopt until enough of the ring has been reclaimed
+	std::optional<Allocation> allocate(const vk::DeviceSize size, const vk::DeviceSize alignment);
+
+	// flushes the allocations since the last retire, they are reused once the timeline reaches value
+	void retire(const uint64_t value);
+	void reclaim(const uint64_t completedValue);
+
+	// true if allocations were made since the last retire
+	bool hasOutstanding() const;
+	vk::DeviceSize size() const;
+
+private:
+	VmaBuffer buffer;
+	std::byte* mapped;
+	vk::DeviceSize capacity;
+
+	// monotonic positions, the physical offset is position % capacity
+	vk::DeviceSize head = 0;
+	vk::DeviceSize tail = 0;
+	vk::DeviceSize retired = 0;
+
+	struct InFlight
+	{
+		vk::DeviceSize end;
+		uint64_t value;
+	};
+
+	std::deque<InFlight> inFlight;
+};
@@ -0,0 +1,315 @@
+#include "upload_batch.h"
+
+namespace
+{
+
+// bufferOffset of image copies must be a multiple of the texel size and of 4
+constexpr auto STAGING_ALIGNMENT = vk::DeviceSize(16);
+
+// every way a model reads its buffers: vertex/index fetch, indirect draws, storage reads while drawing and culling
+constexpr auto BUFFER_READ_STAGES = vk::PipelineStageFlagBits2::eVertexInput
+	| vk::PipelineStageFlagBits2::eDrawIndirect
+	| vk::PipelineStageFlagBits2::eVertexShader
+	| vk::PipelineStageFlagBits2::eFragmentShader
+	| vk::PipelineStageFlagBits2::eComputeShader;
+
+constexpr auto BUFFER_READ_ACCESS = vk::AccessFlagBits2::eVertexAttributeRead
+	| vk::AccessFlagBits2::eIndexRead
+	| vk::AccessFlagBits2::eIndirectCommandRead
+	| vk::AccessFlagBits2::eShaderStorageRead;
+
+}
+
+UploadBatch::UploadBatch(const CreateInfo& info)
+	: device(info.device)
+	, stagingRing(info.stagingRing)
+	, commandBuffer(info.commandBuffer)
+	, queue(info.queue)
+	, queueMutex(info.queueMutex)
+	, timeline(info.timeline)
+	, timelineValue(info.timelineValue)
+	, srcQueueFamilyIndex(info.srcQueueFamilyIndex)
+	, dstQueueFamilyIndex(info.dstQueueFamilyIndex)
+{
+	stagingRing.reclaim(timeline.getCounterValue());
+	commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+}
+
+UploadBatch::~UploadBatch()
+{
+	wait();
+}
+
+void UploadBatch::copyToBuffer(const std::span<const std::byte> data, const vk::Buffer buffer)
+{
+	for (auto offset = size_t(0); offset < data.size();)
+	{
+		const auto chunk = data.subspan(offset, std::min<size_t>(data.size() - offset, maxChunkSize()));
+		const auto allocation = allocate(chunk.size());
+
+		std::ranges::copy(chunk, allocation.data.begin());
+
+		const auto copyRegion = vk::BufferCopy{
+			.srcOffset = allocation.offset,
+			.dstOffset = offset,
+			.size = chunk.size(),
+		};
+
+		commandBuffer.copyBuffer(allocation.buffer, buffer, copyRegion);
+
+		offset += chunk.size();
+	}
+
+	if (data.empty() || srcQueueFamilyIndex == dstQueueFamilyIndex)
+	{
+		return;
+	}
+
+	bufferBarriers.push_back({
+		.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+		.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+		.srcQueueFamilyIndex = srcQueueFamilyIndex,
+		.dstQueueFamilyIndex = dstQueueFamilyIndex,
+		.buffer = buffer,
+		.size = vk::WholeSize,
+	});
+
+	acquireBarriers.buffers.push_back({
+		.dstStageMask = BUFFER_READ_STAGES,
+		.dstAccessMask = BUFFER_READ_ACCESS,
+		.srcQueueFamilyIndex = srcQueueFamilyIndex,
+		.dstQueueFamilyIndex = dstQueueFamilyIndex,
+		.buffer = buffer,
+		.size = vk::WholeSize,
+	});
+}
+
+void UploadBatch::copyToImage(const std::span<const std::byte> data, const vk::Image image, const vk::Extent3D& extent)
+{
+	assert(extent.depth == 1);
+
+	// to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+	{
+		const auto imageMemoryBarrier = vk::ImageMemoryBarrier2{
+			.dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.newLayout = vk::ImageLayout::eTransferDstOptimal,
+			.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.image = image,
+			.subresourceRange = COLOR_SUBRESOURCE_RANGE,
+		};
+
+		const auto dependencyInfo = vk::DependencyInfo{}.setImageMemoryBarriers(imageMemoryBarrier);
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+	}
+
+	constexpr auto COLOR_SUBRESOURCE_LAYERS = vk::ImageSubresourceLayers{
+		.aspectMask = vk::ImageAspectFlagBits::eColor,
+		.mipLevel = 0,
+		.baseArrayLayer = 0,
+		.layerCount = 1,
+	};
+
+	const auto rowSize = data.size() / extent.height;
+	const auto texelSize = rowSize / extent.width;
+
+	if (texelSize > maxChunkSize())
+	{
+		throw std::runtime_error(fmt::format("staging ring of {} bytes is too small for {} byte texels", stagingRing.size(), texelSize));
+	}
+
+	// large images are split into bands of whole rows, rows larger than a chunk into pieces of whole texels
+	const auto rowsPerChunk = static_cast<uint32_t>(std::max<vk::DeviceSize>(maxChunkSize() / rowSize, 1));
+	const auto texelsPerChunk = static_cast<uint32_t>(std::min<vk::DeviceSize>(maxChunkSize() / texelSize, extent.width));
+
+	for (auto row = 0u, column = 0u; row < extent.height;)
+	{
+		const auto rowCount = std::min(rowsPerChunk, extent.height - row);
+		const auto texelCount = std::min(texelsPerChunk, extent.width - column);
+		const auto chunk = rowCount > 1 || texelCount == extent.width ?
+			data.subspan(row * rowSize, rowCount * rowSize) :
+			data.subspan(row * rowSize + column * texelSize, texelCount * texelSize);
+		const auto allocation = allocate(chunk.size());
+
+		std::ranges::copy(chunk, allocation.data.begin());
+
+		const auto copyRegion = vk::BufferImageCopy2{
+			.bufferOffset = allocation.offset,
+			.imageSubresource = COLOR_SUBRESOURCE_LAYERS,
+			.imageOffset = { .x = static_cast<int32_t>(column), .y = static_cast<int32_t>(row) },
+			.imageExtent = { .width = texelCount, .height = rowCount, .depth = 1 },
+		};
+
+		const auto copyBufferToImageInfo = vk::CopyBufferToImageInfo2
+		{
+			.srcBuffer = allocation.buffer,
+			.dstImage = image,
+			.dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
+		}.setRegions(copyRegion);
+
+		commandBuffer.copyBufferToImage2(copyBufferToImageInfo);
+
+		column += texelCount;
+
+		if (column == extent.width)
+		{
+			row += rowCount;
+			column = 0;
+		}
+	}
+
+	// to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+	{
+		imageBarriers.push_back({
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+			.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead,
+			.oldLayout = vk::ImageLayout::eTransferDstOptimal,
+			.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+			.srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+			.image = image,
+			.subresourceRange = COLOR_SUBRESOURCE_RANGE,
+		});
+	}
+	else
+	{
+		// the transition happens once, as part of the release/acquire pair
+		const auto barrier = vk::ImageMemoryBarrier2{
+			.oldLayout = vk::ImageLayout::eTransferDstOptimal,
+			.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+			.srcQueueFamilyIndex = srcQueueFamilyIndex,
+			.dstQueueFamilyIndex = dstQueueFamilyIndex,
+			.image = image,
+			.subresourceRange = COLOR_SUBRESOURCE_RANGE,
+		};
+
+		imageBarriers.push_back(vk::ImageMemoryBarrier2(barrier)
+			.setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+			.setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite));
+
+		acquireBarriers.images.push_back(vk::ImageMemoryBarrier2(barrier)
+			.setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+			.setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead));
+	}
+}
+
+void UploadBatch::submit()
+{
+	assert(not pendingValue);
+
+	// on the same queue family buffer copies are made visible to the buffer reads of
+	// later submissions, otherwise every resource is released instead
+	{
+		const auto memoryBarrier = vk::MemoryBarrier2{
+			.srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+			.srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+			.dstStageMask = BUFFER_READ_STAGES,
+			.dstAccessMask = BUFFER_READ_ACCESS,
+		};
+
+		auto dependencyInfo = vk::DependencyInfo{}
+			.setBufferMemoryBarriers(bufferBarriers)
+			.setImageMemoryBarriers(imageBarriers);
+
+		if (srcQueueFamilyIndex == dstQueueFamilyIndex)
+		{
+			dependencyInfo.setMemoryBarriers(memoryBarrier);
+		}
+
+		commandBuffer.pipelineBarrier2(dependencyInfo);
+	}
+
+	pendingValue = submitCommands();
+}
+
+void UploadBatch::wait()
+{
+	if (not pendingValue)
+	{
+		return;
+	}
+
+	waitFor(pendingValue.value());
+	pendingValue.reset();
+}
+
+UploadBatch::AcquireBarriers UploadBatch::takeAcquireBarriers()
+{
+	return std::exchange(acquireBarriers, {});
+}
+
+StagingRing::Allocation UploadBatch::allocate(const vk::DeviceSize size)
+{
+	if (auto allocation = stagingRing.allocate(size, STAGING_ALIGNMENT))
+	{
+		return allocation.value();
+	}
+
+	// the command buffer is reused right away, so the flush waits for the whole ring
+	if (stagingRing.hasOutstanding())
+	{
+		waitFor(submitCommands());
+		commandBuffer.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	}
+	else
+	{
+		waitFor(timelineValue);
+	}
+
+	const auto allocation = stagingRing.allocate(size, STAGING_ALIGNMENT);
+	assert(allocation);
+
+	return allocation.value();
+}
+
+uint64_t UploadBatch::submitCommands()
+{
+	commandBuffer.end();
+
+	const auto value = ++timelineValue;
+
+	const auto commandBufferInfo = vk::CommandBufferSubmitInfo{ .commandBuffer = *commandBuffer };
+
+	const auto signalSemaphoreInfo = vk::SemaphoreSubmitInfo{
+		.semaphore = *timeline,
+		.value = value,
+		.stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+	};
+
+	const auto submitInfo = vk::SubmitInfo2{}
+		.setCommandBufferInfos(commandBufferInfo)
+		.setSignalSemaphoreInfos(signalSemaphoreInfo);
+
+	// host writes to the ring must be flushed before the submission
+	stagingRing.retire(value);
+
+	{
+		const auto lock = std::scoped_lock(queueMutex);
+		queue.submit2(submitInfo);
+	}
+
+	return value;
+}
+
+void UploadBatch::waitFor(const uint64_t value)
+{
+	const auto semaphore = *timeline;
+
+	const auto waitInfo = vk::SemaphoreWaitInfo{}
+		.setSemaphores(semaphore)
+		.setValues(value);
+
+	const auto result = device.waitSemaphores(waitInfo, UINT64_MAX_VALUE);
+	assert(result == vk::Result::eSuccess);
+
+	stagingRing.reclaim(value);
+}
+
+vk::DeviceSize UploadBatch::maxChunkSize() const
+{
+	return stagingRing.size() / 4;
+}
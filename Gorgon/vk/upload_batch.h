@@ -0,0 +1,76 @@
+#pragma once
+#include "staging_ring.h"
+
+// Records every copy and layout transition of an upload into one submission.
+// Data is streamed through the staging ring in chunks, when the ring fills up the
+// recorded part is submitted and waited for, so any amount of data fits.
+// Each submission signals the next value of a timeline semaphore.
+// When the destination queue family differs, resources are released to it and the
+// matching acquire barriers are returned for the destination queue to record.
+class UploadBatch
+{
+public:
+	struct CreateInfo
+	{
+		const vk::raii::Device& device;
+		StagingRing& stagingRing;
+		const vk::raii::CommandBuffer& commandBuffer;
+		const vk::raii::Queue& queue;
+		std::mutex& queueMutex;
+		const vk::raii::Semaphore& timeline;
+		uint64_t& timelineValue; // last value signalled on the timeline
+		uint32_t srcQueueFamilyIndex; // family of the upload queue
+		uint32_t dstQueueFamilyIndex; // family the resources are used on
+	};
+
+	// recorded on the destination queue, after the batch completed and before first use
+	struct AcquireBarriers
+	{
+		std::vector<vk::BufferMemoryBarrier2> buffers;
+		std::vector<vk::ImageMemoryBarrier2> images;
+	};
+
+	// begins recording
+	UploadBatch(const CreateInfo& info);
+	UploadBatch(const UploadBatch&) = delete;
+
+	// waits if submitted
+	~UploadBatch();
+
+	void copyToBuffer(const std::span<const std::byte> data, const vk::Buffer buffer);
+
+	// the image ends up in eShaderReadOnlyOptimal
+	void copyToImage(const std::span<const std::byte> data, const vk::Image image, const vk::Extent3D& extent);
+
+	void submit();
+	void wait();
+
+	// empty if no ownership transfer is needed
+	AcquireBarriers takeAcquireBarriers();
+
+private:
+	// submits and waits for what was recorded so far when the ring is full
+	StagingRing::Allocation allocate(const vk::DeviceSize size);
+	uint64_t submitCommands();
+	void waitFor(const uint64_t value);
+
+	// chunks smaller than the ring let small copies share it with large ones
+	vk::DeviceSize maxChunkSize() const;
+
+	const vk::raii::Device& device;
+	StagingRing& stagingRing;
+	const vk::raii::CommandBuffer& commandBuffer;
+	const vk::raii::Queue& queue;
+	std::mutex& queueMutex;
+	const vk::raii::Semaphore& timeline;
+	uint64_t& timelineValue;
+	uint32_t srcQueueFamilyIndex;
+	uint32_t dstQueueFamilyIndex;
+
+	// recorded together at submit, after every copy
+	std::vector<vk::BufferMemoryBarrier2> bufferBarriers;
+	std::vector<vk::ImageMemoryBarrier2> imageBarriers;
+	AcquireBarriers acquireBarriers;
+
+	std::optional<uint64_t> pendingValue;
+};
@@ -92,6 +92,21 @@ vk::Result VmaBuffer::CopyMemoryToAllocation(
 	return static_cast<vk::Result>(result);
 }
 
+vk::Result VmaBuffer::CopyAllocationToMemory(
+	void* const pDstHostPointer,
+	const vk::DeviceSize size) const
+{
+	const auto result = vmaCopyAllocationToMemory(
+		allocator,
+		allocation,
+		0, // srcAllocationLocalOffset
+		pDstHostPointer,
+		size
+	);
+
+	return static_cast<vk::Result>(result);
+}
+
 std::byte* VmaBuffer::MapMemory() const
 {
 	void* pData;
@@ -106,6 +121,15 @@ void VmaBuffer::UnmapMemory() const
 	vmaUnmapMemory(allocator, allocation);
 }
 
+vk::Result VmaBuffer::FlushAllocation(
+	const vk::DeviceSize offset,
+	const vk::DeviceSize size) const
+{
+	const auto result = vmaFlushAllocation(allocator, allocation, offset, size);
+
+	return static_cast<vk::Result>(result);
+}
+
 vk::DeviceSize VmaBuffer::size() const
 {
 	VmaAllocationInfo pAllocationInfo;
@@ -40,9 +40,19 @@ public:
 		const void* const pSrcHostPointer,
 		const vk::DeviceSize size) const;
 
+	// invalidates first, so device writes are visible on non-coherent memory
+	vk::Result CopyAllocationToMemory(
+		void* const pDstHostPointer,
+		const vk::DeviceSize size) const;
+
 	std::byte* MapMemory() const;
 	void UnmapMemory() const;
 
+	// makes host writes visible on non-coherent memory, a no-op otherwise
+	vk::Result FlushAllocation(
+		const vk::DeviceSize offset,
+		const vk::DeviceSize size) const;
+
 	vk::DeviceSize size() const; // TODO
 	vk::Buffer operator*() const;
 